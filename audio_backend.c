@@ -0,0 +1,198 @@
+#include "audio_backend.h"
+#include "rt_log.h"
+#include "portaudio.h"
+#include <stdlib.h>
+
+typedef struct {
+    PaStream* input_stream;
+    PaStream* output_stream;
+    PaError last_error;
+    int initialized;           // Pa_Initialize() succeeded
+} PortAudioState;
+
+static void portaudio_stop(AudioBackend* backend) {
+    PortAudioState* pa = backend->state;
+    if (pa->input_stream) Pa_CloseStream(pa->input_stream);
+    if (pa->output_stream) Pa_CloseStream(pa->output_stream);
+    pa->input_stream = NULL;
+    pa->output_stream = NULL;
+    if (pa->initialized) Pa_Terminate();
+    pa->initialized = 0;
+}
+
+/**
+ * Opens and starts blocking input and output streams on the default
+ * devices. Everything it prints goes through rt_log; the device list only
+ * the first time.
+ *
+ * @param latency Latency to suggest to the host API for each direction (seconds).
+ * @return 0 on success, -1 on failure (nothing is left open).
+ */
+static int portaudio_start(AudioBackend* backend, size_t sample_rate, size_t frames, double latency) {
+    static int devices_listed = 0;
+    PortAudioState* pa = backend->state;
+    PaError err = Pa_Initialize();
+    if (err != paNoError) {
+        rt_log(RT_LOG_ERROR, "Failed to initialize PortAudio: %s", Pa_GetErrorText(err));
+        return -1;
+    }
+    pa->initialized = 1;
+
+    // Print available devices
+    if (!devices_listed) {
+        int numDevices = Pa_GetDeviceCount();
+        rt_log(RT_LOG_INFO, "Available audio devices:");
+        for(int i = 0; i < numDevices; i++) {
+            const PaDeviceInfo* deviceInfo = Pa_GetDeviceInfo(i);
+            rt_log(RT_LOG_INFO, "%d: %s (in: %d, out: %d)",
+                   i, deviceInfo->name,
+                   deviceInfo->maxInputChannels,
+                   deviceInfo->maxOutputChannels);
+        }
+        devices_listed = 1;
+    }
+
+    PaDeviceIndex inputDevice = Pa_GetDefaultInputDevice();
+    PaDeviceIndex outputDevice = Pa_GetDefaultOutputDevice();
+
+    rt_log(RT_LOG_INFO, "Using input device: %s", Pa_GetDeviceInfo(inputDevice)->name);
+    rt_log(RT_LOG_INFO, "Using output device: %s", Pa_GetDeviceInfo(outputDevice)->name);
+
+    // Input stream parameters
+    PaStreamParameters inputParams = {
+        .device = inputDevice,
+        .channelCount = 1,
+        .sampleFormat = paFloat32,
+        .suggestedLatency = latency,
+        .hostApiSpecificStreamInfo = NULL
+    };
+
+    // Output stream parameters
+    PaStreamParameters outputParams = {
+        .device = outputDevice,
+        .channelCount = 1,
+        .sampleFormat = paFloat32,
+        .suggestedLatency = latency,
+        .hostApiSpecificStreamInfo = NULL
+    };
+
+    rt_log(RT_LOG_INFO, "Opening input stream...");
+    err = Pa_OpenStream(&pa->input_stream,
+                       &inputParams,
+                       NULL,
+                       sample_rate,
+                       frames,
+                       paClipOff,
+                       NULL,
+                       NULL);
+    if (err != paNoError) {
+        rt_log(RT_LOG_ERROR, "Failed to open input stream: %s", Pa_GetErrorText(err));
+        pa->input_stream = NULL;
+        portaudio_stop(backend);
+        return -1;
+    }
+
+    rt_log(RT_LOG_INFO, "Opening output stream...");
+    err = Pa_OpenStream(&pa->output_stream,
+                       NULL,
+                       &outputParams,
+                       sample_rate,
+                       frames,
+                       paClipOff,
+                       NULL,
+                       NULL);
+    if (err != paNoError) {
+        rt_log(RT_LOG_ERROR, "Failed to open output stream: %s", Pa_GetErrorText(err));
+        pa->output_stream = NULL;
+        portaudio_stop(backend);
+        return -1;
+    }
+
+    // Start streams with debug prints
+    rt_log(RT_LOG_INFO, "Starting input stream...");
+    err = Pa_StartStream(pa->input_stream);
+    if (err != paNoError) {
+        rt_log(RT_LOG_ERROR, "Failed to start input stream: %s", Pa_GetErrorText(err));
+        portaudio_stop(backend);
+        return -1;
+    }
+
+    rt_log(RT_LOG_INFO, "Starting output stream...");
+    err = Pa_StartStream(pa->output_stream);
+    if (err != paNoError) {
+        rt_log(RT_LOG_ERROR, "Failed to start output stream: %s", Pa_GetErrorText(err));
+        portaudio_stop(backend);
+        return -1;
+    }
+
+    rt_log(RT_LOG_INFO, "Audio I/O initialized successfully");
+    return 0;
+}
+
+static AudioIoStatus portaudio_read(AudioBackend* backend, float* buffer, size_t frames) {
+    PortAudioState* pa = backend->state;
+    PaError err = Pa_ReadStream(pa->input_stream, buffer, frames);
+    if (err == paNoError) return AUDIO_IO_OK;
+    if (err == paInputOverflowed) return AUDIO_IO_OVERFLOW;
+    pa->last_error = err;
+    return AUDIO_IO_ERROR;
+}
+
+static AudioIoStatus portaudio_write(AudioBackend* backend, const float* buffer, size_t frames) {
+    PortAudioState* pa = backend->state;
+    PaError err = Pa_WriteStream(pa->output_stream, buffer, frames);
+    if (err == paNoError) return AUDIO_IO_OK;
+    if (err == paOutputUnderflowed) return AUDIO_IO_UNDERFLOW;
+    pa->last_error = err;
+    return AUDIO_IO_ERROR;
+}
+
+// What the host API actually granted, which may be more than was suggested
+static double portaudio_latency(AudioBackend* backend) {
+    PortAudioState* pa = backend->state;
+    const PaStreamInfo* input = pa->input_stream ? Pa_GetStreamInfo(pa->input_stream) : NULL;
+    const PaStreamInfo* output = pa->output_stream ? Pa_GetStreamInfo(pa->output_stream) : NULL;
+    return (input ? input->inputLatency : 0.0) + (output ? output->outputLatency : 0.0);
+}
+
+static const char* portaudio_error_text(AudioBackend* backend) {
+    PortAudioState* pa = backend->state;
+    return Pa_GetErrorText(pa->last_error);
+}
+
+/**
+ * Creates the PortAudio backend: blocking streams on the default input and
+ * output devices.
+ *
+ * @return The backend, or NULL on failure.
+ */
+AudioBackend* portaudio_backend_create(void) {
+    AudioBackend* backend = calloc(1, sizeof(AudioBackend));
+    PortAudioState* pa = calloc(1, sizeof(PortAudioState));
+    if (!backend || !pa) {
+        free(backend);
+        free(pa);
+        return NULL;
+    }
+    backend->name = "PortAudio";
+    backend->state = pa;
+    backend->start = portaudio_start;
+    backend->read = portaudio_read;
+    backend->write = portaudio_write;
+    backend->stop = portaudio_stop;
+    backend->error_text = portaudio_error_text;
+    backend->latency = portaudio_latency;
+    return backend;
+}
+
+/**
+ * Stops a backend (if it is running) and frees it.
+ *
+ * @param backend The backend (NULL is ignored).
+ */
+void audio_backend_destroy(AudioBackend* backend) {
+    if (!backend) return;
+    backend->stop(backend);
+    free(backend->state);
+    free(backend);
+}
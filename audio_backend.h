@@ -0,0 +1,32 @@
+#ifndef AUDIO_BACKEND_H
+#define AUDIO_BACKEND_H
+
+#include <stddef.h>
+
+// Result of one blocking read or write
+typedef enum {
+    AUDIO_IO_ERROR = -1,
+    AUDIO_IO_OK = 0,
+    AUDIO_IO_OVERFLOW,        // Read succeeded, but input before it was lost
+    AUDIO_IO_UNDERFLOW        // Written, but the device had already run dry (a missed deadline)
+} AudioIoStatus;
+
+// Blocking mono float I/O for the threaded pipeline. The input thread only
+// calls read() and the output thread only calls write(), so a backend needs
+// no locking between the two directions.
+typedef struct AudioBackend {
+    const char* name;
+    void* state;
+    int (*start)(struct AudioBackend* backend, size_t sample_rate, size_t frames, double latency);
+    AudioIoStatus (*read)(struct AudioBackend* backend, float* buffer, size_t frames);
+    AudioIoStatus (*write)(struct AudioBackend* backend, const float* buffer, size_t frames);
+    void (*stop)(struct AudioBackend* backend);
+    void (*report)(struct AudioBackend* backend);  // Prints device statistics (may be NULL)
+    const char* (*error_text)(struct AudioBackend* backend);  // Detail of the last error (may be NULL)
+    double (*latency)(struct AudioBackend* backend);  // Input + output latency while started, in seconds (may be NULL)
+} AudioBackend;
+
+AudioBackend* portaudio_backend_create(void);
+void audio_backend_destroy(AudioBackend* backend);
+
+#endif
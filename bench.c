@@ -0,0 +1,276 @@
+#include "voice_modulator.h"
+#include <time.h>
+
+// Micro-benchmarks for the DSP kernels.
+//
+// Output is CSV on stdout, one row per kernel/frame/pitch combination:
+//   kernel,frame_size,pitch,iterations,ns_per_frame,samples_per_sec,realtime_pct
+// frame_size is the number of audio samples one call accounts for, so
+// realtime_pct is the share of that many samples' playback time the call
+// takes at BENCH_SAMPLE_RATE. Lines starting with '#' describe the build.
+
+#define BENCH_SAMPLE_RATE 44100.0
+#define BENCH_MIN_SECONDS 0.2
+#define BENCH_WARMUP 16
+#define BENCH_MAX_FRAME (FRAME_SIZE * 4)
+
+typedef struct {
+    size_t length;
+    float pitch;
+    float* input;
+    float* output;
+    float* window;
+    float* prev_phase;
+    float* phase_accum;
+    float* bin_work;
+    fftwf_complex* bins;
+    CircularBuffer* ring;
+    PhaseVocoder* vocoder;
+    WsolaShifter* wsola;
+    DynamicsProcessor* dynamics;
+} BenchContext;
+
+typedef void (*BenchKernel)(BenchContext* ctx);
+
+static volatile float bench_sink;
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static void bench_phase_vocoder(BenchContext* ctx) {
+    phase_vocoder_process(ctx->vocoder, ctx->input, ctx->output, ctx->length, ctx->pitch, 1.0f);
+}
+
+static void bench_wsola(BenchContext* ctx) {
+    wsola_process(ctx->wsola, ctx->input, ctx->output, ctx->length, ctx->pitch);
+}
+
+static void bench_cross_correlate(BenchContext* ctx) {
+    cross_correlate(ctx->input, ctx->input + ctx->length, ctx->length, ctx->output, ctx->length);
+}
+
+static void bench_cross_correlate_scalar(BenchContext* ctx) {
+    cross_correlate_scalar(ctx->input, ctx->input + ctx->length, ctx->length, ctx->output, ctx->length);
+}
+
+static void bench_process_fft_bins(BenchContext* ctx) {
+    process_fft_bins(ctx->bins, ctx->prev_phase, ctx->phase_accum, ctx->bin_work, ctx->pitch);
+}
+
+static void bench_to_polar(BenchContext* ctx) {
+    cartesian_to_polar(ctx->bins, ctx->bin_work, ctx->bin_work + NUM_BINS, NUM_BINS);
+}
+
+static void bench_to_polar_scalar(BenchContext* ctx) {
+    cartesian_to_polar_scalar(ctx->bins, ctx->bin_work, ctx->bin_work + NUM_BINS, NUM_BINS);
+}
+
+static void bench_to_cartesian(BenchContext* ctx) {
+    polar_to_cartesian(ctx->bin_work, ctx->bin_work + NUM_BINS, ctx->bins, NUM_BINS);
+}
+
+static void bench_to_cartesian_scalar(BenchContext* ctx) {
+    polar_to_cartesian_scalar(ctx->bin_work, ctx->bin_work + NUM_BINS, ctx->bins, NUM_BINS);
+}
+
+static void bench_apply_window(BenchContext* ctx) {
+    apply_window_simd(ctx->output, ctx->window, ctx->length);
+}
+
+static void bench_rms(BenchContext* ctx) {
+    bench_sink = compute_frame_rms(ctx->input, ctx->length);
+}
+
+static void bench_gain_limiter(BenchContext* ctx) {
+    apply_gain_limiter(ctx->output, ctx->length, 1.0f);
+}
+
+static void bench_dynamics(BenchContext* ctx) {
+    memcpy(ctx->output, ctx->input, ctx->length * sizeof(float));
+    dynamics_process(ctx->dynamics, ctx->output, ctx->length);
+}
+
+static void bench_circular_buffer(BenchContext* ctx) {
+    circular_buffer_write(ctx->ring, ctx->input, ctx->length);
+    circular_buffer_read(ctx->ring, ctx->output, ctx->length);
+}
+
+/**
+ * Times one kernel and prints a CSV row.
+ *
+ * The kernel is warmed up, then the iteration count is doubled until one
+ * timed run lasts at least BENCH_MIN_SECONDS.
+ *
+ * @param name The kernel name for the report.
+ * @param kernel The function under test.
+ * @param ctx The buffers and settings passed to the kernel.
+ * @param samples The number of audio samples one call accounts for.
+ * @param has_pitch Whether the pitch column applies to this kernel.
+ */
+static void run_bench(const char* name, BenchKernel kernel, BenchContext* ctx,
+                      size_t samples, int has_pitch) {
+    for (int i = 0; i < BENCH_WARMUP; i++) {
+        kernel(ctx);
+    }
+
+    unsigned long iterations = 1;
+    double elapsed = 0.0;
+    for (;;) {
+        double start = now_seconds();
+        for (unsigned long i = 0; i < iterations; i++) {
+            kernel(ctx);
+        }
+        elapsed = now_seconds() - start;
+        if (elapsed >= BENCH_MIN_SECONDS) break;
+        iterations *= 2;
+    }
+
+    double ns_per_frame = elapsed * 1e9 / iterations;
+    double samples_per_sec = (double)samples * iterations / elapsed;
+    double budget_ns = samples * 1e9 / BENCH_SAMPLE_RATE;
+
+    printf("%s,%zu,", name, samples);
+    if (has_pitch) {
+        printf("%.2f,", ctx->pitch);
+    } else {
+        printf("NA,");
+    }
+    printf("%lu,%.1f,%.0f,%.3f\n", iterations, ns_per_frame, samples_per_sec,
+           100.0 * ns_per_frame / budget_ns);
+    fflush(stdout);
+}
+
+int main(int argc, char** argv) {
+    const size_t frame_sizes[] = { HOP_SIZE, FRAME_SIZE / 2, FRAME_SIZE, FRAME_SIZE * 2, FRAME_SIZE * 4 };
+    const float pitches[] = { 0.5f, 1.0f, 1.5f, 2.0f };
+    const size_t num_frames = sizeof(frame_sizes) / sizeof(frame_sizes[0]);
+    const size_t num_pitches = sizeof(pitches) / sizeof(pitches[0]);
+
+    // An optional argument forces a kernel set, e.g. to compare it with "scalar"
+    CpuIsa isa = CPU_ISA_AUTO;
+    if (argc > 1 && cpu_isa_parse(argv[1], &isa) < 0) {
+        fprintf(stderr, "Usage: %s [auto|scalar|sse4.2|avx2|avx512|neon]\n", argv[0]);
+        return 1;
+    }
+    if (spectral_kernels_init(isa) < 0) return 1;
+
+    BenchContext ctx = {0};
+    ctx.input = fftwf_malloc(sizeof(float) * BENCH_MAX_FRAME);
+    ctx.output = fftwf_malloc(sizeof(float) * BENCH_MAX_FRAME);
+    ctx.window = fftwf_malloc(sizeof(float) * BENCH_MAX_FRAME);
+    ctx.prev_phase = calloc(NUM_BINS, sizeof(float));
+    ctx.phase_accum = calloc(NUM_BINS, sizeof(float));
+    ctx.bin_work = calloc(4 * NUM_BINS, sizeof(float));
+    ctx.bins = fftwf_malloc(sizeof(fftwf_complex) * NUM_BINS);
+    ctx.ring = create_circular_buffer(BUFFER_SIZE);
+    if (!ctx.input || !ctx.output || !ctx.window || !ctx.prev_phase || !ctx.phase_accum ||
+        !ctx.bin_work || !ctx.bins || !ctx.ring) {
+        fprintf(stderr, "Error: Failed to allocate benchmark buffers.\n");
+        return 1;
+    }
+
+    // Speech-like test signal: a few harmonics plus a little noise
+    srand(1);
+    for (size_t i = 0; i < BENCH_MAX_FRAME; i++) {
+        float t = (float)i / BENCH_SAMPLE_RATE;
+        ctx.input[i] = 0.3f * sinf(2 * M_PI * 180.0f * t) + 0.15f * sinf(2 * M_PI * 360.0f * t)
+                     + 0.05f * sinf(2 * M_PI * 1250.0f * t) + 0.01f * ((float)rand() / RAND_MAX - 0.5f);
+        ctx.output[i] = ctx.input[i];
+        // Unity window and gain keep the repeatedly processed data out of the denormal range
+        ctx.window[i] = 1.0f;
+    }
+    for (size_t k = 0; k < NUM_BINS; k++) {
+        ctx.bins[k] = ((float)rand() / RAND_MAX - 0.5f) + I * ((float)rand() / RAND_MAX - 0.5f);
+    }
+
+    printf("# FRAME_SIZE=%d HOP_SIZE=%d NUM_BINS=%d sample_rate=%.0f spectral_isa=%s\n",
+           FRAME_SIZE, HOP_SIZE, NUM_BINS, BENCH_SAMPLE_RATE, spectral_kernels_isa());
+    printf("kernel,frame_size,pitch,iterations,ns_per_frame,samples_per_sec,realtime_pct\n");
+
+    // The phase vocoder is streaming, so each block size is a valid frame size;
+    // every size gets its own instance, primed for that block size
+    for (size_t p = 0; p < num_pitches; p++) {
+        ctx.pitch = pitches[p];
+        for (size_t f = 0; f < num_frames; f++) {
+            ctx.length = frame_sizes[f];
+            ctx.vocoder = phase_vocoder_create(ctx.length, NULL);
+            if (!ctx.vocoder) return 1;
+            run_bench("phase_vocoder", bench_phase_vocoder, &ctx, ctx.length, 1);
+            phase_vocoder_destroy(ctx.vocoder);
+            ctx.vocoder = NULL;
+        }
+    }
+
+    // The time-domain pitch engine on the same block sizes, for comparison
+    ctx.wsola = wsola_create((size_t)BENCH_SAMPLE_RATE, NULL);
+    if (!ctx.wsola) return 1;
+    for (size_t p = 0; p < num_pitches; p++) {
+        ctx.pitch = pitches[p];
+        for (size_t f = 0; f < num_frames; f++) {
+            ctx.length = frame_sizes[f];
+            run_bench("wsola", bench_wsola, &ctx, ctx.length, 1);
+        }
+    }
+    wsola_destroy(ctx.wsola);
+    ctx.wsola = NULL;
+
+    // One WSOLA splice search: an overlap-length reference against as many lags
+    ctx.length = (size_t)(WSOLA_OVERLAP_MS * 0.001 * BENCH_SAMPLE_RATE);
+    run_bench("cross_correlate", bench_cross_correlate, &ctx, ctx.length, 0);
+    run_bench("cross_correlate_scalar", bench_cross_correlate_scalar, &ctx, ctx.length, 0);
+
+    // One call handles one STFT frame, which advances the stream by HOP_SIZE
+    for (size_t p = 0; p < num_pitches; p++) {
+        ctx.pitch = pitches[p];
+        run_bench("process_fft_bins", bench_process_fft_bins, &ctx, HOP_SIZE, 1);
+    }
+
+    // Polar/cartesian kernels against their libm references, one STFT frame each
+    run_bench("cartesian_to_polar", bench_to_polar, &ctx, HOP_SIZE, 0);
+    run_bench("cartesian_to_polar_scalar", bench_to_polar_scalar, &ctx, HOP_SIZE, 0);
+    run_bench("polar_to_cartesian", bench_to_cartesian, &ctx, HOP_SIZE, 0);
+    run_bench("polar_to_cartesian_scalar", bench_to_cartesian_scalar, &ctx, HOP_SIZE, 0);
+
+    for (size_t f = 0; f < num_frames; f++) {
+        ctx.length = frame_sizes[f];
+        run_bench("apply_window_simd", bench_apply_window, &ctx, ctx.length, 0);
+    }
+
+    for (size_t f = 0; f < num_frames; f++) {
+        ctx.length = frame_sizes[f];
+        run_bench("frame_rms", bench_rms, &ctx, ctx.length, 0);
+    }
+
+    for (size_t f = 0; f < num_frames; f++) {
+        ctx.length = frame_sizes[f];
+        run_bench("gain_limiter", bench_gain_limiter, &ctx, ctx.length, 0);
+    }
+
+    // The whole output level stage (gate, AGC and limiter), which replaced frame_rms + gain_limiter
+    ctx.dynamics = dynamics_create((size_t)BENCH_SAMPLE_RATE, DYNAMICS_LOOKAHEAD, NULL);
+    if (!ctx.dynamics) return 1;
+    for (size_t f = 0; f < num_frames; f++) {
+        ctx.length = frame_sizes[f];
+        run_bench("dynamics", bench_dynamics, &ctx, ctx.length, 0);
+    }
+    dynamics_destroy(ctx.dynamics);
+    ctx.dynamics = NULL;
+
+    for (size_t f = 0; f < num_frames; f++) {
+        ctx.length = frame_sizes[f];
+        run_bench("circular_buffer_write_read", bench_circular_buffer, &ctx, ctx.length, 0);
+    }
+
+    destroy_circular_buffer(ctx.ring);
+    fftwf_free(ctx.input);
+    fftwf_free(ctx.output);
+    fftwf_free(ctx.window);
+    fftwf_free(ctx.bins);
+    free(ctx.prev_phase);
+    free(ctx.phase_accum);
+    free(ctx.bin_work);
+    return 0;
+}
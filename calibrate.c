@@ -0,0 +1,199 @@
+#include "calibrate.h"
+#include "rt_log.h"
+#include <math.h>
+#include <stdlib.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// Samples per second of wall-clock time, which the virtual device's clock may outrun
+static double device_rate(const ModulationParams* params) {
+    return params->virtual_device ? params->sample_rate * (double)params->virtual_device->clock_scale
+                                  : (double)params->sample_rate;
+}
+
+/**
+ * Times process_audio_frame() on a chain built for block_size. The input
+ * is a two-tone signal well above the noise gate, and the echo and reverb
+ * are on even if the parameters have them off, since the GUI can turn
+ * them up at any time.
+ *
+ * @return 0 on success, -1 on failure.
+ */
+static int measure_dsp(const ModulationParams* params, size_t block_size, LatencyHistogram* hist,
+                       CalibrationResult* result) {
+    DspChain* dsp = dsp_chain_create(block_size, params->sample_rate, params->reverb_ir_path, params->lookahead);
+    float* input = malloc(block_size * sizeof(float));
+    float* output = malloc(block_size * sizeof(float));
+    int status = dsp && input && output ? 0 : -1;
+
+    ModulationParams worst = *params;
+    if (worst.echo_intensity < 0.5f) worst.echo_intensity = 0.5f;
+    if (worst.reverb_intensity < 0.5f) worst.reverb_intensity = 0.5f;
+
+    // Enough blocks to resolve the target percentile, unless that takes too long
+    unsigned long needed = (unsigned long)ceilf(10.0f / params->calibrate_miss_rate);
+    uint64_t stop = stats_now_ns() + (uint64_t)(CALIBRATE_DSP_SECONDS * 1e9);
+    double step = 2.0 * M_PI / params->sample_rate;
+    size_t position = 0;
+
+    for (unsigned long block = 0; status == 0; block++) {
+        for (size_t i = 0; i < block_size; i++, position++) {
+            double t = step * (double)(position % params->sample_rate);
+            input[i] = (float)(0.3 * sin(220.0 * t) + 0.1 * sin(1375.0 * t));
+        }
+        uint64_t start = stats_now_ns();
+        if (process_audio_frame(dsp, input, output, block_size, &worst) < 0) {
+            status = -1;
+            break;
+        }
+        uint64_t end = stats_now_ns();
+        if (block < CALIBRATE_WARMUP_BLOCKS) continue;
+
+        latency_histogram_record(hist, end - start);
+        if (block + 1 - CALIBRATE_WARMUP_BLOCKS >= needed || end >= stop) break;
+    }
+
+    if (status == 0) result->dsp_latency = (double)dsp_chain_latency(dsp, params) / params->sample_rate;
+    free(input);
+    free(output);
+    dsp_chain_destroy(dsp);
+    return status;
+}
+
+/**
+ * Opens the device the pipeline will use with block_size-sample blocks,
+ * records the latency it reports, and reads from it for
+ * CALIBRATE_DEVICE_SECONDS. Each read should return one period after the
+ * previous one; how late it returns compared with the earliest read is
+ * the wakeup jitter the pipeline has to absorb.
+ *
+ * @return 0 on success, -1 if the device could not be used.
+ */
+static int measure_device(const ModulationParams* params, size_t block_size, LatencyHistogram* hist,
+                          CalibrationResult* result) {
+    AudioBackend* backend = params->virtual_device ? virtual_device_create(params->virtual_device)
+                                                   : portaudio_backend_create();
+    if (!backend) return -1;
+
+    size_t reads = (size_t)(CALIBRATE_DEVICE_SECONDS * params->sample_rate / block_size) + 2;
+    float* buffer = malloc(block_size * sizeof(float));
+    uint64_t* returned = malloc(reads * sizeof(uint64_t));
+    if (!buffer || !returned ||
+        backend->start(backend, params->sample_rate, block_size, params->device_latency) < 0) {
+        free(buffer);
+        free(returned);
+        audio_backend_destroy(backend);
+        return -1;
+    }
+    result->device_latency = backend->latency ? backend->latency(backend) : 0.0;
+
+    int status = 0;
+    for (size_t i = 0; i < reads && status == 0; i++) {
+        AudioIoStatus io = backend->read(backend, buffer, block_size);
+        returned[i] = stats_now_ns();
+        if (io == AUDIO_IO_ERROR) status = -1;
+        // The first read also waits for the stream to start
+        if (io == AUDIO_IO_OVERFLOW && i > 0) result->device_misses++;
+    }
+    audio_backend_destroy(backend);
+
+    if (status == 0) {
+        uint64_t period_ns = (uint64_t)(block_size * 1e9 / device_rate(params));
+        uint64_t earliest = UINT64_MAX;
+        for (size_t i = 1; i < reads; i++) {
+            uint64_t offset = returned[i] - i * period_ns;
+            if (offset < earliest) earliest = offset;
+        }
+        for (size_t i = 1; i < reads; i++) {
+            latency_histogram_record(hist, returned[i] - i * period_ns - earliest);
+        }
+        result->reads = reads - 1;
+    }
+    free(buffer);
+    free(returned);
+    return status;
+}
+
+/**
+ * Measures whether the live pipeline can run with block_size-sample blocks
+ * on this machine. A block misses its deadline when its DSP time plus the
+ * device's wakeup jitter exceeds one period, so the target percentile
+ * (1 - calibrate_miss_rate) of both together must fit in
+ * CALIBRATE_LOAD_LIMIT of a period, and the device itself must not have
+ * lost input more often than the target rate while probing.
+ *
+ * Must be called after fft_planner_configure() and before the live streams
+ * start: it opens the device on its own.
+ *
+ * @param params The live parameters (calibrate_miss_rate must be set).
+ * @param block_size The candidate block size in samples.
+ * @param result Receives the measurements.
+ * @return 0 on success, -1 if the DSP chain or the device failed.
+ */
+int calibrate_block_size(const ModulationParams* params, size_t block_size, CalibrationResult* result) {
+    memset(result, 0, sizeof(*result));
+    result->block_size = block_size;
+    result->period = block_size / device_rate(params);
+
+    double quantile = 1.0 - params->calibrate_miss_rate;
+    LatencyHistogram hist;
+    latency_histogram_reset(&hist);
+    if (measure_dsp(params, block_size, &hist, result) < 0) return -1;
+    result->dsp_time = latency_histogram_quantile(&hist, quantile);
+
+    latency_histogram_reset(&hist);
+    if (measure_device(params, block_size, &hist, result) < 0) return -1;
+    result->wakeup_jitter = latency_histogram_quantile(&hist, quantile);
+
+    result->meets_target = result->dsp_time + result->wakeup_jitter <= CALIBRATE_LOAD_LIMIT * result->period &&
+                           result->device_misses <= params->calibrate_miss_rate * result->reads;
+    return 0;
+}
+
+/**
+ * Picks the smallest live block size that meets params->calibrate_miss_rate
+ * on this machine and writes it to frame_size and callback_size, so it
+ * applies in either pipeline mode. Candidates are 1, 2, 4 ...
+ * CALIBRATE_MAX_HOPS hops long (whole hops keep the phase vocoder from
+ * needing extra priming) and are tried from the smallest up; if none
+ * meets the target the largest is used. Everything it prints goes through
+ * rt_log.
+ *
+ * @param params The live parameters.
+ * @return 0 on success, -1 if a measurement failed.
+ */
+int calibrate_live_config(ModulationParams* params) {
+    double percentile = (1.0 - params->calibrate_miss_rate) * 100.0;
+    CalibrationResult result;
+
+    rt_log(RT_LOG_INFO, "Calibrating for at most %.3g%% late blocks", params->calibrate_miss_rate * 100.0);
+    for (size_t hops = 1; hops <= CALIBRATE_MAX_HOPS; hops *= 2) {
+        if (calibrate_block_size(params, hops * HOP_SIZE, &result) < 0) {
+            rt_log(RT_LOG_ERROR, "Calibration failed at %zu-sample blocks.", hops * HOP_SIZE);
+            return -1;
+        }
+        rt_log(RT_LOG_INFO, "Calibration: %zu samples: DSP %.3f ms + jitter %.3f ms (p%.4g) of %.3f ms, "
+               "device latency %.2f ms, %lu/%lu device misses%s",
+               result.block_size, result.dsp_time * 1000.0, result.wakeup_jitter * 1000.0, percentile,
+               result.period * 1000.0, result.device_latency * 1000.0, result.device_misses, result.reads,
+               result.meets_target ? "" : " (too small)");
+        if (result.meets_target) break;
+    }
+
+    if (!result.meets_target) {
+        rt_log(RT_LOG_WARNING, "No block size meets the target on this machine; using %zu samples",
+               result.block_size);
+    }
+    params->frame_size = result.block_size;
+    params->callback_size = result.block_size;
+
+    rt_log(RT_LOG_INFO, "Calibration: using %zu-sample blocks, about %.1f ms from input to output "
+           "(block %.1f ms, DSP %.1f ms, device %.1f ms)",
+           result.block_size,
+           ((double)result.block_size / params->sample_rate + result.dsp_latency + result.device_latency) * 1000.0,
+           (double)result.block_size * 1000.0 / params->sample_rate, result.dsp_latency * 1000.0,
+           result.device_latency * 1000.0);
+    return 0;
+}
@@ -0,0 +1,29 @@
+#ifndef CALIBRATE_H
+#define CALIBRATE_H
+
+#include "voice_modulator.h"
+
+#define CALIBRATE_MISS_RATE 0.001f    // Typical target: at most 1 late block in 1000
+#define CALIBRATE_LOAD_LIMIT 0.7      // Share of a block period the DSP and the wakeup jitter may use together
+#define CALIBRATE_DSP_SECONDS 1.0     // Longest time spent timing the DSP at one block size
+#define CALIBRATE_DEVICE_SECONDS 0.5  // Device time the input is read for at one block size
+#define CALIBRATE_WARMUP_BLOCKS 16    // Untimed blocks first (priming, caches)
+#define CALIBRATE_MAX_HOPS 16         // Largest candidate block in hops (LIVE_MAX_BLOCK_SIZE)
+
+// What one candidate block size measured
+typedef struct {
+    size_t block_size;
+    double period;                // Wall time per block (seconds)
+    double dsp_time;              // DSP time per block at the target percentile (seconds)
+    double wakeup_jitter;         // How late the device's reads returned, same percentile (seconds)
+    double dsp_latency;           // Delay of the DSP chain built for this block size (seconds)
+    double device_latency;        // Input + output latency the device reported (seconds, 0 = unknown)
+    unsigned long device_misses;  // Reads that lost input while probing
+    unsigned long reads;
+    int meets_target;
+} CalibrationResult;
+
+int calibrate_block_size(const ModulationParams* params, size_t block_size, CalibrationResult* result);
+int calibrate_live_config(ModulationParams* params);
+
+#endif
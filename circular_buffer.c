@@ -0,0 +1,163 @@
+#include "circular_buffer.h"
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Rounds a size up to the next power of two.
+ *
+ * @param n The requested size.
+ * @return The smallest power of two that is >= n (1 for n == 0).
+ */
+static size_t next_power_of_two(size_t n) {
+    size_t p = 1;
+    while (p < n) {
+        p <<= 1;
+    }
+    return p;
+}
+
+/**
+ * Creates a lock-free single-producer/single-consumer circular buffer.
+ *
+ * The requested size is rounded up to a power of two so that positions can
+ * be wrapped with a mask instead of a modulo. The buffer is zero-filled and
+ * both positions start at zero. Exactly one thread may write and exactly one
+ * thread may read; neither side ever blocks or takes a lock.
+ *
+ * @param size The minimum capacity of the circular buffer in floats.
+ * @return A pointer to the created CircularBuffer object, or NULL on failure.
+ */
+CircularBuffer* create_circular_buffer(size_t size) {
+    return create_circular_buffer_in(NULL, size);
+}
+
+/**
+ * create_circular_buffer() with the struct and storage taken from a DSP
+ * arena, so a pipeline's queues sit in its locked memory.
+ *
+ * @param arena The arena, or NULL for the heap.
+ * @param size The minimum capacity in floats.
+ * @return The circular buffer, or NULL on failure.
+ */
+CircularBuffer* create_circular_buffer_in(DspArena* arena, size_t size) {
+    if (size == 0) return NULL;
+
+    CircularBuffer* cb = dsp_alloc_aligned(arena, sizeof(CircularBuffer), CACHE_LINE_SIZE);
+    if (!cb) return NULL;
+
+    cb->arena = arena;
+    cb->size = next_power_of_two(size);
+    cb->mask = cb->size - 1;
+    cb->buffer = dsp_alloc_aligned(arena, cb->size * sizeof(float), CACHE_LINE_SIZE);
+    if (!cb->buffer) {
+        dsp_free(arena, cb);
+        return NULL;
+    }
+
+    atomic_init(&cb->write_pos, 0);
+    atomic_init(&cb->read_pos, 0);
+    return cb;
+}
+
+/**
+ * Releases a circular buffer and its storage.
+ *
+ * Both the producer and the consumer must have stopped using the buffer.
+ *
+ * @param cb The circular buffer to destroy (may be NULL).
+ */
+void destroy_circular_buffer(CircularBuffer* cb) {
+    if (!cb) return;
+    dsp_free(cb->arena, cb->buffer);
+    dsp_free(cb->arena, cb);
+}
+
+/**
+ * Returns the number of floats that can currently be read.
+ *
+ * Safe to call from either side; the value is a lower bound for the consumer
+ * and an upper bound for the producer.
+ *
+ * @param cb The circular buffer to query.
+ * @return The fill level in floats.
+ */
+size_t circular_buffer_available(CircularBuffer* cb) {
+    size_t write_pos = atomic_load_explicit(&cb->write_pos, memory_order_acquire);
+    size_t read_pos = atomic_load_explicit(&cb->read_pos, memory_order_acquire);
+    return write_pos - read_pos;
+}
+
+/**
+ * Returns the number of floats that can currently be written.
+ *
+ * @param cb The circular buffer to query.
+ * @return The free space in floats.
+ */
+size_t circular_buffer_space(CircularBuffer* cb) {
+    return cb->size - circular_buffer_available(cb);
+}
+
+/**
+ * Writes the specified data to the circular buffer.
+ *
+ * Producer side only. The write is all-or-nothing: if there is not enough
+ * free space for the whole block nothing is written, so the consumer never
+ * observes a partial frame. The data is copied with at most two memcpy calls
+ * (one before and one after the wrap point) and then published with a single
+ * release store of the write position.
+ *
+ * @param cb The circular buffer to write to.
+ * @param data The data to write.
+ * @param length The amount of data to write in floats.
+ * @return 0 on success, -1 if the buffer does not have room for length floats.
+ */
+int circular_buffer_write(CircularBuffer* cb, const float* data, size_t length) {
+    size_t write_pos = atomic_load_explicit(&cb->write_pos, memory_order_relaxed);
+    size_t read_pos = atomic_load_explicit(&cb->read_pos, memory_order_acquire);
+
+    if (length > cb->size - (write_pos - read_pos)) {
+        return -1;
+    }
+
+    size_t start = write_pos & cb->mask;
+    size_t first = cb->size - start;
+    if (first > length) first = length;
+
+    memcpy(cb->buffer + start, data, first * sizeof(float));
+    memcpy(cb->buffer, data + first, (length - first) * sizeof(float));
+
+    atomic_store_explicit(&cb->write_pos, write_pos + length, memory_order_release);
+    return 0;
+}
+
+/**
+ * Reads the specified amount of data from the circular buffer.
+ *
+ * Consumer side only. The read is all-or-nothing: if fewer than length floats
+ * are available nothing is consumed. The data is copied out with at most two
+ * memcpy calls and the space is handed back to the producer with a single
+ * release store of the read position.
+ *
+ * @param cb The circular buffer to read from.
+ * @param data The array to store the read data in.
+ * @param length The amount of data to read in floats.
+ * @return 0 on success, -1 if fewer than length floats are available.
+ */
+int circular_buffer_read(CircularBuffer* cb, float* data, size_t length) {
+    size_t read_pos = atomic_load_explicit(&cb->read_pos, memory_order_relaxed);
+    size_t write_pos = atomic_load_explicit(&cb->write_pos, memory_order_acquire);
+
+    if (length > write_pos - read_pos) {
+        return -1;
+    }
+
+    size_t start = read_pos & cb->mask;
+    size_t first = cb->size - start;
+    if (first > length) first = length;
+
+    memcpy(data, cb->buffer + start, first * sizeof(float));
+    memcpy(data + first, cb->buffer, (length - first) * sizeof(float));
+
+    atomic_store_explicit(&cb->read_pos, read_pos + length, memory_order_release);
+    return 0;
+}
@@ -0,0 +1,33 @@
+#ifndef CIRCULAR_BUFFER_H
+#define CIRCULAR_BUFFER_H
+
+#include <stddef.h>
+#include <stdatomic.h>
+#include "dsp_arena.h"
+
+#ifndef CACHE_LINE_SIZE
+#define CACHE_LINE_SIZE 128  // Apple M-series uses 128-byte lines; harmless padding on x86
+#endif
+
+// Wait-free single-producer/single-consumer ring of floats.
+// Positions are free-running counters; the capacity is a power of two so
+// wrapping is a mask. The producer owns write_pos and the consumer owns
+// read_pos, each on its own cache line to avoid false sharing.
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) atomic_size_t write_pos;
+    _Alignas(CACHE_LINE_SIZE) atomic_size_t read_pos;
+    _Alignas(CACHE_LINE_SIZE) float* buffer;
+    size_t size;  // Capacity in floats (power of two)
+    size_t mask;
+    DspArena* arena;  // Owner of the struct and storage (NULL = heap)
+} CircularBuffer;
+
+CircularBuffer* create_circular_buffer(size_t size);
+CircularBuffer* create_circular_buffer_in(DspArena* arena, size_t size);
+void destroy_circular_buffer(CircularBuffer* cb);
+int circular_buffer_write(CircularBuffer* cb, const float* data, size_t length);
+int circular_buffer_read(CircularBuffer* cb, float* data, size_t length);
+size_t circular_buffer_available(CircularBuffer* cb);
+size_t circular_buffer_space(CircularBuffer* cb);
+
+#endif
@@ -0,0 +1,73 @@
+#include "cpu_features.h"
+#include <string.h>
+
+#if defined(__aarch64__) && defined(__linux__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
+static const char* isa_names[CPU_ISA_COUNT] = { "scalar", "sse4.2", "avx2", "avx512", "neon" };
+
+/**
+ * Finds the best kernel set the CPU and the OS support: CPUID on x86
+ * (which also checks that the OS saves the wider registers), HWCAP on
+ * Linux/AArch64. Every other AArch64 system has Advanced SIMD.
+ *
+ * @return The instruction set.
+ */
+CpuIsa cpu_detect_isa(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512dq")) return CPU_ISA_AVX512;
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return CPU_ISA_AVX2;
+    if (__builtin_cpu_supports("sse4.2")) return CPU_ISA_SSE42;
+    return CPU_ISA_SCALAR;
+#elif defined(__aarch64__) && defined(__linux__)
+    return (getauxval(AT_HWCAP) & HWCAP_ASIMD) ? CPU_ISA_NEON : CPU_ISA_SCALAR;
+#elif defined(__aarch64__)
+    return CPU_ISA_NEON;
+#else
+    return CPU_ISA_SCALAR;
+#endif
+}
+
+/**
+ * @param isa An instruction set.
+ * @return 1 if this CPU can run it, 0 otherwise.
+ */
+int cpu_isa_supported(CpuIsa isa) {
+    CpuIsa best = cpu_detect_isa();
+    if (isa == CPU_ISA_SCALAR || isa == best) return 1;
+    return best != CPU_ISA_NEON && isa > CPU_ISA_SCALAR && isa < best;
+}
+
+/**
+ * @param isa An instruction set.
+ * @return Its name in options and logs.
+ */
+const char* cpu_isa_name(CpuIsa isa) {
+    if (isa == CPU_ISA_AUTO) return "auto";
+    return isa >= 0 && isa < CPU_ISA_COUNT ? isa_names[isa] : "unknown";
+}
+
+/**
+ * Parses an instruction set name ("auto", "scalar", "sse4.2", "avx2",
+ * "avx512" or "neon").
+ *
+ * @param name The name.
+ * @param isa Receives the instruction set.
+ * @return 0 on success, -1 if the name is unknown.
+ */
+int cpu_isa_parse(const char* name, CpuIsa* isa) {
+    if (strcmp(name, "auto") == 0) {
+        *isa = CPU_ISA_AUTO;
+        return 0;
+    }
+    for (int i = 0; i < CPU_ISA_COUNT; i++) {
+        if (strcmp(name, isa_names[i]) == 0) {
+            *isa = (CpuIsa)i;
+            return 0;
+        }
+    }
+    return -1;
+}
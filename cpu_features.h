@@ -0,0 +1,21 @@
+#ifndef CPU_FEATURES_H
+#define CPU_FEATURES_H
+
+// Instruction sets the DSP kernels are built for. The x86 sets are ordered:
+// a CPU that runs one also runs every set before it.
+typedef enum {
+    CPU_ISA_AUTO = -1,         // The best set this CPU supports
+    CPU_ISA_SCALAR = 0,        // Portable C (auto-vectorised for the build's baseline)
+    CPU_ISA_SSE42,             // SSE4.2
+    CPU_ISA_AVX2,              // AVX2 + FMA
+    CPU_ISA_AVX512,            // AVX-512 F + DQ
+    CPU_ISA_NEON,              // AArch64 Advanced SIMD
+    CPU_ISA_COUNT
+} CpuIsa;
+
+CpuIsa cpu_detect_isa(void);
+int cpu_isa_supported(CpuIsa isa);
+const char* cpu_isa_name(CpuIsa isa);
+int cpu_isa_parse(const char* name, CpuIsa* isa);
+
+#endif
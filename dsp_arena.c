@@ -0,0 +1,244 @@
+#include "dsp_arena.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// Set on threads that run the audio path (see dsp_realtime_enter())
+static _Thread_local int realtime_thread = 0;
+
+static void realtime_violation(const char* what) {
+    // Called from inside the allocator: no stdio, it may allocate itself
+    static const char prefix[] = "Error: ";
+    static const char suffix[] = " on a real-time audio thread\n";
+    realtime_thread = 0;
+    write(STDERR_FILENO, prefix, sizeof(prefix) - 1);
+    write(STDERR_FILENO, what, strlen(what));
+    write(STDERR_FILENO, suffix, sizeof(suffix) - 1);
+    abort();
+}
+
+#if defined(DEBUG) && defined(__GLIBC__)
+// Debug builds on glibc check the allocator itself, which also catches
+// allocations inside libraries called from the audio path
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t count, size_t size);
+extern void* __libc_realloc(void* ptr, size_t size);
+extern void __libc_free(void* ptr);
+
+void* malloc(size_t size) {
+    if (realtime_thread) realtime_violation("malloc");
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) {
+    if (realtime_thread) realtime_violation("calloc");
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* ptr, size_t size) {
+    if (realtime_thread) realtime_violation("realloc");
+    return __libc_realloc(ptr, size);
+}
+
+void free(void* ptr) {
+    if (realtime_thread && ptr) realtime_violation("free");
+    __libc_free(ptr);
+}
+#endif
+
+/**
+ * Marks the calling thread as part of the audio path until
+ * dsp_realtime_leave(). dsp_alloc() refuses to run on such a thread, and in
+ * debug builds on glibc so do malloc, calloc, realloc and free.
+ */
+void dsp_realtime_enter(void) {
+    realtime_thread = 1;
+}
+
+void dsp_realtime_leave(void) {
+    realtime_thread = 0;
+}
+
+/**
+ * @return Non-zero on a thread marked with dsp_realtime_enter().
+ */
+int dsp_in_realtime(void) {
+    return realtime_thread;
+}
+
+static size_t page_size(void) {
+    long size = sysconf(_SC_PAGESIZE);
+    return size > 0 ? (size_t)size : 4096;
+}
+
+static DspArenaChunk* add_chunk(DspArena* arena, size_t size) {
+    size_t page = page_size();
+    size = (size + page - 1) / page * page;
+
+    DspArenaChunk* chunk = calloc(1, sizeof(DspArenaChunk));
+    if (!chunk || posix_memalign((void**)&chunk->data, page, size) != 0) {
+        free(chunk);
+        return NULL;
+    }
+    // Zeroing touches every page now rather than on the audio path
+    memset(chunk->data, 0, size);
+    chunk->size = size;
+    chunk->next = arena->chunks;
+    arena->chunks = chunk;
+    arena->reserved += size;
+    return chunk;
+}
+
+/**
+ * Creates an arena with one chunk of at least `size` bytes. More chunks
+ * are added while the pipeline is being built if that runs out.
+ *
+ * @param size Bytes to reserve up front (0 = DSP_ARENA_CHUNK).
+ * @return The arena, or NULL on failure.
+ */
+DspArena* dsp_arena_create(size_t size) {
+    DspArena* arena = calloc(1, sizeof(DspArena));
+    if (!arena || !add_chunk(arena, size > 0 ? size : DSP_ARENA_CHUNK)) {
+        printf("Error: Failed to allocate DSP arena\n");
+        free(arena);
+        return NULL;
+    }
+    return arena;
+}
+
+/**
+ * Unlocks and frees every chunk. Everything allocated from the arena is
+ * gone afterwards.
+ *
+ * @param arena The arena (NULL is ignored).
+ */
+void dsp_arena_destroy(DspArena* arena) {
+    if (!arena) return;
+    DspArenaChunk* chunk = arena->chunks;
+    while (chunk) {
+        DspArenaChunk* next = chunk->next;
+        if (arena->locked) dsp_unlock_memory(chunk->data, chunk->size);
+        free(chunk->data);
+        free(chunk);
+        chunk = next;
+    }
+    free(arena);
+}
+
+/**
+ * Allocates zeroed memory aligned to `alignment` (a power of two).
+ *
+ * With a NULL arena the block comes from the heap and must be released with
+ * dsp_free(NULL, ptr); arena blocks live as long as the arena and
+ * dsp_free() ignores them. Either way this must not run on an audio thread
+ * or after the arena was frozen.
+ *
+ * @param arena The arena, or NULL for the heap.
+ * @param size Bytes to allocate.
+ * @param alignment Required alignment (at least DSP_ARENA_ALIGN is used).
+ * @return The block, or NULL on failure.
+ */
+void* dsp_alloc_aligned(DspArena* arena, size_t size, size_t alignment) {
+    if (realtime_thread) realtime_violation("dsp_alloc");
+    if (alignment < DSP_ARENA_ALIGN) alignment = DSP_ARENA_ALIGN;
+    if (size == 0) size = 1;
+
+    if (!arena) {
+        void* ptr = NULL;
+        if (posix_memalign(&ptr, alignment, size) != 0) return NULL;
+        memset(ptr, 0, size);
+        return ptr;
+    }
+
+    if (arena->frozen) {
+        printf("Error: DSP arena is frozen; allocation of %zu bytes refused\n", size);
+        return NULL;
+    }
+
+    DspArenaChunk* chunk = arena->chunks;
+    size_t offset = (chunk->used + alignment - 1) & ~(alignment - 1);
+    if (offset + size > chunk->size) {
+        size_t want = size + alignment > DSP_ARENA_CHUNK ? size + alignment : DSP_ARENA_CHUNK;
+        chunk = add_chunk(arena, want);
+        if (!chunk) return NULL;
+        offset = 0;  // Chunks are page aligned
+    }
+
+    arena->used += offset + size - chunk->used;
+    chunk->used = offset + size;
+    return chunk->data + offset;
+}
+
+/**
+ * dsp_alloc_aligned() with DSP_ARENA_ALIGN.
+ */
+void* dsp_alloc(DspArena* arena, size_t size) {
+    return dsp_alloc_aligned(arena, size, DSP_ARENA_ALIGN);
+}
+
+/**
+ * Releases a block from dsp_alloc(). Arena blocks are only released with the
+ * arena, so this does nothing for them.
+ *
+ * @param arena The arena the block came from, or NULL for the heap.
+ * @param ptr The block (NULL is ignored).
+ */
+void dsp_free(DspArena* arena, void* ptr) {
+    if (!arena) free(ptr);
+}
+
+/**
+ * Refuses any further allocation from the arena. Call once the pipeline is
+ * built.
+ *
+ * @param arena The arena.
+ */
+void dsp_arena_freeze(DspArena* arena) {
+    arena->frozen = 1;
+}
+
+/**
+ * Pins the arena's pages in RAM so the audio path never waits for one to
+ * be paged back in. Failing (usually RLIMIT_MEMLOCK) is not fatal; the
+ * caller reports it.
+ *
+ * @param arena The arena.
+ * @return 0 if every chunk is locked, -1 otherwise.
+ */
+int dsp_arena_lock(DspArena* arena) {
+    if (arena->locked) return 0;
+    for (DspArenaChunk* chunk = arena->chunks; chunk; chunk = chunk->next) {
+        if (dsp_lock_memory(chunk->data, chunk->size) < 0) {
+            for (DspArenaChunk* done = arena->chunks; done != chunk; done = done->next) {
+                dsp_unlock_memory(done->data, done->size);
+            }
+            return -1;
+        }
+    }
+    arena->locked = 1;
+    return 0;
+}
+
+/**
+ * Touches and locks a range of memory allocated elsewhere (for data shared
+ * between arenas).
+ *
+ * @return 0 on success, -1 if the range could not be locked.
+ */
+int dsp_lock_memory(void* ptr, size_t size) {
+    if (!ptr || size == 0) return 0;
+    // Read-modify-write every page so it is present before mlock
+    size_t page = page_size();
+    volatile unsigned char* bytes = ptr;
+    for (size_t i = 0; i < size; i += page) {
+        bytes[i] = bytes[i];
+    }
+    return mlock(ptr, size) == 0 ? 0 : -1;
+}
+
+void dsp_unlock_memory(void* ptr, size_t size) {
+    if (ptr && size > 0) munlock(ptr, size);
+}
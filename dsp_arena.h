@@ -0,0 +1,44 @@
+#ifndef DSP_ARENA_H
+#define DSP_ARENA_H
+
+#include <stddef.h>
+
+#define DSP_ARENA_ALIGN 64                 // Alignment of every dsp_alloc() block (AVX-512 / cache line)
+#define DSP_ARENA_CHUNK (512 * 1024)       // Default chunk size; larger requests get their own chunk
+
+typedef struct DspArenaChunk {
+    struct DspArenaChunk* next;
+    unsigned char* data;
+    size_t size;
+    size_t used;
+} DspArenaChunk;
+
+// Bump allocator that holds all of one pipeline's DSP state. Memory is
+// handed out zeroed (so every page is touched at init) and released only
+// with the arena. Once frozen it refuses further allocations; once locked
+// its pages stay resident, so the audio path never page-faults on it.
+typedef struct {
+    DspArenaChunk* chunks;
+    size_t reserved;                       // Bytes in all chunks
+    size_t used;                           // Bytes handed out (including alignment padding)
+    int frozen;
+    int locked;                            // Every chunk is mlock()ed
+} DspArena;
+
+DspArena* dsp_arena_create(size_t size);
+void dsp_arena_destroy(DspArena* arena);
+void* dsp_alloc(DspArena* arena, size_t size);
+void* dsp_alloc_aligned(DspArena* arena, size_t size, size_t alignment);
+void dsp_free(DspArena* arena, void* ptr);
+void dsp_arena_freeze(DspArena* arena);
+int dsp_arena_lock(DspArena* arena);
+int dsp_lock_memory(void* ptr, size_t size);
+void dsp_unlock_memory(void* ptr, size_t size);
+
+// Audio threads mark themselves; debug builds abort if such a thread
+// allocates (see dsp_arena.c)
+void dsp_realtime_enter(void);
+void dsp_realtime_leave(void);
+int dsp_in_realtime(void);
+
+#endif
@@ -0,0 +1,229 @@
+#ifdef __linux__
+#define _GNU_SOURCE
+#endif
+#include "dsp_pool.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __APPLE__
+#include <mach/mach.h>
+#include <mach/thread_policy.h>
+#endif
+
+// Roughly 50-100 us of spinning before a worker parks
+#define SPIN_ITERATIONS 20000
+
+typedef struct {
+    DspPool* pool;
+    int index;
+    int pin;
+} WorkerArgs;
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+/**
+ * Pins the calling thread to one core.
+ *
+ * Linux uses a hard affinity mask. macOS has no hard pinning, so each
+ * worker gets its own affinity tag, which keeps workers on separate cores.
+ * Failure is not fatal: the worker just runs unpinned.
+ *
+ * @param core The core (or affinity tag) to use.
+ */
+void dsp_pin_current_thread(int core) {
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(core, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#elif defined(__APPLE__)
+    thread_affinity_policy_data_t policy = { core + 1 };
+    thread_policy_set(pthread_mach_thread_np(pthread_self()), THREAD_AFFINITY_POLICY,
+                      (thread_policy_t)&policy, THREAD_AFFINITY_POLICY_COUNT);
+#else
+    (void)core;
+#endif
+}
+
+static void run_items(DspPool* pool) {
+    size_t index;
+    while ((index = atomic_fetch_add_explicit(&pool->next, 1, memory_order_relaxed)) < pool->count) {
+        pool->task(pool->arg, index);
+    }
+}
+
+static void* worker_main(void* arg) {
+    WorkerArgs* args = (WorkerArgs*)arg;
+    DspPool* pool = args->pool;
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    if (args->pin && cores > 1) {
+        // Leave core 0 to the audio and GUI threads
+        dsp_pin_current_thread(1 + args->index % (int)(cores - 1));
+    }
+    free(args);
+
+    // Jobs start at generation 1, so a worker that starts late still joins the first one
+    unsigned seen = 0;
+
+    for (;;) {
+        unsigned generation;
+        int spins = 0;
+
+        // Spin first so back-to-back jobs never pay for a wakeup, then park
+        while ((generation = atomic_load_explicit(&pool->generation, memory_order_acquire)) == seen &&
+               !atomic_load_explicit(&pool->stop, memory_order_acquire)) {
+            if (++spins < SPIN_ITERATIONS) {
+                cpu_relax();
+                continue;
+            }
+            pthread_mutex_lock(&pool->lock);
+            atomic_fetch_add(&pool->sleepers, 1);
+            while (atomic_load(&pool->generation) == seen && !atomic_load(&pool->stop)) {
+                pthread_cond_wait(&pool->wake, &pool->lock);
+            }
+            atomic_fetch_sub(&pool->sleepers, 1);
+            pthread_mutex_unlock(&pool->lock);
+            spins = 0;
+        }
+
+        if (atomic_load_explicit(&pool->stop, memory_order_acquire)) break;
+
+        seen = generation;
+        run_items(pool);
+        atomic_fetch_add_explicit(&pool->finished, 1, memory_order_release);
+    }
+    return NULL;
+}
+
+static void empty_task(void* arg, size_t index) {
+    (void)arg;
+    (void)index;
+}
+
+/**
+ * Creates a persistent worker pool.
+ *
+ * The dispatch cost (waking parked workers for an empty job and waiting for
+ * them to finish) is measured once here and stored in dispatch_seconds so
+ * callers can decide whether a job is big enough to be worth splitting.
+ *
+ * @param num_workers Worker threads to start in addition to the caller;
+ *                    0 picks one per online core minus one.
+ * @param pin_threads Non-zero to pin each worker to its own core.
+ * @return The pool, or NULL on failure (including a machine with one core).
+ */
+DspPool* dsp_pool_create(int num_workers, int pin_threads) {
+    if (num_workers <= 0) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        num_workers = cores > 1 ? (int)cores - 1 : 0;
+    }
+    if (num_workers > DSP_POOL_MAX_WORKERS) num_workers = DSP_POOL_MAX_WORKERS;
+    if (num_workers == 0) return NULL;
+
+    DspPool* pool = calloc(1, sizeof(DspPool));
+    if (!pool) return NULL;
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->wake, NULL);
+    atomic_init(&pool->next, 0);
+    atomic_init(&pool->finished, 0);
+    atomic_init(&pool->generation, 0);
+    atomic_init(&pool->sleepers, 0);
+    atomic_init(&pool->stop, 0);
+
+    for (int i = 0; i < num_workers; i++) {
+        WorkerArgs* args = malloc(sizeof(WorkerArgs));
+        if (!args) break;
+        args->pool = pool;
+        args->index = i;
+        args->pin = pin_threads;
+        if (pthread_create(&pool->threads[i], NULL, worker_main, args) != 0) {
+            free(args);
+            break;
+        }
+        pool->num_workers++;
+    }
+
+    if (pool->num_workers == 0) {
+        dsp_pool_destroy(pool);
+        return NULL;
+    }
+
+    // Time an empty job from a parked state, the way the audio thread sees it
+    double worst = 0.0;
+    for (int i = 0; i < 8; i++) {
+        usleep(2000);
+        double start = now_seconds();
+        dsp_pool_run(pool, empty_task, NULL, pool->num_workers + 1);
+        double elapsed = now_seconds() - start;
+        if (elapsed > worst) worst = elapsed;
+    }
+    pool->dispatch_seconds = worst;
+
+    return pool;
+}
+
+/**
+ * Runs task(arg, i) for every i in [0, count) across the pool.
+ *
+ * The caller participates and the call returns once all indices are done and
+ * every worker has left the job. Must only be called from one thread at a time.
+ *
+ * @param pool The pool (NULL runs everything on the calling thread).
+ * @param task The function to run.
+ * @param arg The argument passed to every call.
+ * @param count The number of indices.
+ */
+void dsp_pool_run(DspPool* pool, DspTask task, void* arg, size_t count) {
+    if (!pool || count < 2) {
+        for (size_t i = 0; i < count; i++) task(arg, i);
+        return;
+    }
+
+    pool->task = task;
+    pool->arg = arg;
+    pool->count = count;
+    atomic_store_explicit(&pool->next, 0, memory_order_relaxed);
+    atomic_store_explicit(&pool->finished, 0, memory_order_relaxed);
+    atomic_fetch_add_explicit(&pool->generation, 1, memory_order_seq_cst);
+
+    if (atomic_load_explicit(&pool->sleepers, memory_order_seq_cst) > 0) {
+        pthread_mutex_lock(&pool->lock);
+        pthread_cond_broadcast(&pool->wake);
+        pthread_mutex_unlock(&pool->lock);
+    }
+
+    run_items(pool);
+
+    while (atomic_load_explicit(&pool->finished, memory_order_acquire) < pool->num_workers) {
+        cpu_relax();
+    }
+}
+
+/**
+ * Stops and joins all workers and frees the pool.
+ *
+ * @param pool The pool to destroy (may be NULL).
+ */
+void dsp_pool_destroy(DspPool* pool) {
+    if (!pool) return;
+
+    pthread_mutex_lock(&pool->lock);
+    atomic_store(&pool->stop, 1);
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int i = 0; i < pool->num_workers; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->wake);
+    free(pool);
+}
@@ -0,0 +1,52 @@
+#ifndef DSP_POOL_H
+#define DSP_POOL_H
+
+#include <stddef.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#define DSP_POOL_MAX_WORKERS 16
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define cpu_relax() _mm_pause()
+#elif defined(__aarch64__) || defined(__arm__)
+#define cpu_relax() __asm__ __volatile__("yield")
+#else
+#define cpu_relax() ((void)0)
+#endif
+
+// Task run by the pool: called once for every index in [0, count)
+typedef void (*DspTask)(void* arg, size_t index);
+
+// Persistent fork/join pool for the DSP thread.
+// Workers are created once, optionally pinned to cores, spin briefly after
+// each job and then park on a condition variable. dsp_pool_run() hands out
+// indices through an atomic counter; the calling thread works too and
+// returns only when every worker has left the job, so the job description
+// can be reused immediately.
+typedef struct {
+    pthread_t threads[DSP_POOL_MAX_WORKERS];
+    int num_workers;
+
+    DspTask task;
+    void* arg;
+    size_t count;
+    atomic_size_t next;
+    atomic_int finished;       // Workers that have left the current job
+    atomic_uint generation;    // Bumped once per job
+    atomic_int sleepers;       // Workers parked on wake
+    atomic_int stop;
+
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+
+    double dispatch_seconds;   // Measured cost of waking the pool for an empty job
+} DspPool;
+
+DspPool* dsp_pool_create(int num_workers, int pin_threads);
+void dsp_pool_run(DspPool* pool, DspTask task, void* arg, size_t count);
+void dsp_pool_destroy(DspPool* pool);
+void dsp_pin_current_thread(int core);
+
+#endif
@@ -0,0 +1,195 @@
+#include "dynamics.h"
+#include "spectral_kernels.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+// Coefficient of n steps of a per-sample one-pole smoother (full is the
+// coefficient of a whole ramp, precomputed because nearly every ramp is one)
+static float ramp_coef(const DynamicsProcessor* dyn, float per_sample, float full, size_t n) {
+    return n == dyn->block ? full : 1.0f - powf(1.0f - per_sample, (float)n);
+}
+
+/**
+ * Creates a dynamics processor.
+ *
+ * The limiter sees lookahead samples ahead of its output, so it delays the
+ * signal by exactly that much. Gains change in linear ramps of at most
+ * lookahead - 2 samples, which lets every ramp finish before the peak it
+ * reacts to is played (the 2 cover the half-sample points next to it).
+ * Without look-ahead the ramps are DYNAMICS_BLOCK long and a hard clip
+ * catches what they miss.
+ *
+ * @param sample_rate The sample rate in Hz.
+ * @param lookahead 0, or DYNAMICS_MIN_LOOKAHEAD - DYNAMICS_MAX_LOOKAHEAD samples.
+ * @param arena Arena for the processor and its buffers, or NULL for the heap.
+ * @return The processor, or NULL on failure.
+ */
+DynamicsProcessor* dynamics_create(size_t sample_rate, size_t lookahead, DspArena* arena) {
+    if (lookahead != 0 && (lookahead < DYNAMICS_MIN_LOOKAHEAD || lookahead > DYNAMICS_MAX_LOOKAHEAD)) {
+        printf("Error: Limiter look-ahead must be 0 or %d - %d samples\n", DYNAMICS_MIN_LOOKAHEAD,
+               DYNAMICS_MAX_LOOKAHEAD);
+        return NULL;
+    }
+
+    DynamicsProcessor* dyn = dsp_alloc(arena, sizeof(DynamicsProcessor));
+    if (!dyn) {
+        printf("Error: Failed to allocate dynamics processor\n");
+        return NULL;
+    }
+    dyn->arena = arena;
+    dyn->lookahead = lookahead;
+    dyn->block = DYNAMICS_BLOCK;
+    while (lookahead > 0 && dyn->block + 2 > lookahead) dyn->block >>= 1;
+
+    // The line holds the look-ahead plus the ramp being written; ramps are
+    // aligned to the block grid so a write never wraps
+    size_t size = DYNAMICS_BLOCK;
+    while (size < lookahead + dyn->block) size <<= 1;
+    size_t slots = 1;
+    while (slots < lookahead / dyn->block + 4) slots <<= 1;
+
+    float* storage = dsp_alloc(arena, (DYNAMICS_HISTORY + size) * sizeof(float));
+    dyn->peaks = dsp_alloc(arena, slots * sizeof(float));
+    if (!storage || !dyn->peaks) {
+        printf("Error: Failed to allocate dynamics buffers\n");
+        dsp_free(arena, storage);
+        dsp_free(arena, dyn->peaks);
+        dsp_free(arena, dyn);
+        return NULL;
+    }
+    dyn->line = storage + DYNAMICS_HISTORY;
+    dyn->mask = size - 1;
+    dyn->peak_mask = slots - 1;
+
+    dyn->gate_attack = 1.0f / (DYNAMICS_GATE_ATTACK_MS * 0.001f * sample_rate);
+    dyn->gate_release = 1.0f / (DYNAMICS_GATE_RELEASE_MS * 0.001f * sample_rate);
+    dyn->release_coef = 1.0f - expf(-1.0f / (DYNAMICS_RELEASE_MS * 0.001f * sample_rate));
+    dyn->rms_block = 1.0f - powf(1.0f - RMS_SMOOTH_FACTOR, (float)dyn->block);
+    dyn->agc_block = 1.0f - powf(1.0f - GAIN_SMOOTH_FACTOR, (float)dyn->block);
+    dyn->release_block = 1.0f - powf(1.0f - dyn->release_coef, (float)dyn->block);
+    dynamics_reset(dyn);
+    return dyn;
+}
+
+/**
+ * Frees the dynamics processor and its buffers.
+ *
+ * @param dyn The processor (NULL is ignored).
+ */
+void dynamics_destroy(DynamicsProcessor* dyn) {
+    if (!dyn) return;
+    dsp_free(dyn->arena, dyn->line - DYNAMICS_HISTORY);
+    dsp_free(dyn->arena, dyn->peaks);
+    dsp_free(dyn->arena, dyn);
+}
+
+/**
+ * Empties the look-ahead line and starts over with the gate closed and
+ * unity AGC gain.
+ *
+ * @param dyn The processor.
+ */
+void dynamics_reset(DynamicsProcessor* dyn) {
+    memset(dyn->line - DYNAMICS_HISTORY, 0, (DYNAMICS_HISTORY + dyn->mask + 1) * sizeof(float));
+    memset(dyn->peaks, 0, (dyn->peak_mask + 1) * sizeof(float));
+    dyn->position = 0;
+    dyn->envelope = 0.0f;
+    dyn->gate_open = 0;
+    dyn->gate = 0.0f;
+    dyn->agc = 1.0f;
+    dyn->gain = 0.0f;
+    dyn->limit = 1.0f;
+}
+
+/**
+ * Runs one ramp of n samples (n <= dyn->block, not crossing the block
+ * grid). The input is read once: gain_ramp_peak() applies the gate and AGC
+ * gain into the line while it measures the input energy and the true peak
+ * of what it wrote. The output is the line lookahead samples back, scaled
+ * by the limiter; it is written over the input.
+ */
+static void process_ramp(DynamicsProcessor* dyn, float* samples, size_t n) {
+    const uint64_t start = dyn->position;
+    const uint64_t lookahead = dyn->lookahead;
+    const size_t block = dyn->block;
+    size_t write = (size_t)(start & dyn->mask);
+
+    float energy;
+    float gain = dyn->gate * dyn->agc;
+    float peak = gain_ramp_peak(samples, dyn->line + write, n, dyn->gain, (gain - dyn->gain) / n, &energy);
+    dyn->gain = gain;
+    if (write + n == dyn->mask + 1) {
+        memcpy(dyn->line - DYNAMICS_HISTORY, dyn->line + dyn->mask + 1 - DYNAMICS_HISTORY,
+               DYNAMICS_HISTORY * sizeof(float));
+    }
+
+    float* slot = &dyn->peaks[(start / block) & dyn->peak_mask];
+    *slot = (start % block == 0 || peak > *slot) ? peak : *slot;
+    dyn->position = start + n;
+
+    // Loudest point the output ramp or the half-sample points next to it can reach
+    uint64_t first = start > lookahead ? (start - lookahead - 1) / block : 0;
+    uint64_t last = (start + n - 1) / block;
+    float loudest = 0.0f;
+    for (uint64_t s = first; s <= last; s++) {
+        loudest = fmaxf(loudest, dyn->peaks[s & dyn->peak_mask]);
+    }
+    float target = loudest > DYNAMICS_CEILING ? DYNAMICS_CEILING / loudest : 1.0f;
+    float limit = target;
+    if (target > dyn->limit) {
+        limit = dyn->limit + (target - dyn->limit) * ramp_coef(dyn, dyn->release_coef, dyn->release_block, n);
+    }
+
+    size_t read = (size_t)((start - lookahead) & dyn->mask);
+    size_t first_part = dyn->mask + 1 - read < n ? dyn->mask + 1 - read : n;
+    float step = (limit - dyn->limit) / n;
+    gain_ramp_clip(dyn->line + read, samples, first_part, dyn->limit, step);
+    if (first_part < n) {
+        gain_ramp_clip(dyn->line, samples + first_part, n - first_part, dyn->limit + step * first_part, step);
+    }
+    dyn->limit = limit;
+
+    // The gate and AGC follow the input; their new gains apply from the next ramp
+    dyn->envelope += (energy / n - dyn->envelope) * ramp_coef(dyn, RMS_SMOOTH_FACTOR, dyn->rms_block, n);
+    float level = sqrtf(dyn->envelope);
+    if (dyn->gate_open ? level < NOISE_FLOOR : level > NOISE_FLOOR * DYNAMICS_GATE_HYSTERESIS) {
+        dyn->gate_open = !dyn->gate_open;
+    }
+    if (dyn->gate_open) {
+        dyn->gate = fminf(1.0f, dyn->gate + dyn->gate_attack * n);
+        float wanted = fminf(DYNAMICS_MAX_GAIN, fmaxf(DYNAMICS_MIN_GAIN, TARGET_RMS / level));
+        dyn->agc += (wanted - dyn->agc) * ramp_coef(dyn, GAIN_SMOOTH_FACTOR, dyn->agc_block, n);
+    } else {
+        // The AGC holds its gain so it does not pump up the noise
+        dyn->gate = fmaxf(0.0f, dyn->gate - dyn->gate_release * n);
+    }
+}
+
+/**
+ * Levels a block of samples in place: the noise gate and the AGC scale
+ * the signal, then the limiter keeps its true peak (samples and the
+ * half-sample points between them) at or below DYNAMICS_CEILING. The
+ * output is delayed by dyn->lookahead samples.
+ *
+ * The level is followed with a mean-square envelope (RMS_SMOOTH_FACTOR per
+ * sample). The gate opens above DYNAMICS_GATE_HYSTERESIS * NOISE_FLOOR and
+ * closes below NOISE_FLOOR; while it is open the AGC gain glides towards
+ * TARGET_RMS / level (GAIN_SMOOTH_FACTOR per sample). The limiter reduces
+ * its gain in time for the loudest peak within the look-ahead and recovers
+ * over DYNAMICS_RELEASE_MS. Every gain changes in linear per-sample ramps
+ * that the SIMD kernels apply.
+ *
+ * @param dyn The processor.
+ * @param samples The samples to level.
+ * @param length The number of samples.
+ */
+void dynamics_process(DynamicsProcessor* dyn, float* samples, size_t length) {
+    size_t offset = 0;
+    while (offset < length) {
+        size_t n = dyn->block - (size_t)(dyn->position & (dyn->block - 1));
+        if (n > length - offset) n = length - offset;
+        process_ramp(dyn, samples + offset, n);
+        offset += n;
+    }
+}
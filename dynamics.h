@@ -0,0 +1,66 @@
+#ifndef DYNAMICS_H
+#define DYNAMICS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "dsp_arena.h"
+
+#ifndef NOISE_FLOOR
+#define NOISE_FLOOR 0.001f
+#endif
+#ifndef TARGET_RMS
+#define TARGET_RMS 0.3f
+#endif
+#ifndef GAIN_SMOOTH_FACTOR
+#define GAIN_SMOOTH_FACTOR 0.001f
+#endif
+#ifndef RMS_SMOOTH_FACTOR
+#define RMS_SMOOTH_FACTOR 0.01f
+#endif
+
+#define DYNAMICS_BLOCK 32              // Most samples sharing one gain ramp (power of two)
+#define DYNAMICS_LOOKAHEAD 64          // Default limiter look-ahead in samples
+#define DYNAMICS_MIN_LOOKAHEAD 6       // Shortest look-ahead other than none (4-sample ramps)
+#define DYNAMICS_MAX_LOOKAHEAD 4096
+#define DYNAMICS_HISTORY 3             // Samples before a ramp the half-sample peaks look at
+#define DYNAMICS_GATE_HYSTERESIS 2.0f  // The gate opens at this multiple of NOISE_FLOOR, closes below NOISE_FLOOR
+#define DYNAMICS_GATE_ATTACK_MS 1.0f   // Gate fade-in time
+#define DYNAMICS_GATE_RELEASE_MS 50.0f // Gate fade-out time
+#define DYNAMICS_MIN_GAIN 0.25f        // AGC gain range (-12 to +18 dB)
+#define DYNAMICS_MAX_GAIN 8.0f
+#define DYNAMICS_CEILING 0.98f         // Limiter ceiling for the true peak (about -0.2 dBFS)
+#define DYNAMICS_RELEASE_MS 50.0f      // Time constant of the limiter's recovery
+
+// Output level control: noise gate with hysteresis, AGC towards TARGET_RMS
+// and a look-ahead true-peak limiter, run as one pass over each block.
+// dynamics_process() never allocates or locks.
+typedef struct {
+    float* line;              // Look-ahead line of gated and AGC-scaled samples (power of two),
+                              // preceded by a copy of its last DYNAMICS_HISTORY samples
+    size_t mask;
+    size_t lookahead;         // Delay of the output in samples
+    size_t block;             // Longest gain ramp (power of two, lookahead - 2 at most)
+    uint64_t position;        // Samples written since the last reset
+    float* peaks;             // True peak of each block-aligned span of the line
+    size_t peak_mask;
+    float envelope;           // Smoothed mean square of the input
+    int gate_open;
+    float gate;               // Gate gain (0 - 1)
+    float agc;                // AGC gain
+    float gain;               // gate * agc reached at the end of the last ramp
+    float limit;              // Limiter gain reached at the end of the last ramp
+    float gate_attack;        // Gate gain change per sample while opening
+    float gate_release;       // ... and while closing
+    float release_coef;       // Per-sample one-pole coefficient of the limiter's recovery
+    float rms_block;          // Envelope, AGC and recovery coefficients over a whole ramp
+    float agc_block;
+    float release_block;
+    DspArena* arena;          // Owner of the struct and buffers (NULL = heap)
+} DynamicsProcessor;
+
+DynamicsProcessor* dynamics_create(size_t sample_rate, size_t lookahead, DspArena* arena);
+void dynamics_destroy(DynamicsProcessor* dyn);
+void dynamics_reset(DynamicsProcessor* dyn);
+void dynamics_process(DynamicsProcessor* dyn, float* samples, size_t length);
+
+#endif
@@ -0,0 +1,170 @@
+#include "echo.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Below this the feedback tail is flushed to zero so a decaying echo never
+// reaches the (slow) denormal range
+#define ECHO_FLUSH_LEVEL 1e-30f
+
+/**
+ * Creates an echo for the given sample rate with a delay line long enough
+ * for ECHO_MAX_DELAY_MS.
+ *
+ * @param sample_rate The sample rate in Hz.
+ * @param arena Arena for the echo and its line, or NULL for the heap.
+ * @return The echo, or NULL on failure.
+ */
+EchoEngine* echo_create(size_t sample_rate, DspArena* arena) {
+    EchoEngine* echo = dsp_alloc(arena, sizeof(EchoEngine));
+    if (!echo) {
+        printf("Error: Failed to allocate echo\n");
+        return NULL;
+    }
+    echo->arena = arena;
+
+    echo->sample_rate = sample_rate;
+    echo->max_delay = sample_rate * ECHO_MAX_DELAY_MS / 1000;
+    if (echo->max_delay < ECHO_MIN_DELAY) echo->max_delay = ECHO_MIN_DELAY;
+
+    // Room for the longest delay, the interpolation neighbour and one block
+    size_t size = 1;
+    while (size < echo->max_delay + ECHO_BLOCK + 2) size <<= 1;
+    echo->line = dsp_alloc(arena, size * sizeof(float));
+    if (!echo->line) {
+        printf("Error: Failed to allocate echo delay line\n");
+        dsp_free(arena, echo);
+        return NULL;
+    }
+    echo->mask = size - 1;
+
+    echo->delay_coef = 1.0f - expf(-1.0f / (ECHO_DELAY_GLIDE_MS * 0.001f * sample_rate));
+    echo->gain_coef = 1.0f - expf(-(float)ECHO_BLOCK / (ECHO_GAIN_GLIDE_MS * 0.001f * sample_rate));
+    echo_reset(echo);
+    return echo;
+}
+
+/**
+ * Frees the echo and its delay line.
+ *
+ * @param echo The echo (NULL is ignored).
+ */
+void echo_destroy(EchoEngine* echo) {
+    if (!echo) return;
+    dsp_free(echo->arena, echo->line);
+    dsp_free(echo->arena, echo);
+}
+
+/**
+ * Silences the delay line. The next echo_process() call starts at its
+ * target delay without gliding.
+ *
+ * @param echo The echo.
+ */
+void echo_reset(EchoEngine* echo) {
+    memset(echo->line, 0, (echo->mask + 1) * sizeof(float));
+    echo->write_pos = 0;
+    echo->delay = 0.0f;
+    echo->wet = 0.0f;
+}
+
+/**
+ * Reads one block of the delayed signal into echo->tap at a fixed delay.
+ * The block reads one contiguous span of the line, copied out in at most
+ * two pieces, so the interpolation loop has no wrap-around and vectorises.
+ */
+static void read_fixed(EchoEngine* echo, size_t length) {
+    size_t whole = (size_t)echo->delay;
+    float frac = echo->delay - (float)whole;
+    size_t start = (echo->write_pos - whole - 1) & echo->mask;
+    size_t first = echo->mask + 1 - start;
+    if (first > length + 1) first = length + 1;
+
+    float span[ECHO_BLOCK + 1];
+    memcpy(span, echo->line + start, first * sizeof(float));
+    memcpy(span + first, echo->line, (length + 1 - first) * sizeof(float));
+
+    // span[i + 1] is the sample `whole` behind output i, span[i] one further
+    for (size_t i = 0; i < length; i++) {
+        echo->tap[i] = span[i + 1] + frac * (span[i] - span[i + 1]);
+    }
+}
+
+/**
+ * Reads one block of the delayed signal into echo->tap while the delay
+ * glides towards target, one smoothing step per sample. The read position
+ * then moves continuously, which is heard as a short pitch bend rather
+ * than a click.
+ */
+static void read_gliding(EchoEngine* echo, size_t length, float target) {
+    float delay = echo->delay;
+    for (size_t i = 0; i < length; i++) {
+        delay += (target - delay) * echo->delay_coef;
+        size_t whole = (size_t)delay;
+        float frac = delay - (float)whole;
+        size_t pos = (echo->write_pos + i - whole) & echo->mask;
+        float newer = echo->line[pos];
+        float older = echo->line[(pos - 1) & echo->mask];
+        echo->tap[i] = newer + frac * (older - newer);
+    }
+    echo->delay = delay;
+}
+
+/**
+ * Adds a feedback echo to a block of samples, in place.
+ *
+ * Every sample is written into the delay line together with the fed-back
+ * echo, and the output is the input plus the delayed line. Intensity sets
+ * both the echo level and the feedback (up to ECHO_MAX_FEEDBACK), and is
+ * smoothed over ECHO_GAIN_GLIDE_MS with a per-sample ramp. A change of
+ * delay glides over ECHO_DELAY_GLIDE_MS with fractional (linear
+ * interpolation) reads. The delay never drops below ECHO_MIN_DELAY, so a
+ * block never reads samples it writes itself. Never allocates or locks.
+ *
+ * @param echo The echo.
+ * @param samples The samples to process.
+ * @param length The number of samples.
+ * @param intensity Echo intensity (0.0 - 1.0).
+ * @param delay_ms Echo delay in milliseconds (up to ECHO_MAX_DELAY_MS).
+ */
+void echo_process(EchoEngine* echo, float* samples, size_t length, float intensity, float delay_ms) {
+    if (intensity < 0.0f) intensity = 0.0f;
+    if (intensity > 1.0f) intensity = 1.0f;
+
+    float target = delay_ms * 0.001f * (float)echo->sample_rate;
+    if (target < ECHO_MIN_DELAY) target = ECHO_MIN_DELAY;
+    if (target > (float)echo->max_delay) target = (float)echo->max_delay;
+    if (echo->delay == 0.0f) echo->delay = target;
+
+    for (size_t offset = 0; offset < length; offset += ECHO_BLOCK) {
+        size_t n = length - offset < ECHO_BLOCK ? length - offset : ECHO_BLOCK;
+        float* x = samples + offset;
+
+        if (fabsf(target - echo->delay) < 0.01f) {
+            echo->delay = target;
+            read_fixed(echo, n);
+        } else {
+            read_gliding(echo, n, target);
+        }
+
+        float wet_start = echo->wet;
+        float wet_end = wet_start + (intensity - wet_start) * echo->gain_coef;
+        if (fabsf(intensity - wet_end) < 1e-5f) wet_end = intensity;
+        float wet_step = (wet_end - wet_start) / (float)n;
+
+        for (size_t i = 0; i < n; i++) {
+            float wet = wet_start + wet_step * (float)(i + 1);
+            float feed = x[i] + wet * ECHO_MAX_FEEDBACK * echo->tap[i];
+            echo->feed[i] = fabsf(feed) < ECHO_FLUSH_LEVEL ? 0.0f : feed;
+            x[i] += wet * echo->tap[i];
+        }
+        echo->wet = wet_end;
+
+        size_t first = echo->mask + 1 - echo->write_pos;
+        if (first > n) first = n;
+        memcpy(echo->line + echo->write_pos, echo->feed, first * sizeof(float));
+        memcpy(echo->line, echo->feed + first, (n - first) * sizeof(float));
+        echo->write_pos = (echo->write_pos + n) & echo->mask;
+    }
+}
@@ -0,0 +1,36 @@
+#ifndef ECHO_H
+#define ECHO_H
+
+#include <stddef.h>
+#include "dsp_arena.h"
+
+#define ECHO_MAX_DELAY_MS 1000     // Longest echo_delay the delay line is sized for
+#define ECHO_MAX_FEEDBACK 0.6f     // Feedback at full intensity (repeats decay by ~4.4 dB)
+#define ECHO_BLOCK 64              // Samples processed with one delay/gain step
+#define ECHO_MIN_DELAY (ECHO_BLOCK + 2)  // Keeps every read of a block behind its writes
+#define ECHO_DELAY_GLIDE_MS 80.0f  // Time constant of delay changes
+#define ECHO_GAIN_GLIDE_MS 20.0f   // Time constant of intensity changes
+
+// Feedback delay-line echo. The line is allocated once for the longest delay;
+// echo_process() never allocates or locks, so it can run on the audio thread.
+typedef struct {
+    float* line;              // Power-of-two circular delay line
+    size_t mask;
+    size_t write_pos;
+    float delay;              // Current delay in samples (fractional)
+    float wet;                // Current wet gain (= intensity)
+    float delay_coef;         // Per-sample one-pole coefficient for delay glides
+    float gain_coef;          // Per-block one-pole coefficient for intensity
+    size_t max_delay;         // Longest delay in samples
+    size_t sample_rate;
+    float tap[ECHO_BLOCK];      // Delayed signal of one block
+    float feed[ECHO_BLOCK];     // Samples written into the line by one block
+    DspArena* arena;            // Owner of the struct and line (NULL = heap)
+} EchoEngine;
+
+EchoEngine* echo_create(size_t sample_rate, DspArena* arena);
+void echo_destroy(EchoEngine* echo);
+void echo_reset(EchoEngine* echo);
+void echo_process(EchoEngine* echo, float* samples, size_t length, float intensity, float delay_ms);
+
+#endif
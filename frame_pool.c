@@ -0,0 +1,165 @@
+#include "frame_pool.h"
+
+/**
+ * Creates a pool of frames. Every frame's samples are aligned for SIMD
+ * and zeroed; the frames are never resized or freed individually.
+ *
+ * @param arena The arena to allocate from, or NULL for the heap.
+ * @param count The number of frames.
+ * @param frame_size Samples per frame.
+ * @return The pool, or NULL on failure.
+ */
+FramePool* frame_pool_create(DspArena* arena, size_t count, size_t frame_size) {
+    if (count == 0 || frame_size == 0) return NULL;
+
+    FramePool* pool = dsp_alloc(arena, sizeof(FramePool));
+    if (!pool) return NULL;
+    pool->arena = arena;
+    pool->count = count;
+    pool->frame_size = frame_size;
+    pool->frames = dsp_alloc(arena, count * sizeof(Frame));
+    if (!pool->frames) {
+        dsp_free(arena, pool);
+        return NULL;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        pool->frames[i].samples = dsp_alloc(arena, frame_size * sizeof(float));
+        if (!pool->frames[i].samples) {
+            pool->count = i;
+            frame_pool_destroy(pool);
+            return NULL;
+        }
+    }
+    return pool;
+}
+
+/**
+ * Releases a pool. No stage may still hold one of its frames.
+ *
+ * @param pool The pool (may be NULL).
+ */
+void frame_pool_destroy(FramePool* pool) {
+    if (!pool) return;
+    for (size_t i = 0; i < pool->count; i++) {
+        dsp_free(pool->arena, pool->frames[i].samples);
+    }
+    dsp_free(pool->arena, pool->frames);
+    dsp_free(pool->arena, pool);
+}
+
+/**
+ * Creates an empty frame queue.
+ *
+ * @param arena The arena to allocate from, or NULL for the heap.
+ * @param capacity The minimum number of frames it must hold (rounded up to
+ *                 a power of two).
+ * @return The queue, or NULL on failure.
+ */
+FrameQueue* frame_queue_create(DspArena* arena, size_t capacity) {
+    if (capacity == 0) return NULL;
+
+    FrameQueue* queue = dsp_alloc_aligned(arena, sizeof(FrameQueue), CACHE_LINE_SIZE);
+    if (!queue) return NULL;
+    queue->arena = arena;
+    queue->size = 1;
+    while (queue->size < capacity) queue->size <<= 1;
+    queue->mask = queue->size - 1;
+    queue->slots = dsp_alloc_aligned(arena, queue->size * sizeof(Frame*), CACHE_LINE_SIZE);
+    if (!queue->slots) {
+        dsp_free(arena, queue);
+        return NULL;
+    }
+
+    atomic_init(&queue->write_pos, 0);
+    atomic_init(&queue->read_pos, 0);
+    return queue;
+}
+
+/**
+ * Releases a frame queue (not the frames in it).
+ *
+ * @param queue The queue (may be NULL).
+ */
+void frame_queue_destroy(FrameQueue* queue) {
+    if (!queue) return;
+    dsp_free(queue->arena, queue->slots);
+    dsp_free(queue->arena, queue);
+}
+
+/**
+ * Hands a frame to the consumer. Producer side only.
+ *
+ * @param queue The queue.
+ * @param frame The frame; the caller no longer owns it on success.
+ * @return 0 on success, -1 if the queue is full (the caller keeps the frame).
+ */
+int frame_queue_push(FrameQueue* queue, Frame* frame) {
+    size_t write_pos = atomic_load_explicit(&queue->write_pos, memory_order_relaxed);
+    size_t read_pos = atomic_load_explicit(&queue->read_pos, memory_order_acquire);
+    if (write_pos - read_pos >= queue->size) return -1;
+
+    queue->slots[write_pos & queue->mask] = frame;
+    atomic_store_explicit(&queue->write_pos, write_pos + 1, memory_order_release);
+    return 0;
+}
+
+/**
+ * Takes the oldest frame. Consumer side only.
+ *
+ * @param queue The queue.
+ * @return The frame (now owned by the caller), or NULL if the queue is empty.
+ */
+Frame* frame_queue_pop(FrameQueue* queue) {
+    size_t read_pos = atomic_load_explicit(&queue->read_pos, memory_order_relaxed);
+    size_t write_pos = atomic_load_explicit(&queue->write_pos, memory_order_acquire);
+    if (read_pos == write_pos) return NULL;
+
+    Frame* frame = queue->slots[read_pos & queue->mask];
+    atomic_store_explicit(&queue->read_pos, read_pos + 1, memory_order_release);
+    return frame;
+}
+
+/**
+ * Looks at a queued frame without taking it. Consumer side only.
+ *
+ * @param queue The queue.
+ * @param index 0 for the oldest frame.
+ * @return The frame, or NULL if fewer than index + 1 frames are queued.
+ */
+Frame* frame_queue_peek(FrameQueue* queue, size_t index) {
+    size_t read_pos = atomic_load_explicit(&queue->read_pos, memory_order_relaxed);
+    size_t write_pos = atomic_load_explicit(&queue->write_pos, memory_order_acquire);
+    if (write_pos - read_pos <= index) return NULL;
+    return queue->slots[(read_pos + index) & queue->mask];
+}
+
+/**
+ * Returns the number of queued frames. Safe to call from either side.
+ *
+ * @param queue The queue.
+ * @return The fill level in frames.
+ */
+size_t frame_queue_count(FrameQueue* queue) {
+    size_t write_pos = atomic_load_explicit(&queue->write_pos, memory_order_acquire);
+    size_t read_pos = atomic_load_explicit(&queue->read_pos, memory_order_acquire);
+    return write_pos - read_pos;
+}
+
+/**
+ * Queues frames of a pool, typically to seed a free list before the
+ * threads start.
+ *
+ * @param queue The queue.
+ * @param pool The pool.
+ * @param first Index of the first frame to queue.
+ * @param count The number of frames to queue.
+ * @return 0 on success, -1 if they do not fit.
+ */
+int frame_queue_fill(FrameQueue* queue, FramePool* pool, size_t first, size_t count) {
+    if (first + count > pool->count) return -1;
+    for (size_t i = first; i < first + count; i++) {
+        if (frame_queue_push(queue, &pool->frames[i]) < 0) return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,48 @@
+#ifndef FRAME_POOL_H
+#define FRAME_POOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include "circular_buffer.h"
+#include "dsp_arena.h"
+
+// One block of audio and where it has been. Frames are passed between the
+// pipeline stages by pointer; whoever holds the pointer owns the samples.
+typedef struct {
+    float* samples;             // frame_size samples, DSP_ARENA_ALIGN-aligned
+    uint64_t captured_ns;       // When the input was captured (0 = not captured, e.g. concealment)
+    uint64_t queued_ns;         // When it entered the jitter buffer
+} Frame;
+
+// Preallocated frames of one size
+typedef struct {
+    Frame* frames;
+    size_t count;
+    size_t frame_size;
+    DspArena* arena;            // Owner of the struct and storage (NULL = heap)
+} FramePool;
+
+// Wait-free single-producer/single-consumer queue of frame pointers, laid
+// out like CircularBuffer: free-running positions, a power-of-two capacity
+// and each side's position on its own cache line.
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) atomic_size_t write_pos;
+    _Alignas(CACHE_LINE_SIZE) atomic_size_t read_pos;
+    _Alignas(CACHE_LINE_SIZE) Frame** slots;
+    size_t size;                // Capacity in frames (power of two)
+    size_t mask;
+    DspArena* arena;
+} FrameQueue;
+
+FramePool* frame_pool_create(DspArena* arena, size_t count, size_t frame_size);
+void frame_pool_destroy(FramePool* pool);
+FrameQueue* frame_queue_create(DspArena* arena, size_t capacity);
+void frame_queue_destroy(FrameQueue* queue);
+int frame_queue_push(FrameQueue* queue, Frame* frame);
+Frame* frame_queue_pop(FrameQueue* queue);
+Frame* frame_queue_peek(FrameQueue* queue, size_t index);
+size_t frame_queue_count(FrameQueue* queue);
+int frame_queue_fill(FrameQueue* queue, FramePool* pool, size_t first, size_t count);
+
+#endif
@@ -60,6 +60,7 @@ void on_knob_adjusted(GtkWidget *widget, GdkEvent *event, gpointer user_data) {
         update_parameter_display(widgets->value_reverb, "Reverb", widgets->reverb);
         widgets->mod_params->reverb_intensity = widgets->reverb;
     }
+    publish_modulation_params(widgets->mod_params);
     
     gtk_widget_queue_draw(widget);
 }
@@ -81,6 +82,7 @@ void on_reset_clicked(GtkWidget *widget, gpointer user_data) {
         widgets->mod_params->speed_factor = widgets->speed;
         widgets->mod_params->echo_intensity = widgets->echo;
         widgets->mod_params->reverb_intensity = widgets->reverb;
+        publish_modulation_params(widgets->mod_params);
     }
     
     // Update displays
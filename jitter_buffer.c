@@ -0,0 +1,275 @@
+#include "jitter_buffer.h"
+#include <math.h>
+#include <string.h>
+
+#define JITTER_SMOOTHING 16  // Averaging length of the latency and jitter estimates (frames)
+
+static inline unsigned long load_counter(atomic_ulong* counter) {
+    return atomic_load_explicit(counter, memory_order_relaxed);
+}
+
+static inline void store_counter(atomic_ulong* counter, unsigned long value) {
+    atomic_store_explicit(counter, value, memory_order_relaxed);
+}
+
+static inline void bump_counter(atomic_ulong* counter) {
+    atomic_fetch_add_explicit(counter, 1, memory_order_relaxed);
+}
+
+// Hands a frame the consumer is done with back to the producer
+static void recycle(JitterBuffer* jb, Frame* frame) {
+    if (frame && frame != &jb->conceal) frame_queue_push(jb->recycle, frame);
+}
+
+// Starts a new calm window; pending shrinks are reconsidered at its end
+static void reset_window(JitterBuffer* jb) {
+    memset(jb->slack_counts, 0, sizeof(jb->slack_counts));
+    jb->window_frames = 0;
+}
+
+static void grow(JitterBuffer* jb) {
+    bump_counter(&jb->grows);
+    jb->pending_drops = 0;
+    reset_window(jb);
+}
+
+/**
+ * Creates a jitter buffer for frames of a fixed size.
+ *
+ * @param arena The arena to allocate from, or NULL for the heap.
+ * @param frame_size Samples per frame.
+ * @param sample_rate Samples per second of wall-clock time (sets the frame period).
+ * @param underrun_rate Fraction of frames that may be concealed (0 < rate <= 0.5).
+ * @param recycle Queue that takes back every frame once it has been played
+ *                (must have room for all of them).
+ * @return The jitter buffer, or NULL on failure.
+ */
+JitterBuffer* jitter_buffer_create(DspArena* arena, size_t frame_size, size_t sample_rate, float underrun_rate,
+                                   FrameQueue* recycle) {
+    if (frame_size == 0 || sample_rate == 0 || !recycle || !(underrun_rate > 0.0f && underrun_rate <= 0.5f)) {
+        return NULL;
+    }
+
+    JitterBuffer* jb = dsp_alloc_aligned(arena, sizeof(JitterBuffer), CACHE_LINE_SIZE);
+    if (!jb) return NULL;
+    jb->arena = arena;
+    jb->recycle = recycle;
+    jb->frame_size = frame_size;
+    jb->queue = frame_queue_create(arena, JITTER_BUFFER_MAX_FRAMES);
+    jb->conceal.samples = dsp_alloc(arena, frame_size * sizeof(float));
+    if (!jb->queue || !jb->conceal.samples) {
+        jitter_buffer_destroy(jb);
+        return NULL;
+    }
+
+    jb->period_ns = (uint64_t)frame_size * 1000000000u / sample_rate;
+    jb->underrun_rate = underrun_rate;
+    // A window must be long enough to resolve the target rate
+    jb->window_length = (unsigned long)ceilf(1.0f / underrun_rate);
+    unsigned long calm_frames = (unsigned long)(JITTER_BUFFER_CALM_SECONDS * sample_rate / frame_size);
+    if (jb->window_length < calm_frames) jb->window_length = calm_frames;
+
+    atomic_init(&jb->latency_ns, 0);
+    atomic_init(&jb->jitter_ns, 0);
+    atomic_init(&jb->played, 0);
+    atomic_init(&jb->underruns, 0);
+    atomic_init(&jb->grows, 0);
+    atomic_init(&jb->shrinks, 0);
+    atomic_init(&jb->overflows, 0);
+    return jb;
+}
+
+/**
+ * Releases a jitter buffer (not the frames that passed through it). Both
+ * threads must have stopped using it.
+ *
+ * @param jb The jitter buffer (may be NULL).
+ */
+void jitter_buffer_destroy(JitterBuffer* jb) {
+    if (!jb) return;
+    frame_queue_destroy(jb->queue);
+    dsp_free(jb->arena, jb->conceal.samples);
+    dsp_free(jb->arena, jb);
+}
+
+/**
+ * Producer side: queues a processed frame and updates the arrival jitter
+ * estimate.
+ *
+ * @param jb The jitter buffer.
+ * @param frame The frame; on success it belongs to the jitter buffer.
+ * @param now_ns The current time (CLOCK_MONOTONIC).
+ * @return 0 if the frame was queued, -1 if the buffer is full (the caller
+ *         keeps the frame and the overflow is counted).
+ */
+int jitter_buffer_push(JitterBuffer* jb, Frame* frame, uint64_t now_ns) {
+    if (jb->last_queued_ns != 0) {
+        // Deviation of the inter-arrival time from the frame period
+        int64_t deviation = (int64_t)(now_ns - jb->last_queued_ns) - (int64_t)jb->period_ns;
+        int64_t jitter = (int64_t)load_counter(&jb->jitter_ns);
+        jitter += ((deviation < 0 ? -deviation : deviation) - jitter) / JITTER_SMOOTHING;
+        store_counter(&jb->jitter_ns, (unsigned long)jitter);
+    }
+    jb->last_queued_ns = now_ns;
+
+    frame->queued_ns = now_ns;
+    if (frame_queue_push(jb->queue, frame) < 0) {
+        bump_counter(&jb->overflows);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Consumer side: tells the output thread when to call jitter_buffer_pop().
+ *
+ * @param jb The jitter buffer.
+ * @param now_ns The current time (CLOCK_MONOTONIC).
+ * @return 0 to pop now, otherwise the time of the next deadline, or
+ *         UINT64_MAX while the buffer is still priming (wait for a frame).
+ */
+uint64_t jitter_buffer_poll(JitterBuffer* jb, uint64_t now_ns) {
+    size_t queued = frame_queue_count(jb->queue);
+    if (jb->deadline_ns == 0) {
+        return queued > JITTER_BUFFER_INITIAL_MARGIN ? 0 : UINT64_MAX;
+    }
+    if ((queued > 0 && !jb->pending_conceal) || now_ns >= jb->deadline_ns) return 0;
+    return jb->deadline_ns;
+}
+
+/**
+ * Consumer side: hands out the next frame to play. Call it when
+ * jitter_buffer_poll() returns 0.
+ *
+ * A frame that has not arrived by its deadline is concealed with a fade to
+ * silence and played one period later; every frame behind it then waits one
+ * period longer, so the buffer has grown by a frame. At the end of each calm
+ * window the frames' measured slack decides how many periods of margin can
+ * go without exceeding the target underrun rate; those are dropped one at a
+ * time by crossfading two consecutive frames into one.
+ *
+ * Frames are played in place: the only samples written here are fades and
+ * crossfades.
+ *
+ * @param jb The jitter buffer.
+ * @param now_ns The current time (CLOCK_MONOTONIC).
+ * @param frame Receives the frame to play; it stays valid until
+ *              jitter_buffer_written(). Its captured_ns is 0 when concealed.
+ * @return What was produced.
+ */
+JitterFrame jitter_buffer_pop(JitterBuffer* jb, uint64_t now_ns, Frame** frame) {
+    size_t n = jb->frame_size;
+    size_t queued = frame_queue_count(jb->queue);
+    if (jb->deadline_ns == 0) jb->deadline_ns = now_ns;  // Primed: the first frame is due now
+
+    if (queued == 0 || jb->pending_conceal) {
+        if (!jb->pending_conceal) bump_counter(&jb->underruns);
+        jb->pending_conceal = 0;
+        // Ramp from wherever the last frame ended, so the gap does not click
+        float* output = jb->conceal.samples;
+        for (size_t i = 0; i < n; i++) {
+            output[i] = jb->last_sample * (float)(n - 1 - i) / (float)n;
+        }
+        jb->last_sample = 0.0f;
+        jb->fade_in = 1;
+        jb->deadline_ns += jb->period_ns;
+        grow(jb);
+        *frame = jb->playing = &jb->conceal;
+        return JITTER_FRAME_CONCEALED;
+    }
+
+    Frame* current = frame_queue_pop(jb->queue);
+    int64_t slack = (int64_t)(jb->deadline_ns - current->queued_ns);
+    size_t bin = slack <= 0 ? 0 : (size_t)((uint64_t)slack / jb->period_ns);
+    if (bin > JITTER_BUFFER_MAX_FRAMES) bin = JITTER_BUFFER_MAX_FRAMES;
+    jb->slack_counts[bin]++;
+
+    int64_t latency = (int64_t)load_counter(&jb->latency_ns);
+    latency += ((slack > 0 ? slack : 0) - latency) / JITTER_SMOOTHING;
+    store_counter(&jb->latency_ns, (unsigned long)latency);
+
+    JitterFrame result = JITTER_FRAME_PLAYED;
+    if (jb->pending_drops > 0 && queued >= 2) {
+        // Starts where the dropped frame starts and ends where the next one
+        // ends, so both seams stay continuous
+        Frame* next = frame_queue_pop(jb->queue);
+        for (size_t i = 0; i < n; i++) {
+            float w = (float)(i + 1) / (float)n;
+            next->samples[i] = current->samples[i] + (next->samples[i] - current->samples[i]) * w;
+        }
+        recycle(jb, current);
+        current = next;
+        jb->pending_drops--;
+        bump_counter(&jb->shrinks);
+        reset_window(jb);
+        result = JITTER_FRAME_DROPPED;
+    }
+
+    if (jb->fade_in) {
+        for (size_t i = 0; i < n; i++) {
+            current->samples[i] *= (float)(i + 1) / (float)n;
+        }
+        jb->fade_in = 0;
+    }
+    jb->last_sample = current->samples[n - 1];
+    jb->deadline_ns += jb->period_ns;
+    bump_counter(&jb->played);
+
+    if (++jb->window_frames >= jb->window_length) {
+        // Dropping k frames makes every frame with less than k periods of
+        // slack late; keep k as large as the target rate allows
+        unsigned long allowed = (unsigned long)(jb->underrun_rate * jb->window_frames);
+        unsigned long late = 0;
+        size_t k = 0;
+        while (k < JITTER_BUFFER_MAX_FRAMES && late + jb->slack_counts[k] <= allowed) {
+            late += jb->slack_counts[k++];
+        }
+        jb->pending_drops = k;
+        reset_window(jb);
+    }
+    *frame = jb->playing = current;
+    return result;
+}
+
+/**
+ * Consumer side: reports that the frame from jitter_buffer_pop() has been
+ * handed to the device.
+ *
+ * The frame goes back to the recycle queue. A write that blocked means the
+ * device sets the pace: it just made room for a frame and still holds at
+ * least one, so the next frame is due one period later. A write that
+ * returned past the next deadline moves the schedule back to now. A device
+ * xrun grows the buffer by one frame, like an underrun of the buffer itself.
+ *
+ * @param jb The jitter buffer.
+ * @param started_ns When the write was issued (CLOCK_MONOTONIC).
+ * @param returned_ns When it returned.
+ * @param device_xrun Nonzero if the device ran dry before the write.
+ */
+void jitter_buffer_written(JitterBuffer* jb, uint64_t started_ns, uint64_t returned_ns, int device_xrun) {
+    recycle(jb, jb->playing);
+    jb->playing = NULL;
+    if (returned_ns - started_ns >= jb->period_ns / 4) {
+        jb->deadline_ns = returned_ns + jb->period_ns;
+    } else if (returned_ns > jb->deadline_ns) {
+        jb->deadline_ns = returned_ns;
+    }
+    if (device_xrun) jb->pending_conceal = 1;
+}
+
+/**
+ * Copies the jitter buffer's state. Safe from any thread at any time.
+ *
+ * @param jb The jitter buffer.
+ * @param stats Receives the snapshot.
+ */
+void jitter_buffer_stats(JitterBuffer* jb, JitterBufferStats* stats) {
+    stats->depth = frame_queue_count(jb->queue);
+    stats->latency = load_counter(&jb->latency_ns) * 1e-9;
+    stats->jitter = load_counter(&jb->jitter_ns) * 1e-9;
+    stats->played = load_counter(&jb->played);
+    stats->underruns = load_counter(&jb->underruns);
+    stats->grows = load_counter(&jb->grows);
+    stats->shrinks = load_counter(&jb->shrinks);
+    stats->overflows = load_counter(&jb->overflows);
+}
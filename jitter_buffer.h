@@ -0,0 +1,88 @@
+#ifndef JITTER_BUFFER_H
+#define JITTER_BUFFER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include "frame_pool.h"
+
+#define JITTER_BUFFER_MAX_FRAMES 16        // Queue capacity (power of two)
+#define JITTER_BUFFER_INITIAL_MARGIN 1     // Frames of margin to start with (0 = play frames as they arrive)
+#define JITTER_BUFFER_UNDERRUN_RATE 0.001f // Default target: at most 1 concealed frame in 1000
+#define JITTER_BUFFER_CALM_SECONDS 2.0     // Shortest window of playback without underruns before shrinking
+
+// What jitter_buffer_pop() produced
+typedef enum {
+    JITTER_FRAME_PLAYED = 0,   // The next processed frame
+    JITTER_FRAME_DROPPED,      // Two frames crossfaded into one (the buffer shrank)
+    JITTER_FRAME_CONCEALED     // No frame was there in time: a fade to silence (the buffer grew)
+} JitterFrame;
+
+// Adaptive playout buffer between the processing thread (producer) and the
+// output thread (consumer). Processed frames are queued with their arrival
+// time; playback starts once JITTER_BUFFER_INITIAL_MARGIN + 1 frames are
+// queued, then the consumer plays one frame per period on that schedule and
+// measures each frame's slack (how long before its slot it arrived). A frame
+// that misses its slot is concealed, which delays the schedule by one frame
+// (grow). Once a calm window shows that the target underrun rate would hold
+// with less slack, the surplus frames are dropped with a crossfade (shrink).
+//
+// Frames move through it by pointer: the producer queues frames it owns,
+// the consumer plays them in place and hands each one to the recycle queue
+// once the device has it. The queue is lock-free; the controller state is
+// owned by the consumer and the counters are relaxed atomics any thread may
+// read.
+typedef struct {
+    FrameQueue* queue;             // Processing thread -> output thread
+    FrameQueue* recycle;           // Played frames go back here (output thread -> processing thread)
+    // Producer
+    _Alignas(CACHE_LINE_SIZE) uint64_t last_queued_ns;
+    // Consumer
+    _Alignas(CACHE_LINE_SIZE) uint64_t deadline_ns; // When the next frame is due (0 = still priming)
+    Frame* playing;                // Frame handed out by the last pop
+    Frame conceal;                 // Consumer-owned frame for concealment
+    size_t pending_drops;
+    int pending_conceal;           // Device xrun: conceal the next frame
+    int fade_in;                   // Fade in the next frame after a concealment
+    float last_sample;             // End of the previous output frame
+    unsigned long window_frames;   // Frames played in the current calm window
+    unsigned long window_length;
+    unsigned long slack_counts[JITTER_BUFFER_MAX_FRAMES + 1]; // By slack in whole periods
+
+    size_t frame_size;
+    uint64_t period_ns;
+    float underrun_rate;
+    DspArena* arena;
+
+    // Readable from any thread
+    _Alignas(CACHE_LINE_SIZE) atomic_ulong latency_ns; // Smoothed time from a frame's arrival to its slot
+    atomic_ulong jitter_ns;        // Smoothed arrival jitter (RFC 3550 estimator)
+    atomic_ulong played;
+    atomic_ulong underruns;        // Frames concealed because none arrived in time
+    atomic_ulong grows;            // Underruns plus device xruns
+    atomic_ulong shrinks;          // Frames dropped to cut latency
+    atomic_ulong overflows;        // Processed frames refused because the buffer was full
+} JitterBuffer;
+
+// Plain copy of the counters
+typedef struct {
+    size_t depth;                  // Frames queued right now
+    double latency;                // Latency the buffer adds: arrival to playout slot (seconds, smoothed)
+    double jitter;                 // Arrival jitter (seconds, smoothed)
+    unsigned long played;
+    unsigned long underruns;
+    unsigned long grows;
+    unsigned long shrinks;
+    unsigned long overflows;
+} JitterBufferStats;
+
+JitterBuffer* jitter_buffer_create(DspArena* arena, size_t frame_size, size_t sample_rate, float underrun_rate,
+                                   FrameQueue* recycle);
+void jitter_buffer_destroy(JitterBuffer* jb);
+int jitter_buffer_push(JitterBuffer* jb, Frame* frame, uint64_t now_ns);
+uint64_t jitter_buffer_poll(JitterBuffer* jb, uint64_t now_ns);
+JitterFrame jitter_buffer_pop(JitterBuffer* jb, uint64_t now_ns, Frame** frame);
+void jitter_buffer_written(JitterBuffer* jb, uint64_t started_ns, uint64_t returned_ns, int device_xrun);
+void jitter_buffer_stats(JitterBuffer* jb, JitterBufferStats* stats);
+
+#endif
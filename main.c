@@ -1,4 +1,115 @@
 #include "gui.h"
+#include "stream_server.h"
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define MAX_FILE_STREAMS 64
+
+static int valid_pitch(float pitch) {
+    if (pitch < 0.25f || pitch > 4.0f) {
+        fprintf(stderr, "Pitch factor must be between 0.25 and 4.0\n");
+        return 0;
+    }
+    return 1;
+}
+
+static int valid_block_size(size_t size, const char* option) {
+    if (size < LIVE_MIN_BLOCK_SIZE || size > LIVE_MAX_BLOCK_SIZE) {
+        fprintf(stderr, "%s must be between %d and %d samples\n", option, LIVE_MIN_BLOCK_SIZE, LIVE_MAX_BLOCK_SIZE);
+        return 0;
+    }
+    return 1;
+}
+
+static int valid_speed(float speed) {
+    if (speed < PV_MIN_SPEED || speed > PV_MAX_SPEED) {
+        fprintf(stderr, "Speed factor must be between %.1f and %.1f\n", PV_MIN_SPEED, PV_MAX_SPEED);
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * Parses "thread=spec" (see thread_sched_parse()) into the entry of that
+ * pipeline thread.
+ */
+static int parse_sched_option(const char* option, ThreadSched* sched) {
+    const char* spec = strchr(option, '=');
+    if (!spec) return -1;
+    for (int t = 0; t < PIPELINE_THREAD_COUNT; t++) {
+        const char* name = pipeline_thread_name((PipelineThread)t);
+        if (strlen(name) == (size_t)(spec - option) && strncmp(option, name, spec - option) == 0) {
+            return thread_sched_parse(spec + 1, &sched[t]);
+        }
+    }
+    return -1;
+}
+
+/**
+ * Runs the multi-stream server: every --stream spec ("in.wav:out.wav" with an
+ * optional ":pitch") is one file stream, and --socket PATH --clients N adds N
+ * socket streams. Each stream gets its own copy of the parameters.
+ */
+static int run_server(char** specs, int num_specs, const char* socket_path, int clients,
+                      int workers, int realtime, const ModulationParams* defaults) {
+    if (fft_planner_configure(defaults->fft_rigor, defaults->wisdom_path) < 0) return 1;
+
+    StreamServer* server = stream_server_create(workers, realtime);
+    if (!server) return 1;
+
+    for (int i = 0; i < num_specs; i++) {
+        ModulationParams params = *defaults;
+        char* output = strchr(specs[i], ':');
+        if (!output) {
+            fprintf(stderr, "Stream spec must be in.wav:out.wav[:pitch]: %s\n", specs[i]);
+            stream_server_destroy(server);
+            return 1;
+        }
+        *output++ = '\0';
+        char* pitch = strchr(output, ':');
+        if (pitch) {
+            *pitch++ = '\0';
+            params.pitch_factor = strtof(pitch, NULL);
+        }
+        if (!valid_pitch(params.pitch_factor) ||
+            stream_server_add_file(server, specs[i], output, &params) < 0) {
+            stream_server_destroy(server);
+            return 1;
+        }
+    }
+
+    if (socket_path && stream_server_accept_sockets(server, socket_path, clients, defaults) < 0) {
+        stream_server_destroy(server);
+        return 1;
+    }
+    fft_planner_save_wisdom();
+
+    int result = stream_server_run(server);
+    stream_server_destroy(server);
+    return result < 0 ? 1 : 0;
+}
+
+/**
+ * Runs the live threaded pipeline headless on the virtual device for the
+ * configured device time, then prints the usual exit reports.
+ */
+static int run_virtual_device(ModulationParams* params, const VirtualDeviceConfig* device) {
+    params->virtual_device = device;
+    if (init_audio_pipeline(params) < 0) {
+        fprintf(stderr, "Failed to initialize audio pipeline\n");
+        return 1;
+    }
+
+    double wall = device->duration / device->clock_scale;
+    printf("Running on the virtual device for %.1f s of device time (%.1f s wall clock)\n",
+           device->duration, wall);
+    struct timespec ts = { (time_t)wall, (long)((wall - (time_t)wall) * 1e9) };
+    nanosleep(&ts, NULL);
+
+    cleanup_audio_pipeline();
+    return 0;
+}
 
 int main(int argc, char **argv) {
     // Initialize GUI widgets structure
@@ -7,13 +118,248 @@ int main(int argc, char **argv) {
     // Initialize modulation parameters with defaults
     ModulationParams mod_params = {
         .pitch_factor = 1.0f,
+        .pitch_engine = PITCH_ENGINE_PHASE_VOCODER,
         .speed_factor = 1.0f,
         .echo_intensity = 0.0f,
         .reverb_intensity = 0.0f,
-        .echo_delay = 0,
-        .sample_rate = 44100
+        .echo_delay = 300,
+        .sample_rate = 44100,
+        .pipeline_mode = PIPELINE_MODE_DUPLEX,
+        .fft_rigor = FFT_RIGOR_MEASURE,
+        .wisdom_path = NULL,
+        .reverb_mode = REVERB_MODE_CONVOLUTION,
+        .reverb_ir_path = NULL,
+        .stats_interval = 0.0f,
+        .latency_slo_ms = 0.0f,
+        .sched = { THREAD_SCHED_NONE, THREAD_SCHED_NONE, THREAD_SCHED_NONE },
+        .virtual_device = NULL,
+        .jitter_underrun_rate = JITTER_BUFFER_UNDERRUN_RATE,
+        .frame_size = LIVE_FRAME_SIZE,
+        .callback_size = LIVE_CALLBACK_SIZE,
+        .buffer_frames = LIVE_BUFFER_FRAMES,
+        .device_latency = LIVE_DEVICE_LATENCY,
+        .calibrate_miss_rate = 0.0f,
+        .lookahead = DYNAMICS_LOOKAHEAD
     };
 
+    // FFTW wisdom is cached per user so restarts skip the planner
+    char wisdom_path[1024];
+    const char *home = getenv("HOME");
+    if (home) {
+        snprintf(wisdom_path, sizeof(wisdom_path), "%s/.voice_modulator_wisdom", home);
+        mod_params.wisdom_path = wisdom_path;
+    }
+
+    const char *input_path = NULL;
+    const char *output_path = NULL;
+    char *stream_specs[MAX_FILE_STREAMS];
+    int num_streams = 0;
+    const char *socket_path = NULL;
+    int clients = 1;
+    int workers = 0;
+    int realtime = 0;
+    VirtualDeviceConfig virtual_device;
+    int use_virtual_device = 0;
+    CpuIsa isa = CPU_ISA_AUTO;
+    virtual_device_config_init(&virtual_device);
+
+    // --threaded selects the blocking three-thread pipeline instead of the duplex callback;
+    // --in/--out process a WAV file headlessly instead of opening the GUI;
+    // --stream/--socket run many independent streams on a work-stealing pool;
+    // --fft-rigor and --wisdom/--no-wisdom control FFT planning;
+    // --reverb-ir loads an impulse response for the convolution reverb;
+    // --stats-interval prints live timing stats, checked against --latency-slo;
+    // --sched THREAD=[fifo|rr|other][:priority][@cpu] sets a live thread's scheduling;
+    // --jitter-target sets the underrun rate the threaded pipeline's jitter buffer aims for;
+    // --frame-size/--callback-size/--buffer-frames/--device-latency size the live blocks and buffers,
+    // or --calibrate picks the smallest block size that meets a target miss rate on this machine;
+    // --isa forces a SIMD kernel set instead of the best one this CPU supports;
+    // --lookahead sets the output limiter's look-ahead (and added latency) in samples;
+    // --device virtual runs the threaded pipeline headless on a simulated device
+    // (--virtual-source/-out/-clock/-jitter/-duration/-seed configure it)
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--threaded") == 0) {
+            mod_params.pipeline_mode = PIPELINE_MODE_THREADED;
+        } else if (strcmp(argv[i], "--in") == 0 && i + 1 < argc) {
+            input_path = argv[++i];
+        } else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+            output_path = argv[++i];
+        } else if (strcmp(argv[i], "--pitch") == 0 && i + 1 < argc) {
+            mod_params.pitch_factor = strtof(argv[++i], NULL);
+        } else if (strcmp(argv[i], "--pitch-engine") == 0 && i + 1 < argc) {
+            const char *engine = argv[++i];
+            if (strcmp(engine, "pv") == 0) {
+                mod_params.pitch_engine = PITCH_ENGINE_PHASE_VOCODER;
+            } else if (strcmp(engine, "wsola") == 0) {
+                mod_params.pitch_engine = PITCH_ENGINE_WSOLA;
+            } else {
+                fprintf(stderr, "Pitch engine must be pv or wsola\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--speed") == 0 && i + 1 < argc) {
+            mod_params.speed_factor = strtof(argv[++i], NULL);
+        } else if (strcmp(argv[i], "--echo") == 0 && i + 1 < argc) {
+            mod_params.echo_intensity = strtof(argv[++i], NULL);
+        } else if (strcmp(argv[i], "--echo-delay") == 0 && i + 1 < argc) {
+            mod_params.echo_delay = (size_t)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--reverb") == 0 && i + 1 < argc) {
+            mod_params.reverb_intensity = strtof(argv[++i], NULL);
+        } else if (strcmp(argv[i], "--reverb-ir") == 0 && i + 1 < argc) {
+            mod_params.reverb_ir_path = argv[++i];
+        } else if (strcmp(argv[i], "--reverb-mode") == 0 && i + 1 < argc) {
+            const char *mode = argv[++i];
+            if (strcmp(mode, "conv") == 0) {
+                mod_params.reverb_mode = REVERB_MODE_CONVOLUTION;
+            } else if (strcmp(mode, "fdn") == 0) {
+                mod_params.reverb_mode = REVERB_MODE_FDN;
+            } else {
+                fprintf(stderr, "Reverb mode must be conv or fdn\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--stream") == 0 && i + 1 < argc) {
+            if (num_streams == MAX_FILE_STREAMS) {
+                fprintf(stderr, "At most %d --stream options are supported\n", MAX_FILE_STREAMS);
+                return 1;
+            }
+            stream_specs[num_streams++] = argv[++i];
+        } else if (strcmp(argv[i], "--socket") == 0 && i + 1 < argc) {
+            socket_path = argv[++i];
+        } else if (strcmp(argv[i], "--clients") == 0 && i + 1 < argc) {
+            clients = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc) {
+            workers = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--realtime") == 0) {
+            realtime = 1;
+        } else if (strcmp(argv[i], "--fft-rigor") == 0 && i + 1 < argc) {
+            if (fft_rigor_parse(argv[++i], &mod_params.fft_rigor) < 0) {
+                fprintf(stderr, "FFT rigor must be estimate, measure or patient\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--wisdom") == 0 && i + 1 < argc) {
+            mod_params.wisdom_path = argv[++i];
+        } else if (strcmp(argv[i], "--no-wisdom") == 0) {
+            mod_params.wisdom_path = NULL;
+        } else if (strcmp(argv[i], "--stats-interval") == 0 && i + 1 < argc) {
+            mod_params.stats_interval = strtof(argv[++i], NULL);
+        } else if (strcmp(argv[i], "--latency-slo") == 0 && i + 1 < argc) {
+            mod_params.latency_slo_ms = strtof(argv[++i], NULL);
+        } else if (strcmp(argv[i], "--sched") == 0 && i + 1 < argc) {
+            if (parse_sched_option(argv[++i], mod_params.sched) < 0) {
+                fprintf(stderr, "--sched takes input|processing|output=[fifo|rr|other][:1-99][@cpu], "
+                                "e.g. processing=fifo:80@2\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--jitter-target") == 0 && i + 1 < argc) {
+            mod_params.jitter_underrun_rate = strtof(argv[++i], NULL);
+            if (!(mod_params.jitter_underrun_rate > 0.0f && mod_params.jitter_underrun_rate <= 0.5f)) {
+                fprintf(stderr, "Jitter buffer underrun rate must be above 0 and at most 0.5\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--frame-size") == 0 && i + 1 < argc) {
+            mod_params.frame_size = strtoul(argv[++i], NULL, 10);
+            if (!valid_block_size(mod_params.frame_size, "Frame size")) return 1;
+        } else if (strcmp(argv[i], "--callback-size") == 0 && i + 1 < argc) {
+            mod_params.callback_size = strtoul(argv[++i], NULL, 10);
+            if (!valid_block_size(mod_params.callback_size, "Callback size")) return 1;
+        } else if (strcmp(argv[i], "--buffer-frames") == 0 && i + 1 < argc) {
+            mod_params.buffer_frames = strtoul(argv[++i], NULL, 10);
+            if (mod_params.buffer_frames < 1 || mod_params.buffer_frames > LIVE_MAX_BUFFER_FRAMES) {
+                fprintf(stderr, "Buffer depth must be between 1 and %d frames\n", LIVE_MAX_BUFFER_FRAMES);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--device-latency") == 0 && i + 1 < argc) {
+            mod_params.device_latency = strtod(argv[++i], NULL) / 1000.0;
+            if (!(mod_params.device_latency > 0.0 && mod_params.device_latency <= 1.0)) {
+                fprintf(stderr, "Device latency must be above 0 and at most 1000 ms\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--calibrate") == 0 && i + 1 < argc) {
+            mod_params.calibrate_miss_rate = strtof(argv[++i], NULL);
+            if (!(mod_params.calibrate_miss_rate > 0.0f && mod_params.calibrate_miss_rate <= 0.5f)) {
+                fprintf(stderr, "Calibration miss rate must be above 0 and at most 0.5\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--isa") == 0 && i + 1 < argc) {
+            if (cpu_isa_parse(argv[++i], &isa) < 0) {
+                fprintf(stderr, "ISA must be auto, scalar, sse4.2, avx2, avx512 or neon\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--lookahead") == 0 && i + 1 < argc) {
+            mod_params.lookahead = strtoul(argv[++i], NULL, 10);
+            if (mod_params.lookahead != 0 &&
+                (mod_params.lookahead < DYNAMICS_MIN_LOOKAHEAD || mod_params.lookahead > DYNAMICS_MAX_LOOKAHEAD)) {
+                fprintf(stderr, "Look-ahead must be 0 or %d - %d samples\n", DYNAMICS_MIN_LOOKAHEAD,
+                        DYNAMICS_MAX_LOOKAHEAD);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--device") == 0 && i + 1 < argc) {
+            const char *device = argv[++i];
+            if (strcmp(device, "virtual") == 0) {
+                use_virtual_device = 1;
+            } else if (strcmp(device, "default") != 0) {
+                fprintf(stderr, "Device must be default or virtual\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--virtual-source") == 0 && i + 1 < argc) {
+            if (virtual_device_parse_source(argv[++i], &virtual_device) < 0) {
+                fprintf(stderr, "Virtual source must be sine[:hz], noise or a WAV file\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--virtual-out") == 0 && i + 1 < argc) {
+            virtual_device.output_path = argv[++i];
+        } else if (strcmp(argv[i], "--virtual-clock") == 0 && i + 1 < argc) {
+            virtual_device.clock_scale = strtof(argv[++i], NULL);
+        } else if (strcmp(argv[i], "--virtual-jitter") == 0 && i + 1 < argc) {
+            virtual_device.jitter_ms = strtof(argv[++i], NULL);
+        } else if (strcmp(argv[i], "--virtual-duration") == 0 && i + 1 < argc) {
+            virtual_device.duration = strtof(argv[++i], NULL);
+        } else if (strcmp(argv[i], "--virtual-seed") == 0 && i + 1 < argc) {
+            virtual_device.seed = (unsigned)strtoul(argv[++i], NULL, 10);
+        }
+    }
+
+    // Every mode runs the same kernels, so pick them before anything starts
+    if (spectral_kernels_init(isa) < 0) return 1;
+    printf("SIMD kernels: %s (best for this CPU: %s)\n", spectral_kernels_isa(), cpu_isa_name(cpu_detect_isa()));
+
+    if (num_streams > 0 || socket_path) {
+        if (!valid_pitch(mod_params.pitch_factor) || !valid_speed(mod_params.speed_factor) || clients < 1) {
+            fprintf(stderr, "Usage: %s [--stream in.wav:out.wav[:pitch]]... [--socket path --clients N]\n"
+                            "          [--workers N] [--realtime] [--pitch factor] [--pitch-engine pv|wsola]\n"
+                            "          [--speed factor]\n", argv[0]);
+            return 1;
+        }
+        return run_server(stream_specs, num_streams, socket_path, clients, workers, realtime, &mod_params);
+    }
+
+    if (input_path || output_path) {
+        if (!input_path || !output_path) {
+            fprintf(stderr, "Usage: %s --in input.wav --out output.wav [--pitch factor] [--pitch-engine pv|wsola]\n"
+                            "          [--speed factor] [--echo 0-1] [--echo-delay ms]\n"
+                            "          [--reverb 0-1] [--reverb-ir ir.wav] [--reverb-mode conv|fdn]\n"
+                            "          [--lookahead samples]\n", argv[0]);
+            return 1;
+        }
+        if (!valid_pitch(mod_params.pitch_factor) || !valid_speed(mod_params.speed_factor)) {
+            return 1;
+        }
+        return run_offline_pipeline(input_path, output_path, &mod_params) < 0 ? 1 : 0;
+    }
+
+    if (use_virtual_device) {
+        if (!valid_pitch(mod_params.pitch_factor) || !valid_speed(mod_params.speed_factor) ||
+            virtual_device.clock_scale <= 0.0f || virtual_device.jitter_ms < 0.0f ||
+            virtual_device.duration <= 0.0f) {
+            fprintf(stderr, "Usage: %s --device virtual [--virtual-source sine[:hz]|noise|in.wav]\n"
+                            "          [--virtual-out out.wav] [--virtual-clock scale > 0] [--virtual-jitter ms]\n"
+                            "          [--virtual-duration seconds] [--virtual-seed n] [--sched ...]\n"
+                            "          [--jitter-target rate] [--frame-size n] [--buffer-frames n]\n"
+                            "          [--calibrate miss-rate]\n", argv[0]);
+            return 1;
+        }
+        return run_virtual_device(&mod_params, &virtual_device);
+    }
+
     // Initialize the GUI
     if (init_gui(&argc, &argv, &widgets, &mod_params) < 0) {
         fprintf(stderr, "Failed to initialize GUI\n");
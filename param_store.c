@@ -0,0 +1,54 @@
+#include "param_store.h"
+
+/**
+ * Fills every slot with the same parameters, so the reader sees them even
+ * before the first publish.
+ *
+ * @param store The store (not yet shared with other threads).
+ * @param params The initial parameters.
+ */
+void param_store_init(ParamStore* store, const ModulationParams* params) {
+    for (unsigned i = 0; i < 3; i++) {
+        store->slots[i].params = *params;
+    }
+    store->front = 0;
+    store->back = 1;
+    store->published = 0;
+    store->acquired = 0;
+    atomic_store_explicit(&store->middle, 2, memory_order_relaxed);
+}
+
+/**
+ * Publishes a new snapshot. Only one thread may publish. The call never
+ * waits for the reader; a snapshot the reader has not picked up yet is
+ * simply replaced.
+ *
+ * @param store The store.
+ * @param params The complete new parameter set.
+ */
+void param_store_publish(ParamStore* store, const ModulationParams* params) {
+    store->slots[store->back].params = *params;
+    // Release: the slot contents are visible before the reader can take it
+    unsigned old = atomic_exchange_explicit(&store->middle, store->back | PARAM_STORE_FRESH,
+                                            memory_order_acq_rel);
+    store->back = old & ~PARAM_STORE_FRESH;
+    store->published++;
+}
+
+/**
+ * Returns the newest published snapshot. Only one thread may acquire. The
+ * snapshot stays valid and unchanged until that thread's next call, so the
+ * audio thread calls this once per block and uses the result throughout.
+ *
+ * @param store The store.
+ * @return The parameters to use for the next block.
+ */
+const ModulationParams* param_store_acquire(ParamStore* store) {
+    if (atomic_load_explicit(&store->middle, memory_order_relaxed) & PARAM_STORE_FRESH) {
+        // Acquire: pairs with the release in param_store_publish()
+        unsigned old = atomic_exchange_explicit(&store->middle, store->front, memory_order_acq_rel);
+        store->front = old & ~PARAM_STORE_FRESH;
+        store->acquired++;
+    }
+    return &store->slots[store->front].params;
+}
@@ -0,0 +1,33 @@
+#ifndef PARAM_STORE_H
+#define PARAM_STORE_H
+
+#include <stdatomic.h>
+#include "voice_modulator.h"
+
+#define PARAM_STORE_FRESH 4u  // Set in `middle` while it holds an unread snapshot
+
+// One copy of the parameters on its own cache line
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) ModulationParams params;
+} ParamSlot;
+
+// Hands parameter snapshots from one control thread (the GUI) to one audio
+// thread without locks or retries (a triple buffer). The writer fills the
+// back slot and swaps it with the middle one; the reader swaps the middle
+// slot with its front slot when a fresh snapshot is waiting. Each side only
+// ever touches the slot it owns, so a snapshot can never be torn, and both
+// sides finish in a constant number of steps.
+typedef struct {
+    ParamSlot slots[3];
+    _Alignas(CACHE_LINE_SIZE) atomic_uint middle;  // Slot index | PARAM_STORE_FRESH
+    _Alignas(CACHE_LINE_SIZE) unsigned back;       // Writer-owned slot
+    unsigned long published;
+    _Alignas(CACHE_LINE_SIZE) unsigned front;      // Reader-owned slot
+    unsigned long acquired;
+} ParamStore;
+
+void param_store_init(ParamStore* store, const ModulationParams* params);
+void param_store_publish(ParamStore* store, const ModulationParams* params);
+const ModulationParams* param_store_acquire(ParamStore* store);
+
+#endif
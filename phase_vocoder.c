@@ -1,278 +1,830 @@
 #include "phase_vocoder.h"
+#include <time.h>
+#include <unistd.h>
 
-// Global variables for threads and resources
-static pthread_t input_thread, processing_thread, output_thread;
-static float input_buffer[FRAME_SIZE];
-static float output_buffer[FRAME_SIZE];
-static float* overlap_buffer = NULL;
+// The FFTW planner is not thread-safe; only fftwf_execute*() may run concurrently
+static pthread_mutex_t planner_lock = PTHREAD_MUTEX_INITIALIZER;
+static FftRigor planner_rigor = FFT_RIGOR_MEASURE;
+static char planner_wisdom_path[1024];
+static double planner_seconds = 0.0;  // Wall time spent creating plans
+static int planner_configured = 0;
 
 /**
- * Creates a circular buffer of the specified size.
+ * Applies a window to a frame in place with the SIMD kernels selected at
+ * startup (see spectral_kernels_init()).
  *
- * The buffer is initialized with all zeros, and the read and write positions
- * are set to zero. The buffer is protected by a mutex for thread safety.
+ * @param input The frame to be windowed.
+ * @param window The window function to be applied.
+ * @param length The length of the frame and window.
+ */
+void apply_window_simd(float* input, float* window, size_t length) {
+    multiply_samples(input, window, length);
+}
+
+/**
+ * Shifts the pitch of one analysis frame given in polar form.
+ *
+ * The phase of every partial is kept coherent with the previous frame. The
+ * steps are: 1) Take the phase difference to the same bin of the previous
+ * frame, remove the advance expected for a bin-centred sinusoid over one hop
+ * and wrap it to [-pi, pi]; 2) Turn the deviation into the true frequency of
+ * the bin (in bins); 3) Move each bin to k * pitch_factor and scale its
+ * frequency by the same amount; 4) Advance the synthesis phase accumulator
+ * of each output bin by its frequency over one hop.
  *
- * @param size The size of the circular buffer in floats.
- * @return A pointer to the created CircularBuffer object.
+ * This is the only part of the STFT that depends on the previous frame, so
+ * it has to run frames in order. All loops except the scatter are
+ * branch-free and vectorisable.
+ *
+ * @param mag In: analysis magnitude of each bin. Out: synthesis magnitude.
+ * @param phase In: analysis phase of each bin. Out: synthesis phase.
+ * @param prev_phase The analysis phase of each bin from the previous frame.
+ * @param phase_accum The synthesis phase accumulator of each bin.
+ * @param work Scratch space of 2 * NUM_BINS floats.
+ * @param pitch_factor The pitch factor.
+ * @param analysis_hop Input samples since the previous frame. Synthesis
+ *                     always advances HOP_SIZE, so any other hop stretches
+ *                     time by HOP_SIZE / analysis_hop.
  */
-CircularBuffer* create_circular_buffer(size_t size) {
-    CircularBuffer* cb = malloc(sizeof(CircularBuffer));
-    cb->buffer = calloc(size, sizeof(float));
-    cb->size = size;
-    cb->read_pos = 0;
-    cb->write_pos = 0;
-    pthread_mutex_init(&cb->lock, NULL);
-    return cb;
+static void shift_pitch_polar(float* mag, float* phase, float* prev_phase,
+                              float* phase_accum, float* work, float pitch_factor,
+                              size_t analysis_hop) {
+    const size_t bins = NUM_BINS;
+    const float two_pi = 2 * M_PI;
+    const float expected = two_pi * HOP_SIZE / FRAME_SIZE;
+    const float analysis_expected = two_pi * analysis_hop / FRAME_SIZE;
+    const float to_bins = (float)FRAME_SIZE / (two_pi * analysis_hop);
+
+    float* syn_mag = work;
+    float* syn_freq = work + bins;
+
+    // Analysis: true frequency of each bin from its phase advance over the analysis hop
+    for (size_t k = 0; k < bins; k++) {
+        float phase_diff = phase[k] - prev_phase[k];
+        prev_phase[k] = phase[k];
+
+        phase_diff -= (float)k * analysis_expected;
+        phase_diff -= two_pi * roundf(phase_diff / two_pi);
+
+        phase[k] = (float)k + phase_diff * to_bins;
+    }
+
+    // Pitch shift: move every partial to k * pitch_factor
+    memset(syn_mag, 0, bins * sizeof(float));
+    memset(syn_freq, 0, bins * sizeof(float));
+    for (size_t k = 0; k < bins; k++) {
+        size_t index = (size_t)(k * pitch_factor + 0.5f);
+        if (index >= bins) break;
+        syn_mag[index] += mag[k];
+        syn_freq[index] = phase[k] * pitch_factor;
+    }
+
+    // Synthesis: accumulate phase at the shifted frequency
+    for (size_t k = 0; k < bins; k++) {
+        float phase_diff = (syn_freq[k] - (float)k) * two_pi / OVERLAP_RATIO;
+        phase_accum[k] += phase_diff + (float)k * expected;
+        phase_accum[k] -= two_pi * roundf(phase_accum[k] / two_pi);
+
+        mag[k] = syn_mag[k];
+        phase[k] = phase_accum[k];
+    }
 }
 
 /**
- * Writes the specified data to the circular buffer.
+ * Process FFT bins to implement the phase vocoder algorithm.
  *
- * This function writes the specified amount of data to the circular buffer
- * starting at the current write position. The write position is then advanced
- * by the amount of data written. If the write position reaches the end of the
- * buffer, it wraps around to the start of the buffer.
+ * Converts the bins to polar form with the SIMD kernels from
+ * spectral_kernels.c, shifts their pitch with shift_pitch_polar() and
+ * converts them back.
  *
- * @param cb The circular buffer to write to.
- * @param data The data to write.
- * @param length The amount of data to write in floats.
- * @return 0 on success.
+ * @param fft_out The FFT bins to be processed (NUM_BINS entries, in place).
+ * @param prev_phase The analysis phase of each bin from the previous frame.
+ * @param phase_accum The synthesis phase accumulator of each bin.
+ * @param work Scratch space of 4 * NUM_BINS floats.
+ * @param pitch_factor The pitch factor.
+ */
+void process_fft_bins(fftwf_complex* fft_out, float* prev_phase,
+                     float* phase_accum, float* work, float pitch_factor) {
+    float* mag = work;
+    float* phase = work + NUM_BINS;
+
+    cartesian_to_polar(fft_out, mag, phase, NUM_BINS);
+    shift_pitch_polar(mag, phase, prev_phase, phase_accum, work + 2 * NUM_BINS, pitch_factor, HOP_SIZE);
+    polar_to_cartesian(mag, phase, fft_out, NUM_BINS);
+}
+
+/**
+ * Windows, transforms and converts frame j of the batch to polar form.
+ * Uses FFTW's new-array execute, which is safe to call concurrently.
+ */
+static void analyse_frame(void* arg, size_t j) {
+    PhaseVocoder* pv = (PhaseVocoder*)arg;
+    memcpy(pv->frames[j], pv->stage + j * pv->batch_hop, FRAME_SIZE * sizeof(float));
+    apply_window_simd(pv->frames[j], pv->window, FRAME_SIZE);
+    fftwf_execute_dft_r2c(pv->forward_plan, pv->frames[j], pv->spectra[j]);
+    cartesian_to_polar(pv->spectra[j], pv->mags[j], pv->phases[j], NUM_BINS);
+}
+
+/**
+ * Rebuilds, inverse transforms and re-windows frame j of the batch.
  */
-int circular_buffer_write(CircularBuffer* cb, float* data, size_t length) {
-    pthread_mutex_lock(&cb->lock);
-    for (size_t i = 0; i < length; i++) {
-        cb->buffer[cb->write_pos] = data[i];
-        cb->write_pos = (cb->write_pos + 1) % cb->size;
+static void synthesise_frame(void* arg, size_t j) {
+    PhaseVocoder* pv = (PhaseVocoder*)arg;
+    polar_to_cartesian(pv->mags[j], pv->phases[j], pv->spectra[j], NUM_BINS);
+    fftwf_execute_dft_c2r(pv->inverse_plan, pv->spectra[j], pv->frames[j]);
+    apply_window_simd(pv->frames[j], pv->synthesis_window, FRAME_SIZE);
+}
+
+static void run_frames(PhaseVocoder* pv, DspTask task, size_t frames) {
+    if (pv->pool && pv->parallel_min_frames > 0 && frames >= pv->parallel_min_frames) {
+        dsp_pool_run(pv->pool, task, pv, frames);
+    } else {
+        for (size_t j = 0; j < frames; j++) {
+            task(pv, j);
+        }
     }
-    pthread_mutex_unlock(&cb->lock);
-    return 0;
+}
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static const unsigned rigor_flags[] = { FFTW_ESTIMATE, FFTW_MEASURE, FFTW_PATIENT };
+static const char* rigor_names[] = { "estimate", "measure", "patient" };
+
+/**
+ * @param rigor A planning rigor.
+ * @return Its lower-case name, as accepted by fft_rigor_parse().
+ */
+const char* fft_rigor_name(FftRigor rigor) {
+    return rigor_names[rigor];
 }
 
 /**
- * Reads the specified amount of data from the circular buffer.
+ * Parses "estimate", "measure" or "patient".
  *
- * This function reads the specified amount of data from the circular buffer
- * starting at the current read position. The read position is then advanced
- * by the amount of data read. If the read position reaches the end of the
- * buffer, it wraps around to the start of the buffer.
+ * @param name The name to parse.
+ * @param rigor Receives the rigor.
+ * @return 0 on success, -1 if the name is not recognised.
+ */
+int fft_rigor_parse(const char* name, FftRigor* rigor) {
+    for (int i = 0; i <= FFT_RIGOR_PATIENT; i++) {
+        if (strcmp(name, rigor_names[i]) == 0) {
+            *rigor = (FftRigor)i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @return The FFTW flags for the configured rigor. Plans made with them
+ *         must be created between fft_planner_lock() and fft_planner_unlock().
+ */
+unsigned fft_planner_flags(void) {
+    return rigor_flags[planner_rigor];
+}
+
+void fft_planner_lock(void) {
+    pthread_mutex_lock(&planner_lock);
+}
+
+void fft_planner_unlock(void) {
+    pthread_mutex_unlock(&planner_lock);
+}
+
+/**
+ * @return The total wall time spent creating plans so far, in seconds.
+ */
+double fft_planner_seconds(void) {
+    return planner_seconds;
+}
+
+/**
+ * Creates a real-to-complex plan of size n at the configured rigor. The
+ * planner lock is held and the time spent is added to fft_planner_seconds().
+ * The plan may be executed on other arrays with fftwf_execute_dft_r2c() as
+ * long as they come from fftwf_malloc.
+ *
+ * @return The plan, or NULL on failure.
+ */
+fftwf_plan fft_plan_r2c(int n, float* in, fftwf_complex* out) {
+    fft_planner_lock();
+    double start = now_seconds();
+    fftwf_plan plan = fftwf_plan_dft_r2c_1d(n, in, out, fft_planner_flags());
+    planner_seconds += now_seconds() - start;
+    fft_planner_unlock();
+    return plan;
+}
+
+/**
+ * Creates a complex-to-real plan of size n; see fft_plan_r2c().
+ *
+ * @return The plan, or NULL on failure.
+ */
+fftwf_plan fft_plan_c2r(int n, fftwf_complex* in, float* out) {
+    fft_planner_lock();
+    double start = now_seconds();
+    fftwf_plan plan = fftwf_plan_dft_c2r_1d(n, in, out, fft_planner_flags());
+    planner_seconds += now_seconds() - start;
+    fft_planner_unlock();
+    return plan;
+}
+
+/**
+ * Destroys a plan under the planner lock.
+ *
+ * @param plan The plan (NULL is ignored).
+ */
+void fft_plan_destroy(fftwf_plan plan) {
+    if (!plan) return;
+    fft_planner_lock();
+    fftwf_destroy_plan(plan);
+    fft_planner_unlock();
+}
+
+/**
+ * Configures FFT planning for the process and builds the phase vocoder's
+ * plans once, so that every later phase_vocoder_create() finds them in
+ * FFTW's wisdom instead of benchmarking again.
  *
- * @param cb The circular buffer to read from.
- * @param data The array to store the read data in.
- * @param length The amount of data to read in floats.
- * @return 0 on success.
+ * Wisdom is first imported from wisdom_path (a missing file is fine: it is
+ * written by fft_planner_save_wisdom()). Call this before any stream starts;
+ * repeated calls with the same settings do nothing.
+ *
+ * @param rigor How hard FFTW searches for fast plans.
+ * @param wisdom_path The wisdom cache file, or NULL to plan from scratch.
+ * @return 0 on success, -1 if the plans could not be created.
  */
-int circular_buffer_read(CircularBuffer* cb, float* data, size_t length) {
-    pthread_mutex_lock(&cb->lock);
-    for (size_t i = 0; i < length; i++) {
-        data[i] = cb->buffer[cb->read_pos];
-        cb->read_pos = (cb->read_pos + 1) % cb->size;
+int fft_planner_configure(FftRigor rigor, const char* wisdom_path) {
+    const char* path = wisdom_path ? wisdom_path : "";
+    if (planner_configured && rigor == planner_rigor && strcmp(path, planner_wisdom_path) == 0) {
+        return 0;
     }
-    pthread_mutex_unlock(&cb->lock);
+
+    fft_planner_lock();
+    planner_rigor = rigor;
+    snprintf(planner_wisdom_path, sizeof(planner_wisdom_path), "%s", path);
+
+    int imported = 0;
+    if (planner_wisdom_path[0]) {
+        imported = fftwf_import_wisdom_from_filename(planner_wisdom_path);
+    }
+
+    float* frame = fftwf_malloc(sizeof(float) * FRAME_SIZE);
+    fftwf_complex* spectrum = fftwf_malloc(sizeof(fftwf_complex) * NUM_BINS);
+    fftwf_plan forward = NULL, inverse = NULL;
+    double start = now_seconds();
+    if (frame && spectrum) {
+        forward = fftwf_plan_dft_r2c_1d(FRAME_SIZE, frame, spectrum, fft_planner_flags());
+        inverse = fftwf_plan_dft_c2r_1d(FRAME_SIZE, spectrum, frame, fft_planner_flags());
+    }
+    double elapsed = now_seconds() - start;
+    planner_seconds += elapsed;
+    int ok = forward && inverse;
+    if (forward) fftwf_destroy_plan(forward);
+    if (inverse) fftwf_destroy_plan(inverse);
+    fftwf_free(frame);
+    fftwf_free(spectrum);
+    planner_configured = ok;
+    fft_planner_unlock();
+
+    if (!ok) {
+        printf("Error: Failed to create FFTW plans\n");
+        return -1;
+    }
+
+    printf("FFT planning: %s, %d-point plans in %.1f ms (wisdom %s)\n",
+           fft_rigor_name(rigor), FRAME_SIZE, elapsed * 1000.0,
+           !planner_wisdom_path[0] ? "disabled" : imported ? "loaded" : "not found, will be created");
     return 0;
 }
 
 /**
- * Applies the specified window function to the input signal.
- *
- * This function multiplies the input signal with the specified window function
- * element-wise. The window function is assumed to be of the same
- * length as the input signal. This function does not use SIMD instructions, if SIMD is not available -> slower.
- * This function was part of the original implementation of the phase_vocoder function (since I don't have access to the SIMD instructions)
- * Modify this function if you are running on a machine with SIMD support -> faster
- * 
- * @param input The input signal to be windowed.
- * @param window The window function to be applied.
- * @param length The length of the input signal and window function.
+ * Writes FFTW's accumulated wisdom to the configured cache file. The file is
+ * written under a temporary name and renamed, so a concurrent launch never
+ * reads a half-written cache.
+ *
+ * @return 0 on success or when no cache file is configured, -1 on failure.
  */
-void apply_window_simd(float* input, float* window, size_t length) {
-    for (size_t i = 0; i < length; i++) {
-        input[i] *= window[i];
+int fft_planner_save_wisdom(void) {
+    if (!planner_wisdom_path[0]) return 0;
+
+    char temp_path[sizeof(planner_wisdom_path) + 16];
+    snprintf(temp_path, sizeof(temp_path), "%s.%ld", planner_wisdom_path, (long)getpid());
+
+    fft_planner_lock();
+    int ok = fftwf_export_wisdom_to_filename(temp_path);
+    fft_planner_unlock();
+
+    if (!ok || rename(temp_path, planner_wisdom_path) != 0) {
+        printf("Warning: Failed to save FFTW wisdom to %s\n", planner_wisdom_path);
+        unlink(temp_path);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Queues the priming zeros so that fixed-size blocks never run short.
+ */
+static void queue_priming(PhaseVocoder* pv) {
+    float zeros[HOP_SIZE] = {0};
+    if (pv->priming > 0) {
+        circular_buffer_write(pv->out_queue, zeros, pv->priming);
+    }
+}
+
+/**
+ * Creates an independent phase vocoder stream.
+ *
+ * Every buffer comes from `arena` (DSP_ARENA_ALIGN aligned for the SIMD
+ * kernels, or the heap when it is NULL), and the plans are built at the rigor set by fft_planner_configure()
+ * (FFTW_MEASURE by default), which normally finds them in wisdom. The plans are
+ * single-threaded: a 1024-point transform is far too small for FFTW's own
+ * threading, and any parallelism comes from a worker pool running whole
+ * frames instead (see phase_vocoder_set_pool()).
+ *
+ * A frame completes every HOP_SIZE input samples, so the output comes in
+ * whole hops. block_size tells the instance how phase_vocoder_process() will
+ * be called: if it is a multiple of HOP_SIZE every block completes exactly
+ * block_size / HOP_SIZE frames and nothing extra is needed; otherwise
+ * HOP_SIZE - 1 zeros are queued up front so that a block never has to wait
+ * for a frame that the next block completes. Pass 0 when only push/pull is
+ * used.
+ *
+ * @param block_size The block length given to phase_vocoder_process(), or 0.
+ * @param arena Arena for the instance and its buffers, or NULL for the heap.
+ * @return The new instance, or NULL on failure.
+ */
+PhaseVocoder* phase_vocoder_create(size_t block_size, DspArena* arena) {
+    PhaseVocoder* pv = dsp_alloc(arena, sizeof(PhaseVocoder));
+    if (!pv) {
+        printf("Error: Failed to allocate phase vocoder\n");
+        return NULL;
+    }
+    pv->arena = arena;
+
+    pv->window = dsp_alloc(arena, sizeof(float) * FRAME_SIZE);
+    pv->synthesis_window = dsp_alloc(arena, sizeof(float) * FRAME_SIZE);
+    pv->stage = dsp_alloc(arena, sizeof(float) * STAGE_SIZE);
+    pv->prev_phase = dsp_alloc(arena, sizeof(float) * NUM_BINS);
+    pv->phase_accum = dsp_alloc(arena, sizeof(float) * NUM_BINS);
+    pv->bin_work = dsp_alloc(arena, sizeof(float) * 2 * NUM_BINS);
+    pv->in_fifo = dsp_alloc(arena, sizeof(float) * FRAME_SIZE);
+    pv->overlap_buffer = dsp_alloc(arena, sizeof(float) * FRAME_SIZE);
+    pv->out_queue = create_circular_buffer_in(arena, OUT_QUEUE_SIZE);
+    pv->backlog = create_circular_buffer_in(arena, PV_STRETCH_BACKLOG_SIZE);
+    pv->stretch_in = dsp_alloc(arena, sizeof(float) * MAX_BATCH_FRAMES * PV_MAX_ANALYSIS_HOP);
+    int failed = !pv->window || !pv->synthesis_window || !pv->stage || !pv->prev_phase ||
+                 !pv->phase_accum || !pv->bin_work || !pv->in_fifo || !pv->overlap_buffer ||
+                 !pv->out_queue || !pv->backlog || !pv->stretch_in;
+
+    for (size_t j = 0; j < MAX_BATCH_FRAMES && !failed; j++) {
+        pv->frames[j] = dsp_alloc(arena, sizeof(float) * FRAME_SIZE);
+        pv->spectra[j] = dsp_alloc(arena, sizeof(fftwf_complex) * NUM_BINS);
+        pv->mags[j] = dsp_alloc(arena, sizeof(float) * NUM_BINS);
+        pv->phases[j] = dsp_alloc(arena, sizeof(float) * NUM_BINS);
+        failed = !pv->frames[j] || !pv->spectra[j] || !pv->mags[j] || !pv->phases[j];
+    }
+
+    if (failed) {
+        printf("Error: Failed to allocate phase vocoder buffers\n");
+        phase_vocoder_destroy(pv);
+        return NULL;
+    }
+
+    // Periodic Hann window (denominator FRAME_SIZE rather than FRAME_SIZE - 1)
+    // so that squared windows spaced by HOP_SIZE sum to a constant
+    for (size_t i = 0; i < FRAME_SIZE; i++) {
+        pv->window[i] = 0.5 * (1 - cos(2 * M_PI * i / FRAME_SIZE));
+    }
+
+    // Analysis and synthesis both use the window, so the overlap-add gain
+    // is sum(w^2) / HOP_SIZE; FFTW's unnormalised inverse adds FRAME_SIZE
+    float window_energy = 0.0f;
+    for (size_t i = 0; i < FRAME_SIZE; i++) {
+        window_energy += pv->window[i] * pv->window[i];
+    }
+    float ola_norm = HOP_SIZE / (window_energy * FRAME_SIZE);
+    for (size_t i = 0; i < FRAME_SIZE; i++) {
+        pv->synthesis_window[i] = pv->window[i] * ola_norm;
+    }
+
+    pv->forward_plan = fft_plan_r2c(FRAME_SIZE, pv->frames[0], pv->spectra[0]);
+    pv->inverse_plan = fft_plan_c2r(FRAME_SIZE, pv->spectra[0], pv->frames[0]);
+    if (!pv->forward_plan || !pv->inverse_plan) {
+        printf("Error: Failed to create FFTW plans\n");
+        phase_vocoder_destroy(pv);
+        return NULL;
     }
+
+    pv->priming = (block_size % HOP_SIZE == 0) ? 0 : HOP_SIZE - 1;
+    phase_vocoder_reset(pv);
+    return pv;
+}
+
+/**
+ * Releases an instance and everything it owns. The attached pool (if any)
+ * belongs to the caller and is left running.
+ *
+ * @param pv The instance (NULL is ignored).
+ */
+void phase_vocoder_destroy(PhaseVocoder* pv) {
+    if (!pv) return;
+
+    fft_plan_destroy(pv->forward_plan);
+    fft_plan_destroy(pv->inverse_plan);
+
+    for (size_t j = 0; j < MAX_BATCH_FRAMES; j++) {
+        dsp_free(pv->arena, pv->frames[j]);
+        dsp_free(pv->arena, pv->spectra[j]);
+        dsp_free(pv->arena, pv->mags[j]);
+        dsp_free(pv->arena, pv->phases[j]);
+    }
+    dsp_free(pv->arena, pv->window);
+    dsp_free(pv->arena, pv->synthesis_window);
+    dsp_free(pv->arena, pv->stage);
+    dsp_free(pv->arena, pv->prev_phase);
+    dsp_free(pv->arena, pv->phase_accum);
+    dsp_free(pv->arena, pv->bin_work);
+    dsp_free(pv->arena, pv->in_fifo);
+    dsp_free(pv->arena, pv->overlap_buffer);
+    destroy_circular_buffer(pv->out_queue);
+    destroy_circular_buffer(pv->backlog);
+    dsp_free(pv->arena, pv->stretch_in);
+    dsp_free(pv->arena, pv);
+}
+
+static void drain_queue(CircularBuffer* queue) {
+    float scratch[HOP_SIZE];
+    size_t queued;
+    while ((queued = circular_buffer_available(queue)) > 0) {
+        circular_buffer_read(queue, scratch, queued < HOP_SIZE ? queued : HOP_SIZE);
+    }
+}
+
+/**
+ * Returns the instance to its freshly created state: phases, buffered input,
+ * the time-stretch backlog, overlap and queued output are cleared. Plans,
+ * pool and priming are kept. Must not run concurrently with push or pull on
+ * the same instance.
+ *
+ * @param pv The instance.
+ */
+void phase_vocoder_reset(PhaseVocoder* pv) {
+    drain_queue(pv->out_queue);
+    drain_queue(pv->backlog);
+
+    memset(pv->prev_phase, 0, sizeof(float) * NUM_BINS);
+    memset(pv->phase_accum, 0, sizeof(float) * NUM_BINS);
+    memset(pv->in_fifo, 0, sizeof(float) * FRAME_SIZE);
+    memset(pv->overlap_buffer, 0, sizeof(float) * FRAME_SIZE);
+
+    // Start as if FRAME_SIZE - HOP_SIZE zeros had been pushed, so the first
+    // frame completes after one hop of input
+    pv->in_fill = FRAME_SIZE - HOP_SIZE;
+    pv->analysis_hop = HOP_SIZE;
+    pv->batch_hop = HOP_SIZE;
+    pv->pitch = 0.0f;
+    pv->underruns = 0;
+    pv->backlog_peak = 0;
+    pv->stretch_limited = 0;
+    queue_priming(pv);
 }
 
 /**
- * Returns a pointer to a statically allocated Hann window array.
+ * Attaches a worker pool to the instance and decides when to use it.
  *
- * This function allocates memory for a Hann window array of length FRAME_SIZE
- * and initializes it on the first call. Subsequent calls return the same
- * pointer to the array.
+ * For each batch size the analysis and synthesis transforms are timed
+ * serially and through the pool, starting from parked workers as they will
+ * be between audio blocks. The pool is only used for batches at least as
+ * large as the smallest size where it was clearly faster; if it never was,
+ * the instance stays single-threaded. dsp_pool_run() has a single
+ * dispatcher, so instances that share a pool must not process concurrently.
  *
- * @return A pointer to the statically allocated Hann window array.
+ * @param pv The instance.
+ * @param pool The pool to use, or NULL to detach.
+ * @return The smallest batch size that will run in parallel (0 = never).
  */
-static float* get_window() {
-    static float* window = NULL;
-    static int initialized = 0;
-    
-    if (!initialized) {
-        window = malloc(sizeof(float) * FRAME_SIZE);
-        for (size_t i = 0; i < FRAME_SIZE; i++) {
-            window[i] = 0.5 * (1 - cos(2 * M_PI * i / (FRAME_SIZE - 1)));
+size_t phase_vocoder_set_pool(PhaseVocoder* pv, DspPool* pool) {
+    pv->pool = pool;
+    pv->parallel_min_frames = 0;
+    if (!pool) return 0;
+
+    // Calibrate on scratch data, then restore the stream state it clobbers
+    memset(pv->stage, 0, sizeof(float) * STAGE_SIZE);
+
+    for (size_t frames = 2; frames <= MAX_BATCH_FRAMES; frames *= 2) {
+        double serial = 1e9, parallel = 1e9;
+        for (int rep = 0; rep < 8; rep++) {
+            usleep(2000);
+            double start = now_seconds();
+            for (size_t j = 0; j < frames; j++) analyse_frame(pv, j);
+            for (size_t j = 0; j < frames; j++) synthesise_frame(pv, j);
+            double elapsed = now_seconds() - start;
+            if (elapsed < serial) serial = elapsed;
+
+            usleep(2000);
+            start = now_seconds();
+            dsp_pool_run(pool, analyse_frame, pv, frames);
+            dsp_pool_run(pool, synthesise_frame, pv, frames);
+            elapsed = now_seconds() - start;
+            if (elapsed < parallel) parallel = elapsed;
+        }
+
+        // Require a clear win so scheduling noise cannot flip the decision
+        if (parallel < 0.75 * serial) {
+            pv->parallel_min_frames = frames;
+            break;
         }
-        initialized = 1;
     }
-    return window;
+
+    if (pv->parallel_min_frames > 0) {
+        printf("DSP pool: %d workers, parallel STFT for batches of %zu+ frames (dispatch %.1f us)\n",
+               pool->num_workers, pv->parallel_min_frames, pool->dispatch_seconds * 1e6);
+    } else {
+        printf("DSP pool: %d workers, parallel STFT disabled (dispatch %.1f us outweighs the work)\n",
+               pool->num_workers, pool->dispatch_seconds * 1e6);
+    }
+    return pv->parallel_min_frames;
 }
 
+/**
+ * Converts a speed factor to an analysis hop.
+ *
+ * @param speed_factor Playback speed (PV_MIN_SPEED - PV_MAX_SPEED).
+ * @return Input samples between frames, within 1 - PV_MAX_ANALYSIS_HOP.
+ */
+static size_t analysis_hop_for(float speed_factor) {
+    long hop = lroundf(speed_factor * HOP_SIZE);
+    if (hop < 1) hop = 1;
+    if (hop > PV_MAX_ANALYSIS_HOP) hop = PV_MAX_ANALYSIS_HOP;
+    return (size_t)hop;
+}
 
 /**
- * Process FFT bins to implement the phase vocoder algorithm.
+ * Analyses frames `hop` input samples apart and queues HOP_SIZE output
+ * samples per frame (see phase_vocoder_push()). The first frame of a call
+ * completes the hop chosen by the previous call.
  *
- * This function processes the FFT bins by shifting the phase of each bin
- * according to the pitch factor. The phase vocoder algorithm is implemented
- * using the following steps: 1) Calculate the phase difference between the
- * current bin and the previous one; 2) Subtract 2*pi from the phase difference
- * to unwrap it; 3) Add the phase difference to the phase accumulator; 4)
- * Calculate the new phase using the phase accumulator; 5) Update the real and
- * imaginary parts of the FFT bin using the new phase.
- *
- * @param fft_out The FFT bins to be processed.
- * @param prev_phase The previous phase of each bin.
- * @param phase_accum The phase accumulator.
- * @param pitch_factor The pitch factor.
+ * @return The number of samples accepted.
  */
-void process_fft_bins(fftwf_complex* fft_out, float* prev_phase, 
-                     float* phase_accum, float pitch_factor) {
-    const size_t bins = FRAME_SIZE / 2 + 1;
-    const float two_pi = 2 * M_PI;
-    
-    #pragma omp parallel for
-    for (size_t k = 0; k < bins; k++) {
-        float real = crealf(fft_out[k]);
-        float imag = cimagf(fft_out[k]);
-        float mag = sqrtf(real * real + imag * imag);
-        float phase = atan2f(imag, real);
-        
-        float phase_diff = phase - prev_phase[k];
-        prev_phase[k] = phase;
-        
-        phase_diff -= two_pi * roundf(phase_diff / two_pi);
-        phase_accum[k] += phase_diff * pitch_factor;
-        
-        float new_phase = phase_accum[k];
-        fft_out[k] = mag * (cosf(new_phase) + I * sinf(new_phase));
+static size_t push_frames(PhaseVocoder* pv, const float* input, size_t length, float pitch_factor,
+                          size_t hop) {
+    const size_t overlap = FRAME_SIZE - hop;
+    size_t done = 0;
+
+    while (done < length) {
+        size_t need = FRAME_SIZE - pv->in_fill;  // Samples that complete the next frame
+
+        if (length - done < need) {
+            // Not enough for a frame: just buffer the input
+            size_t chunk = length - done;
+            memcpy(pv->in_fifo + pv->in_fill, input + done, chunk * sizeof(float));
+            pv->in_fill += chunk;
+            done += chunk;
+            break;
+        }
+
+        size_t frames = 1 + (length - done - need) / hop;
+        size_t room = circular_buffer_space(pv->out_queue) / HOP_SIZE;
+        if (frames > MAX_BATCH_FRAMES) frames = MAX_BATCH_FRAMES;
+        if (frames > room) frames = room;
+        if (frames == 0) break;
+        size_t take = need + (frames - 1) * hop;
+
+        // Lay the buffered and new input out linearly
+        memcpy(pv->stage, pv->in_fifo, pv->in_fill * sizeof(float));
+        memcpy(pv->stage + pv->in_fill, input + done, take * sizeof(float));
+        pv->batch_hop = hop;
+
+        run_frames(pv, analyse_frame, frames);
+        for (size_t j = 0; j < frames; j++) {
+            pv->pitch = pv->pitch > 0.0f ? pv->pitch + (pitch_factor - pv->pitch) * PV_PITCH_GLIDE
+                                         : pitch_factor;
+            shift_pitch_polar(pv->mags[j], pv->phases[j], pv->prev_phase, pv->phase_accum,
+                              pv->bin_work, pv->pitch, j == 0 ? pv->analysis_hop : hop);
+        }
+        run_frames(pv, synthesise_frame, frames);
+
+        for (size_t j = 0; j < frames; j++) {
+            const float* frame = pv->frames[j];
+            for (size_t i = 0; i < FRAME_SIZE; i++) {
+                pv->overlap_buffer[i] += frame[i];
+            }
+
+            // Release one hop of finished output and slide the overlap
+            const size_t tail = FRAME_SIZE - HOP_SIZE;
+            circular_buffer_write(pv->out_queue, pv->overlap_buffer, HOP_SIZE);
+            memmove(pv->overlap_buffer, pv->overlap_buffer + HOP_SIZE, tail * sizeof(float));
+            memset(pv->overlap_buffer + tail, 0, HOP_SIZE * sizeof(float));
+        }
+
+        memcpy(pv->in_fifo, pv->stage + frames * hop, overlap * sizeof(float));
+        pv->in_fill = overlap;
+        pv->analysis_hop = hop;
+        done += take;
     }
+
+    return done;
+}
+
+/**
+ * Feeds input to the phase vocoder.
+ *
+ * This is a streaming short-time Fourier transform: input may arrive in
+ * chunks of any length and the analysis, phase and overlap-add state is kept
+ * between calls. Frames are analysed speed_factor * HOP_SIZE input samples
+ * apart and synthesised HOP_SIZE apart, so every frame queues HOP_SIZE
+ * output samples and the output runs 1 / speed_factor times as long as the
+ * input. The frames completed by a call are handled in batches: 1) window,
+ * FFT and polar conversion of every frame (in parallel when the worker pool
+ * pays off); 2) pitch shift of every frame in order with
+ * shift_pitch_polar(); 3) cartesian conversion, IFFT and synthesis window
+ * of every frame (in parallel); 4) overlap-add, normalised so that the
+ * squared windows sum to unity, queueing HOP_SIZE finished samples per
+ * frame for phase_vocoder_pull().
+ *
+ * Input that would overflow the output queue is not accepted, so a caller
+ * that stops pulling sees back-pressure instead of lost samples. Offline
+ * callers can stretch without limit this way; live callers should use
+ * phase_vocoder_process(), which bounds the backlog.
+ *
+ * @param pv The instance.
+ * @param input The input samples.
+ * @param length The number of input samples.
+ * @param pitch_factor The pitch factor the frames completed by this call
+ *                     glide towards (PV_PITCH_GLIDE per frame).
+ * @param speed_factor The playback speed (PV_MIN_SPEED - PV_MAX_SPEED).
+ * @return The number of samples accepted (less than length when the output
+ *         queue is full).
+ */
+size_t phase_vocoder_push(PhaseVocoder* pv, const float* input, size_t length, float pitch_factor,
+                          float speed_factor) {
+    if (!pv || !input || pitch_factor <= 0 || speed_factor <= 0) return 0;
+    return push_frames(pv, input, length, pitch_factor, analysis_hop_for(speed_factor));
 }
 
 /**
- * Applies the phase vocoder algorithm to the input signal.
+ * Takes finished output from the phase vocoder.
  *
- * This function applies the phase vocoder algorithm to the input signal and
- * stores the result in the output buffer. The phase vocoder algorithm is
- * implemented using the following steps: 1) Split the input signal into frames
- * of length FRAME_SIZE; 2) Apply a window function to each frame; 3)
- * Calculate the FFT of each frame; 4) Process each FFT bin by shifting the
- * phase of each bin according to the pitch factor; 5) Calculate the IFFT of
- * each processed frame; 6) Store the result in the output buffer.
+ * @param pv The instance.
+ * @param output The buffer for the output samples.
+ * @param length The maximum number of samples to take.
+ * @return The number of samples written to output.
+ */
+size_t phase_vocoder_pull(PhaseVocoder* pv, float* output, size_t length) {
+    if (!pv || !output) return 0;
+
+    size_t available = circular_buffer_available(pv->out_queue);
+    if (length > available) length = available;
+    if (length > 0) {
+        circular_buffer_read(pv->out_queue, output, length);
+    }
+    return length;
+}
+
+/**
+ * @param pv The instance.
+ * @return The number of finished samples waiting to be pulled.
+ */
+size_t phase_vocoder_available(PhaseVocoder* pv) {
+    return circular_buffer_available(pv->out_queue);
+}
+
+/**
+ * Runs enough frames from the backlog to make length output samples
+ * available, choosing the analysis hop so that the stream stays live.
  *
+ * The requested hop is lowered when the backlog cannot supply it, both for
+ * this block and for the first frame of the next one (speeding up can only
+ * consume input that has already arrived), and raised to HOP_SIZE once the
+ * backlog passes PV_STRETCH_MAX_BACKLOG (slowing down stops adding
+ * latency). Whatever backlog remains at speed >= 1 is played off at
+ * PV_STRETCH_CATCHUP until the latency is back to its minimum.
+ */
+static void stretch_block(PhaseVocoder* pv, const float* input, size_t length, float pitch_factor,
+                          size_t requested) {
+    // At most PV_STRETCH_MAX_BACKLOG plus one block is ever buffered, so this
+    // only drops input for blocks larger than the headroom
+    size_t space = circular_buffer_space(pv->backlog);
+    circular_buffer_write(pv->backlog, input, length < space ? length : space);
+
+    size_t queued = circular_buffer_available(pv->out_queue);
+    size_t frames = queued < length ? (length - queued + HOP_SIZE - 1) / HOP_SIZE : 0;
+    size_t backlog = circular_buffer_available(pv->backlog);
+    size_t need = FRAME_SIZE - pv->in_fill;
+
+    size_t hop = requested;
+    const size_t catchup = analysis_hop_for(PV_STRETCH_CATCHUP);
+    if (hop >= HOP_SIZE && hop < catchup) hop = catchup;
+    if (hop < HOP_SIZE && backlog > PV_STRETCH_MAX_BACKLOG) hop = HOP_SIZE;
+    if (backlog >= need && frames > 0) {
+        size_t spare = backlog - need;
+        if (frames > 1 && hop > spare / (frames - 1)) hop = spare / (frames - 1);
+        if (hop > (spare + length) / frames) hop = (spare + length) / frames;
+    }
+    if (hop < 1) hop = 1;
+    if (hop != requested && !(requested >= HOP_SIZE && hop >= requested)) {
+        pv->stretch_limited++;
+    }
+
+    while (frames > 0 && backlog >= need) {
+        size_t batch = frames < MAX_BATCH_FRAMES ? frames : MAX_BATCH_FRAMES;
+        size_t room = circular_buffer_space(pv->out_queue) / HOP_SIZE;
+        if (batch > room) batch = room;
+        if (batch > 1 + (backlog - need) / hop) batch = 1 + (backlog - need) / hop;
+        if (batch == 0) break;
+
+        size_t take = need + (batch - 1) * hop;
+        circular_buffer_read(pv->backlog, pv->stretch_in, take);
+        push_frames(pv, pv->stretch_in, take, pitch_factor, hop);
+
+        backlog -= take;
+        frames -= batch;
+        need = hop;
+    }
+
+    if (backlog > pv->backlog_peak) pv->backlog_peak = backlog;
+}
+
+/**
+ * Applies the phase vocoder to one block: consumes length input samples and
+ * produces length output samples.
+ *
+ * At speed 1 the input is pushed straight through. Any other speed consumes
+ * input faster or slower than it arrives, so the input goes through a
+ * bounded backlog instead (see stretch_block()): slowing down adds latency
+ * up to PV_STRETCH_MAX_BACKLOG samples, and speeding up plays it off again.
+ * phase_vocoder_backlog() reports the extra latency at any time.
+ *
+ * Input and output may be the same buffer. With the block size given to
+ * phase_vocoder_create() the output never runs short at speed 1; if it does
+ * the shortfall is filled with silence and counted in pv->underruns.
+ *
+ * @param pv The instance.
  * @param input The input signal to be processed.
  * @param output The output buffer in which to store the result.
  * @param length The length of the input signal and output buffer.
  * @param pitch_factor The pitch factor.
+ * @param speed_factor The playback speed (PV_MIN_SPEED - PV_MAX_SPEED).
  *
  * @return 0 on success, -1 on failure.
  */
-int phase_vocoder(const float *input, float *output, size_t length, float pitch_factor) {
-    if (input == NULL || output == NULL || length == 0 || pitch_factor <= 0) {
+int phase_vocoder_process(PhaseVocoder* pv, const float* input, float* output, size_t length, float pitch_factor,
+                          float speed_factor) {
+    if (pv == NULL || input == NULL || output == NULL || length == 0 || pitch_factor <= 0 ||
+        speed_factor <= 0) {
         return -1;
     }
 
-    float *window = get_window();
-    if (!window) return -1;
-
-    static fftwf_plan forward_plan = NULL;
-    static fftwf_plan inverse_plan = NULL;
-    static fftwf_complex *fft_in = NULL;
-    static fftwf_complex *fft_out = NULL;
-    
-    if (!forward_plan) {
-        fftwf_init_threads();
-        fftwf_plan_with_nthreads(omp_get_max_threads());
-        
-        fft_in = fftwf_malloc(sizeof(fftwf_complex) * FRAME_SIZE);
-        fft_out = fftwf_malloc(sizeof(fftwf_complex) * FRAME_SIZE);
-        forward_plan = fftwf_plan_dft_r2c_1d(FRAME_SIZE, (float *)fft_in, fft_out, FFTW_MEASURE);
-        inverse_plan = fftwf_plan_dft_c2r_1d(FRAME_SIZE, fft_out, (float *)fft_in, FFTW_MEASURE);
-    }
+    size_t hop = analysis_hop_for(speed_factor);
+    size_t pulled = 0;
 
-    static float *prev_phase = NULL;
-    static float *phase_accum = NULL;
-    
-    if (!prev_phase) {
-        prev_phase = calloc(FRAME_SIZE / 2 + 1, sizeof(float));
-        phase_accum = calloc(FRAME_SIZE / 2 + 1, sizeof(float));
-    }
+    if (hop == HOP_SIZE && pv->analysis_hop == HOP_SIZE && circular_buffer_available(pv->backlog) == 0) {
+        size_t pushed = 0;
+        while (pushed < length) {
+            size_t accepted = push_frames(pv, input + pushed, length - pushed, pitch_factor, HOP_SIZE);
+            pushed += accepted;
 
-    // Clear output and process frame
-    memset(output, 0, sizeof(float) * length);
-    
-    // Single frame processing without overlap
-    memcpy((float *)fft_in, input, FRAME_SIZE * sizeof(float));
-    
-    // Apply window
-    for (size_t i = 0; i < FRAME_SIZE; i++) {
-        ((float *)fft_in)[i] *= window[i];
-    }
-
-    fftwf_execute(forward_plan);
-    
-    // Simple phase processing
-    const size_t bins = FRAME_SIZE / 2 + 1;
-    for (size_t k = 0; k < bins; k++) {
-        float real = crealf(fft_out[k]);
-        float imag = cimagf(fft_out[k]);
-        float mag = sqrtf(real * real + imag * imag);
-        float phase = atan2f(imag, real);
-        
-        // Simple phase modification
-        phase *= pitch_factor;
-        
-        // Reconstruct bin
-        fft_out[k] = mag * (cosf(phase) + I * sinf(phase));
+            // Make room in the output queue; in-place callers never overwrite
+            // input that has not been pushed yet because pulled <= pushed
+            size_t ready = pushed - pulled;
+            pulled += phase_vocoder_pull(pv, output + pulled, ready);
+            if (accepted == 0 && ready == 0) return -1;
+        }
+    } else {
+        stretch_block(pv, input, length, pitch_factor, hop);
     }
-    
-    fftwf_execute(inverse_plan);
+    pulled += phase_vocoder_pull(pv, output + pulled, length - pulled);
 
-    float norm = 1.0f / FRAME_SIZE;
-    for (size_t i = 0; i < FRAME_SIZE; i++) {
-        output[i] = ((float *)fft_in)[i] * norm;
+    if (pulled < length) {
+        memset(output + pulled, 0, (length - pulled) * sizeof(float));
+        pv->underruns++;
     }
-
     return 0;
 }
 
 /**
- * Cleans up resources used by the phase vocoder.
- *
- * This function releases all resources and memory allocated for the phase 
- * vocoder, including FFT plans, input/output buffers, and phase arrays. 
- * It destroys the FFTW plans, frees the allocated memory for FFT input/output, 
- * and phase tracking arrays. Additionally, it frees the overlap buffer if it 
- * was allocated, and calls `fftwf_cleanup_threads` to clean up FFTW threading 
- * resources. This function should be called when the phase vocoder is no longer 
- * needed to prevent memory leaks.
+ * Returns the fixed delay between input and output in samples: one frame
+ * minus one hop for the overlap-add, plus the priming chosen at creation.
+ * Live time stretching adds phase_vocoder_backlog() on top.
+ *
+ * @param pv The instance.
+ * @return The latency in samples.
  */
-void cleanup_phase_vocoder() {
-    static fftwf_plan forward_plan = NULL;
-    static fftwf_plan inverse_plan = NULL;
-    static fftwf_complex *fft_in = NULL;
-    static fftwf_complex *fft_out = NULL;
-    static float *prev_phase = NULL;
-    static float *phase_accum = NULL;
-
-    if (forward_plan) {
-        fftwf_destroy_plan(forward_plan);
-        fftwf_destroy_plan(inverse_plan);
-        fftwf_free(fft_in);
-        fftwf_free(fft_out);
-        free(prev_phase);
-        free(phase_accum);
-        forward_plan = NULL;
-    }
-
-    if (overlap_buffer) {
-        free(overlap_buffer);
-        overlap_buffer = NULL;
-    }
+size_t phase_vocoder_latency(PhaseVocoder* pv) {
+    return FRAME_SIZE - HOP_SIZE + pv->priming;
+}
 
-    fftwf_cleanup_threads();
-}
\ No newline at end of file
+/**
+ * @param pv The instance.
+ * @return Input samples waiting to be time-stretched, i.e. the latency that
+ *         live time stretching currently adds.
+ */
+size_t phase_vocoder_backlog(PhaseVocoder* pv) {
+    return circular_buffer_available(pv->backlog);
+}
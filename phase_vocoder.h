@@ -1,11 +1,17 @@
+#ifndef PHASE_VOCODER_H
+#define PHASE_VOCODER_H
+
 #include <math.h>
 #include <complex.h>
 #include <fftw3.h> 
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
-#include <omp.h>
 #include <pthread.h>
+#include "circular_buffer.h"
+#include "spectral_kernels.h"
+#include "dsp_pool.h"
+#include "dsp_arena.h"
 
 #ifndef NOISE_FLOOR
 #define NOISE_FLOOR 0.001f
@@ -20,21 +26,115 @@
 #define RMS_SMOOTH_FACTOR 0.01f
 #endif
 
+#ifndef FRAME_SIZE
 #define FRAME_SIZE 1024  // Reduced from 2048 for lower latency
+#endif
+#ifndef OVERLAP_RATIO
 #define OVERLAP_RATIO 4
+#endif
 #define HOP_SIZE (FRAME_SIZE / OVERLAP_RATIO)
+#define NUM_BINS (FRAME_SIZE / 2 + 1)
 #define BUFFER_SIZE (FRAME_SIZE * 8)
 
+// How hard FFTW searches for a fast plan. Wisdom makes repeat planning at the
+// same or a lower rigor close to free.
+typedef enum {
+    FFT_RIGOR_ESTIMATE = 0,  // Heuristic plan, no measurement (instant)
+    FFT_RIGOR_MEASURE,       // Times a few candidate algorithms (default)
+    FFT_RIGOR_PATIENT        // Times many more; slow the first time, best plans
+} FftRigor;
+
+// Frames analysed or synthesised together. Frames within a batch are
+// independent apart from the phase propagation, so the transforms can be
+// spread over a worker pool.
+#define MAX_BATCH_FRAMES (2 * OVERLAP_RATIO)
+
+// Time stretching: frames are analysed speed_factor * HOP_SIZE apart and
+// always synthesised HOP_SIZE apart
+#define PV_MIN_SPEED 0.5f
+#define PV_MAX_SPEED 2.0f
+#define PV_MAX_ANALYSIS_HOP (2 * HOP_SIZE)
+#define PV_STRETCH_CATCHUP 1.25f   // Live speed while a backlog is left over at speed >= 1
+
+// Share of a pitch change applied per frame: a new pitch_factor is reached
+// in a few hops instead of as a step between two frames
+#define PV_PITCH_GLIDE 0.25f
+
+// Live input waiting to be stretched. Slowing down is refused once the
+// backlog reaches PV_STRETCH_MAX_BACKLOG, which bounds the added latency.
+#define PV_STRETCH_BACKLOG_SIZE (32 * FRAME_SIZE)
+#define PV_STRETCH_MAX_BACKLOG (PV_STRETCH_BACKLOG_SIZE - 8 * FRAME_SIZE)
+
+#define STAGE_SIZE (FRAME_SIZE + (MAX_BATCH_FRAMES - 1) * PV_MAX_ANALYSIS_HOP)
+#define OUT_QUEUE_SIZE (2 * FRAME_SIZE + MAX_BATCH_FRAMES * HOP_SIZE)
+
+// One independent phase vocoder stream. Every buffer and plan is owned by
+// the instance, so any number of streams can run in one process (each from
+// one thread at a time).
 typedef struct {
-    float* buffer;
-    size_t size;
-    size_t read_pos;
-    size_t write_pos;
-    pthread_mutex_t lock;
-} CircularBuffer;
-
-int phase_vocoder(const float* input, float* output, size_t length, float pitch_factor);
-CircularBuffer* create_circular_buffer(size_t size);
-int circular_buffer_write(CircularBuffer* cb, float* data, size_t length);
-int circular_buffer_read(CircularBuffer* cb, float* data, size_t length);
-void cleanup_phase_vocoder();
\ No newline at end of file
+    DspArena* arena;                // Owner of the struct and its buffers (NULL = heap)
+
+    // FFT plans and per-frame work buffers (DSP_ARENA_ALIGN aligned)
+    fftwf_plan forward_plan;
+    fftwf_plan inverse_plan;
+    float* window;                  // Analysis window
+    float* synthesis_window;        // Window scaled by the overlap-add gain
+    float* stage;                   // Linear input; frame j starts at j * batch_hop
+    float* frames[MAX_BATCH_FRAMES];
+    fftwf_complex* spectra[MAX_BATCH_FRAMES];
+    float* mags[MAX_BATCH_FRAMES];
+    float* phases[MAX_BATCH_FRAMES];
+
+    // Streaming state
+    float* prev_phase;              // Analysis phase of each bin, previous frame
+    float* phase_accum;             // Synthesis phase of each bin
+    float* bin_work;                // Scratch for the pitch shift
+    float* in_fifo;                 // Input not yet covered by a full frame
+    size_t in_fill;                 // Samples in in_fifo
+    size_t analysis_hop;            // Input advance from the last frame to the next one
+    size_t batch_hop;               // Input advance between frames of the current batch
+    float pitch;                    // Pitch factor of the last frame (0 = none yet)
+    float* overlap_buffer;          // Overlap-add accumulator
+    CircularBuffer* out_queue;      // Finished output waiting to be pulled
+    size_t priming;                 // Zeros queued at creation (see phase_vocoder_create)
+    unsigned long underruns;        // phase_vocoder_process calls that ran short
+
+    // Live time stretching (phase_vocoder_process with speed_factor != 1)
+    CircularBuffer* backlog;        // Input not yet analysed
+    float* stretch_in;              // One batch of input taken from the backlog
+    size_t backlog_peak;            // Largest backlog seen (samples)
+    unsigned long stretch_limited;  // Blocks that could not run at the requested speed
+
+    DspPool* pool;
+    size_t parallel_min_frames;     // 0 = never use the pool
+} PhaseVocoder;
+
+int fft_planner_configure(FftRigor rigor, const char* wisdom_path);
+unsigned fft_planner_flags(void);
+void fft_planner_lock(void);
+void fft_planner_unlock(void);
+double fft_planner_seconds(void);
+int fft_planner_save_wisdom(void);
+const char* fft_rigor_name(FftRigor rigor);
+int fft_rigor_parse(const char* name, FftRigor* rigor);
+fftwf_plan fft_plan_r2c(int n, float* in, fftwf_complex* out);
+fftwf_plan fft_plan_c2r(int n, fftwf_complex* in, float* out);
+void fft_plan_destroy(fftwf_plan plan);
+
+PhaseVocoder* phase_vocoder_create(size_t block_size, DspArena* arena);
+void phase_vocoder_destroy(PhaseVocoder* pv);
+size_t phase_vocoder_push(PhaseVocoder* pv, const float* input, size_t length, float pitch_factor,
+                          float speed_factor);
+size_t phase_vocoder_pull(PhaseVocoder* pv, float* output, size_t length);
+size_t phase_vocoder_available(PhaseVocoder* pv);
+int phase_vocoder_process(PhaseVocoder* pv, const float* input, float* output, size_t length, float pitch_factor,
+                          float speed_factor);
+size_t phase_vocoder_latency(PhaseVocoder* pv);
+size_t phase_vocoder_backlog(PhaseVocoder* pv);
+void phase_vocoder_reset(PhaseVocoder* pv);
+size_t phase_vocoder_set_pool(PhaseVocoder* pv, DspPool* pool);
+void process_fft_bins(fftwf_complex* fft_out, float* prev_phase,
+                     float* phase_accum, float* work, float pitch_factor);
+void apply_window_simd(float* input, float* window, size_t length);
+
+#endif
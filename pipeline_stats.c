@@ -0,0 +1,227 @@
+#include "pipeline_stats.h"
+#include <stdio.h>
+
+static const char* stage_names[STAGE_COUNT] = {
+    "capture", "pitch", "effects", "playback", "end-to-end"
+};
+
+/**
+ * @param stage The stage.
+ * @return Its name in reports.
+ */
+const char* pipeline_stage_name(PipelineStage stage) {
+    return stage < STAGE_COUNT ? stage_names[stage] : "unknown";
+}
+
+/**
+ * Empties a histogram. Call before its writer starts.
+ *
+ * @param hist The histogram.
+ */
+void latency_histogram_reset(LatencyHistogram* hist) {
+    for (size_t i = 0; i < LATENCY_BUCKETS; i++) {
+        atomic_init(&hist->buckets[i], 0);
+    }
+    atomic_init(&hist->count, 0);
+    atomic_init(&hist->total_ns, 0);
+    atomic_init(&hist->max_ns, 0);
+}
+
+/**
+ * Zeroes every counter. Call before the threads that update them start.
+ *
+ * @param stats The counters.
+ */
+void pipeline_stats_reset(PipelineStats* stats) {
+    for (int s = 0; s < STAGE_COUNT; s++) {
+        latency_histogram_reset(&stats->stages[s]);
+    }
+    atomic_init(&stats->blocks, 0);
+    atomic_init(&stats->busy_ns, 0);
+    atomic_init(&stats->audio_ns, 0);
+    atomic_init(&stats->peak_load_ppm, 0);
+    atomic_init(&stats->dsp_overloads, 0);
+    atomic_init(&stats->input_overflows, 0);
+    atomic_init(&stats->output_underflows, 0);
+    atomic_init(&stats->ring_overruns, 0);
+    atomic_init(&stats->vocoder_underruns, 0);
+}
+
+static size_t bucket_index(uint64_t ns) {
+    uint64_t us = ns / 1000;
+    if (us < LATENCY_SUB_BUCKETS) return (size_t)us;
+
+    unsigned octave = 63 - (unsigned)__builtin_clzll(us);  // >= 3
+    size_t sub = (size_t)(us >> (octave - 3)) & (LATENCY_SUB_BUCKETS - 1);
+    size_t index = (octave - 2) * LATENCY_SUB_BUCKETS + sub;
+    return index < LATENCY_BUCKETS ? index : LATENCY_BUCKETS - 1;
+}
+
+// Upper edge of a bucket in nanoseconds
+static uint64_t bucket_limit(size_t index) {
+    if (index < LATENCY_SUB_BUCKETS) return (uint64_t)(index + 1) * 1000;
+
+    unsigned octave = (unsigned)(index / LATENCY_SUB_BUCKETS) + 2;
+    uint64_t sub = index % LATENCY_SUB_BUCKETS;
+    return ((LATENCY_SUB_BUCKETS + sub + 1) << (octave - 3)) * 1000;
+}
+
+/**
+ * Adds one measurement. Only the histogram's writer thread may call this;
+ * it never blocks.
+ *
+ * @param hist The histogram.
+ * @param ns The measured time in nanoseconds.
+ */
+void latency_histogram_record(LatencyHistogram* hist, uint64_t ns) {
+    atomic_fetch_add_explicit(&hist->buckets[bucket_index(ns)], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&hist->total_ns, ns, memory_order_relaxed);
+    if (ns > atomic_load_explicit(&hist->max_ns, memory_order_relaxed)) {
+        atomic_store_explicit(&hist->max_ns, ns, memory_order_relaxed);
+    }
+    atomic_fetch_add_explicit(&hist->count, 1, memory_order_relaxed);
+}
+
+/**
+ * Returns an arbitrary percentile, such as the 99.9th that a target miss
+ * rate of 1 in 1000 asks about.
+ *
+ * @param hist The histogram (may be updated concurrently).
+ * @param quantile Fraction of the measurements at or below the result (0 - 1).
+ * @return The upper edge of the bucket that holds it, capped at the maximum
+ *         (seconds); 0 if nothing was recorded.
+ */
+double latency_histogram_quantile(const LatencyHistogram* hist, double quantile) {
+    unsigned long counts[LATENCY_BUCKETS];
+    unsigned long count = 0;
+    for (size_t i = 0; i < LATENCY_BUCKETS; i++) {
+        counts[i] = atomic_load_explicit(&hist->buckets[i], memory_order_relaxed);
+        count += counts[i];
+    }
+    if (count == 0) return 0.0;
+    uint64_t max_ns = atomic_load_explicit(&hist->max_ns, memory_order_relaxed);
+
+    unsigned long rank = (unsigned long)(quantile * count + 0.999999);
+    if (rank == 0) rank = 1;
+    unsigned long seen = 0;
+    for (size_t i = 0; i < LATENCY_BUCKETS; i++) {
+        seen += counts[i];
+        if (seen >= rank) {
+            uint64_t limit = bucket_limit(i);
+            return (double)(limit < max_ns ? limit : max_ns) * 1e-9;
+        }
+    }
+    return (double)max_ns * 1e-9;
+}
+
+/**
+ * Summarises a histogram. Percentiles are the upper edge of the bucket that
+ * holds them (at most 12.5% high), capped at the maximum.
+ *
+ * @param hist The histogram (may be updated concurrently).
+ * @param summary Receives the summary; all zero if nothing was recorded.
+ */
+void latency_histogram_summarize(const LatencyHistogram* hist, LatencySummary* summary) {
+    unsigned long counts[LATENCY_BUCKETS];
+    unsigned long count = 0;
+    for (size_t i = 0; i < LATENCY_BUCKETS; i++) {
+        counts[i] = atomic_load_explicit(&hist->buckets[i], memory_order_relaxed);
+        count += counts[i];
+    }
+    uint64_t max_ns = atomic_load_explicit(&hist->max_ns, memory_order_relaxed);
+    uint64_t total_ns = atomic_load_explicit(&hist->total_ns, memory_order_relaxed);
+
+    summary->count = count;
+    summary->mean = count > 0 ? (double)total_ns * 1e-9 / count : 0.0;
+    summary->max = (double)max_ns * 1e-9;
+    summary->p50 = 0.0;
+    summary->p99 = 0.0;
+    if (count == 0) return;
+
+    unsigned long p50_rank = (count + 1) / 2;
+    unsigned long p99_rank = count - count / 100;
+    unsigned long seen = 0;
+    int have_p50 = 0;
+    for (size_t i = 0; i < LATENCY_BUCKETS; i++) {
+        seen += counts[i];
+        uint64_t limit = bucket_limit(i);
+        if (limit > max_ns) limit = max_ns;
+        if (!have_p50 && seen >= p50_rank) {
+            summary->p50 = (double)limit * 1e-9;
+            have_p50 = 1;
+        }
+        if (seen >= p99_rank) {
+            summary->p99 = (double)limit * 1e-9;
+            break;
+        }
+    }
+}
+
+/**
+ * Accounts one block that went through the DSP chain.
+ *
+ * @param stats The counters.
+ * @param busy_ns Time the DSP chain took for the block.
+ * @param length Samples in the block.
+ * @param sample_rate The sample rate in Hz.
+ */
+void pipeline_stats_record_block(PipelineStats* stats, uint64_t busy_ns, size_t length, size_t sample_rate) {
+    uint64_t audio_ns = (uint64_t)length * 1000000000u / sample_rate;
+    stats_count(&stats->blocks, 1);
+    stats_count(&stats->busy_ns, busy_ns);
+    stats_count(&stats->audio_ns, audio_ns);
+    if (busy_ns > audio_ns) {
+        stats_count(&stats->dsp_overloads, 1);
+    }
+
+    unsigned long load_ppm = audio_ns > 0 ? (unsigned long)(busy_ns * 1000000u / audio_ns) : 0;
+    if (load_ppm > atomic_load_explicit(&stats->peak_load_ppm, memory_order_relaxed)) {
+        atomic_store_explicit(&stats->peak_load_ppm, load_ppm, memory_order_relaxed);
+    }
+}
+
+/**
+ * Takes a snapshot of the counters. Safe to call from any thread while the
+ * pipeline runs.
+ *
+ * @param stats The counters.
+ * @param report Receives the snapshot.
+ */
+void pipeline_stats_report(const PipelineStats* stats, PipelineStatsReport* report) {
+    for (int s = 0; s < STAGE_COUNT; s++) {
+        latency_histogram_summarize(&stats->stages[s], &report->stages[s]);
+    }
+    report->blocks = atomic_load_explicit(&stats->blocks, memory_order_relaxed);
+    report->busy_seconds = atomic_load_explicit(&stats->busy_ns, memory_order_relaxed) * 1e-9;
+    report->audio_seconds = atomic_load_explicit(&stats->audio_ns, memory_order_relaxed) * 1e-9;
+    report->load = report->audio_seconds > 0 ? report->busy_seconds / report->audio_seconds : 0.0;
+    report->peak_load = atomic_load_explicit(&stats->peak_load_ppm, memory_order_relaxed) * 1e-6;
+    report->dsp_overloads = atomic_load_explicit(&stats->dsp_overloads, memory_order_relaxed);
+    report->input_overflows = atomic_load_explicit(&stats->input_overflows, memory_order_relaxed);
+    report->output_underflows = atomic_load_explicit(&stats->output_underflows, memory_order_relaxed);
+    report->ring_overruns = atomic_load_explicit(&stats->ring_overruns, memory_order_relaxed);
+    report->vocoder_underruns = atomic_load_explicit(&stats->vocoder_underruns, memory_order_relaxed);
+    report->xruns = report->input_overflows + report->output_underflows + report->ring_overruns;
+}
+
+/**
+ * Prints a report: one line per stage that saw any blocks, then the load
+ * and error counters.
+ *
+ * @param report The report.
+ * @param label Prefix for every line.
+ */
+void pipeline_stats_print(const PipelineStatsReport* report, const char* label) {
+    for (int s = 0; s < STAGE_COUNT; s++) {
+        const LatencySummary* stage = &report->stages[s];
+        if (stage->count == 0) continue;
+        printf("%s: %-10s p50 %8.3f ms  p99 %8.3f ms  max %8.3f ms  (%lu blocks)\n",
+               label, pipeline_stage_name((PipelineStage)s), stage->p50 * 1000.0,
+               stage->p99 * 1000.0, stage->max * 1000.0, stage->count);
+    }
+    printf("%s: DSP load %.1f%% (peak %.1f%%), %lu overloaded blocks, xruns %lu "
+           "(input %lu, output %lu, ring %lu), vocoder underruns %lu\n",
+           label, report->load * 100.0, report->peak_load * 100.0, report->dsp_overloads,
+           report->xruns, report->input_overflows, report->output_underflows,
+           report->ring_overruns, report->vocoder_underruns);
+}
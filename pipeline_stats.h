@@ -0,0 +1,95 @@
+#ifndef PIPELINE_STATS_H
+#define PIPELINE_STATS_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+
+// Latency buckets are 1 us wide below 8 us, then 8 per octave (12.5%
+// resolution) up to about 16 s
+#define LATENCY_SUB_BUCKETS 8
+#define LATENCY_BUCKETS (LATENCY_SUB_BUCKETS * 22)
+
+typedef enum {
+    STAGE_CAPTURE = 0,  // Reading one block from the input device (threaded mode)
+    STAGE_PITCH,        // Pitch shifter (phase vocoder or WSOLA)
+    STAGE_EFFECTS,      // Noise gate, echo, reverb, gain and limiter
+    STAGE_PLAYBACK,     // Writing one block to the output device (threaded mode)
+    STAGE_END_TO_END,   // Threaded: block captured -> written to the device; duplex: ADC -> DAC
+    STAGE_COUNT
+} PipelineStage;
+
+// Lock-free latency histogram. Every histogram has a single writer (the
+// thread that runs the stage); any thread may read it at any time and gets
+// counts that are at most a few samples apart.
+typedef struct {
+    atomic_ulong buckets[LATENCY_BUCKETS];
+    atomic_ulong count;
+    atomic_ulong total_ns;
+    atomic_ulong max_ns;
+} LatencyHistogram;
+
+typedef struct {
+    unsigned long count;
+    double mean;              // Seconds
+    double p50;
+    double p99;
+    double max;
+} LatencySummary;
+
+// Timing and error counters of one pipeline. The audio threads only do
+// relaxed atomic adds, so instrumentation never blocks them.
+typedef struct {
+    LatencyHistogram stages[STAGE_COUNT];
+    atomic_ulong blocks;             // Blocks through the DSP chain
+    atomic_ulong busy_ns;            // Time spent in the DSP chain
+    atomic_ulong audio_ns;           // Duration of the audio those blocks hold
+    atomic_ulong peak_load_ppm;      // Worst DSP time / block duration (parts per million)
+    atomic_ulong dsp_overloads;      // Blocks whose DSP took longer than the block lasts
+    atomic_ulong input_overflows;    // Input lost by the device (xrun)
+    atomic_ulong output_underflows;  // Device ran out of output (xrun)
+    atomic_ulong ring_overruns;      // Captured blocks dropped because processing fell behind
+    atomic_ulong vocoder_underruns;  // Blocks the phase vocoder could not fill completely
+} PipelineStats;
+
+// Plain copy of the counters with every histogram summarised
+typedef struct {
+    LatencySummary stages[STAGE_COUNT];
+    unsigned long blocks;
+    double busy_seconds;
+    double audio_seconds;
+    double load;                     // Average DSP load since the start (1.0 = all of realtime)
+    double peak_load;
+    unsigned long dsp_overloads;
+    unsigned long input_overflows;
+    unsigned long output_underflows;
+    unsigned long ring_overruns;
+    unsigned long vocoder_underruns;
+    unsigned long xruns;             // input_overflows + output_underflows + ring_overruns
+} PipelineStatsReport;
+
+/**
+ * @return CLOCK_MONOTONIC in nanoseconds.
+ */
+static inline uint64_t stats_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static inline void stats_count(atomic_ulong* counter, unsigned long n) {
+    atomic_fetch_add_explicit(counter, n, memory_order_relaxed);
+}
+
+void pipeline_stats_reset(PipelineStats* stats);
+void latency_histogram_reset(LatencyHistogram* hist);
+void latency_histogram_record(LatencyHistogram* hist, uint64_t ns);
+void latency_histogram_summarize(const LatencyHistogram* hist, LatencySummary* summary);
+double latency_histogram_quantile(const LatencyHistogram* hist, double quantile);
+void pipeline_stats_record_block(PipelineStats* stats, uint64_t busy_ns, size_t length, size_t sample_rate);
+void pipeline_stats_report(const PipelineStats* stats, PipelineStatsReport* report);
+void pipeline_stats_print(const PipelineStatsReport* report, const char* label);
+const char* pipeline_stage_name(PipelineStage stage);
+
+#endif
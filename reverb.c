@@ -0,0 +1,481 @@
+#include "reverb.h"
+#include "wav_io.h"
+
+// Impulse responses already loaded, shared between streams
+static pthread_mutex_t impulse_lock = PTHREAD_MUTEX_INITIALIZER;
+static ReverbImpulse* impulses = NULL;
+
+// Mutually prime-ish FDN line lengths, so the echo density builds up evenly
+static const float fdn_delays_ms[REVERB_FDN_LINES] = {
+    29.7f, 37.1f, 41.1f, 43.7f, 53.3f, 59.9f, 67.7f, 73.1f
+};
+
+static void free_impulse(ReverbImpulse* ir) {
+    if (!ir) return;
+    free(ir->path);
+    if (ir->re && ir->im) {
+        dsp_unlock_memory(ir->re, sizeof(float) * ir->partitions * REVERB_BINS);
+        dsp_unlock_memory(ir->im, sizeof(float) * ir->partitions * REVERB_BINS);
+    }
+    fftwf_free(ir->re);
+    fftwf_free(ir->im);
+    free(ir);
+}
+
+/**
+ * Reads a WAV file into memory as mono at the given sample rate.
+ * Other rates are converted with linear interpolation, which is plenty for
+ * a reverb tail.
+ *
+ * @return The samples (malloc), or NULL on failure. *length receives the count.
+ */
+static float* read_impulse_file(const char* path, size_t sample_rate, size_t* length) {
+    WavReader* reader = wav_reader_open(path);
+    if (!reader) return NULL;
+
+    size_t frames = reader->total_frames;
+    size_t max_frames = (size_t)reader->sample_rate * REVERB_MAX_IR_SECONDS;
+    if (frames > max_frames) {
+        printf("Warning: Impulse response %s truncated to %d s\n", path, REVERB_MAX_IR_SECONDS);
+        frames = max_frames;
+    }
+
+    float* raw = malloc((frames + 1) * sizeof(float));
+    if (!raw) {
+        wav_reader_close(reader);
+        return NULL;
+    }
+    frames = wav_read_frames(reader, raw, frames);
+    raw[frames] = 0.0f;
+    uint32_t file_rate = reader->sample_rate;
+    wav_reader_close(reader);
+
+    if (frames == 0) {
+        printf("Error: Impulse response %s is empty\n", path);
+        free(raw);
+        return NULL;
+    }
+    if (file_rate == sample_rate) {
+        *length = frames;
+        return raw;
+    }
+
+    size_t out_frames = (size_t)((double)frames * sample_rate / file_rate);
+    if (out_frames == 0) out_frames = 1;
+    float* resampled = malloc(out_frames * sizeof(float));
+    if (resampled) {
+        double step = (double)file_rate / sample_rate;
+        for (size_t i = 0; i < out_frames; i++) {
+            double pos = i * step;
+            size_t j = (size_t)pos;
+            float frac = (float)(pos - j);
+            resampled[i] = raw[j] + frac * (raw[j + 1] - raw[j]);
+        }
+    }
+    free(raw);
+    *length = out_frames;
+    return resampled;
+}
+
+/**
+ * Loads an impulse response and precomputes the spectrum of every partition,
+ * or returns the copy already loaded for the same file and rate.
+ *
+ * The response is normalised to unit energy so that the wet level does not
+ * depend on the recording. The 1 / REVERB_FFT_SIZE scaling of FFTW's
+ * inverse transform is folded into the spectra.
+ *
+ * @param path The WAV file (downmixed to mono).
+ * @param sample_rate The rate of the streams that will use it.
+ * @return The impulse response, or NULL on failure.
+ */
+ReverbImpulse* reverb_impulse_acquire(const char* path, size_t sample_rate) {
+    pthread_mutex_lock(&impulse_lock);
+
+    for (ReverbImpulse* ir = impulses; ir; ir = ir->next) {
+        if (ir->sample_rate == sample_rate && strcmp(ir->path, path) == 0) {
+            ir->refs++;
+            pthread_mutex_unlock(&impulse_lock);
+            return ir;
+        }
+    }
+
+    size_t length = 0;
+    float* samples = read_impulse_file(path, sample_rate, &length);
+    ReverbImpulse* ir = samples ? calloc(1, sizeof(ReverbImpulse)) : NULL;
+    float* frame = fftwf_malloc(sizeof(float) * REVERB_FFT_SIZE);
+    fftwf_complex* spectrum = fftwf_malloc(sizeof(fftwf_complex) * REVERB_BINS);
+    fftwf_plan plan = NULL;
+
+    if (ir && frame && spectrum) {
+        ir->path = strdup(path);
+        ir->sample_rate = sample_rate;
+        ir->partitions = (length + REVERB_PARTITION - 1) / REVERB_PARTITION;
+        ir->re = fftwf_malloc(sizeof(float) * ir->partitions * REVERB_BINS);
+        ir->im = fftwf_malloc(sizeof(float) * ir->partitions * REVERB_BINS);
+        plan = fft_plan_r2c(REVERB_FFT_SIZE, frame, spectrum);
+    }
+
+    if (!ir || !ir->path || !ir->re || !ir->im || !plan) {
+        printf("Error: Failed to load impulse response %s\n", path);
+        free_impulse(ir);
+        ir = NULL;
+    } else {
+        float energy = 0.0f;
+        for (size_t i = 0; i < length; i++) {
+            energy += samples[i] * samples[i];
+        }
+        float scale = (energy > 0.0f ? 1.0f / sqrtf(energy) : 0.0f) / REVERB_FFT_SIZE;
+
+        for (size_t k = 0; k < ir->partitions; k++) {
+            size_t start = k * REVERB_PARTITION;
+            size_t count = length - start < REVERB_PARTITION ? length - start : REVERB_PARTITION;
+            memset(frame, 0, sizeof(float) * REVERB_FFT_SIZE);
+            memcpy(frame, samples + start, count * sizeof(float));
+            fftwf_execute_dft_r2c(plan, frame, spectrum);
+
+            float* re = ir->re + k * REVERB_BINS;
+            float* im = ir->im + k * REVERB_BINS;
+            for (size_t b = 0; b < REVERB_BINS; b++) {
+                re[b] = crealf(spectrum[b]) * scale;
+                im[b] = cimagf(spectrum[b]) * scale;
+            }
+        }
+
+        // Shared by every stream's audio path, so keep it resident like the
+        // arenas (best effort: the arena lock already warns about limits)
+        dsp_lock_memory(ir->re, sizeof(float) * ir->partitions * REVERB_BINS);
+        dsp_lock_memory(ir->im, sizeof(float) * ir->partitions * REVERB_BINS);
+
+        ir->refs = 1;
+        ir->next = impulses;
+        impulses = ir;
+        printf("Reverb: loaded %s (%.2f s, %zu partitions of %d samples)\n",
+               path, (double)length / sample_rate, ir->partitions, REVERB_PARTITION);
+    }
+
+    fft_plan_destroy(plan);
+    fftwf_free(frame);
+    fftwf_free(spectrum);
+    free(samples);
+    pthread_mutex_unlock(&impulse_lock);
+    return ir;
+}
+
+/**
+ * Drops one reference to an impulse response and frees it with the last one.
+ *
+ * @param ir The impulse response (NULL is ignored).
+ */
+void reverb_impulse_release(ReverbImpulse* ir) {
+    if (!ir) return;
+
+    pthread_mutex_lock(&impulse_lock);
+    if (--ir->refs == 0) {
+        ReverbImpulse** link = &impulses;
+        while (*link != ir) link = &(*link)->next;
+        *link = ir->next;
+        free_impulse(ir);
+    }
+    pthread_mutex_unlock(&impulse_lock);
+}
+
+/**
+ * Creates a reverb. The FDN is always available; the convolution engine is
+ * set up when an impulse response can be loaded from ir_path.
+ *
+ * @param sample_rate The sample rate in Hz.
+ * @param ir_path The impulse response WAV file, or NULL for FDN only.
+ * @param arena Arena for the reverb and its buffers, or NULL for the heap.
+ *              The impulse response is shared and lives on the heap.
+ * @return The reverb, or NULL on failure.
+ */
+ReverbEngine* reverb_create(size_t sample_rate, const char* ir_path, DspArena* arena) {
+    ReverbEngine* reverb = dsp_alloc(arena, sizeof(ReverbEngine));
+    if (!reverb) {
+        printf("Error: Failed to allocate reverb\n");
+        return NULL;
+    }
+    reverb->arena = arena;
+    reverb->sample_rate = sample_rate;
+    reverb->gain_coef = 1.0f / (REVERB_GAIN_GLIDE_MS * 0.001f * sample_rate);
+
+    for (int l = 0; l < REVERB_FDN_LINES; l++) {
+        size_t length = (size_t)(fdn_delays_ms[l] * 0.001f * sample_rate);
+        if (length < 1) length = 1;
+        reverb->line_length[l] = length;
+        reverb->line_gain[l] = powf(10.0f, -3.0f * length / (REVERB_FDN_RT60 * sample_rate));
+        reverb->lines[l] = dsp_alloc(arena, length * sizeof(float));
+        if (!reverb->lines[l]) {
+            printf("Error: Failed to allocate reverb delay lines\n");
+            reverb_destroy(reverb);
+            return NULL;
+        }
+    }
+
+    if (ir_path) {
+        reverb->ir = reverb_impulse_acquire(ir_path, sample_rate);
+    }
+    if (reverb->ir) {
+        size_t fdl = reverb->ir->partitions * REVERB_BINS;
+        reverb->time = dsp_alloc(arena, sizeof(float) * REVERB_FFT_SIZE);
+        reverb->out_time = dsp_alloc(arena, sizeof(float) * REVERB_FFT_SIZE);
+        reverb->spectrum = dsp_alloc(arena, sizeof(fftwf_complex) * REVERB_BINS);
+        reverb->fdl_re = dsp_alloc(arena, sizeof(float) * fdl);
+        reverb->fdl_im = dsp_alloc(arena, sizeof(float) * fdl);
+        reverb->acc_re = dsp_alloc(arena, sizeof(float) * REVERB_BINS);
+        reverb->acc_im = dsp_alloc(arena, sizeof(float) * REVERB_BINS);
+        reverb->in_block = dsp_alloc(arena, sizeof(float) * REVERB_PARTITION);
+        reverb->wet_block = dsp_alloc(arena, sizeof(float) * REVERB_PARTITION);
+        if (!reverb->time || !reverb->out_time || !reverb->spectrum || !reverb->fdl_re ||
+            !reverb->fdl_im || !reverb->acc_re || !reverb->acc_im || !reverb->in_block ||
+            !reverb->wet_block) {
+            printf("Error: Failed to allocate convolution reverb buffers\n");
+            reverb_destroy(reverb);
+            return NULL;
+        }
+
+        reverb->forward_plan = fft_plan_r2c(REVERB_FFT_SIZE, reverb->time, reverb->spectrum);
+        reverb->inverse_plan = fft_plan_c2r(REVERB_FFT_SIZE, reverb->spectrum, reverb->out_time);
+        if (!reverb->forward_plan || !reverb->inverse_plan) {
+            printf("Error: Failed to create reverb FFT plans\n");
+            reverb_destroy(reverb);
+            return NULL;
+        }
+    } else if (ir_path) {
+        printf("Warning: Convolution reverb unavailable, using the FDN reverb.\n");
+    }
+
+    reverb_reset(reverb);
+    return reverb;
+}
+
+/**
+ * Frees the reverb and drops its reference to the impulse response.
+ *
+ * @param reverb The reverb (NULL is ignored).
+ */
+void reverb_destroy(ReverbEngine* reverb) {
+    if (!reverb) return;
+
+    fft_plan_destroy(reverb->forward_plan);
+    fft_plan_destroy(reverb->inverse_plan);
+    dsp_free(reverb->arena, reverb->time);
+    dsp_free(reverb->arena, reverb->out_time);
+    dsp_free(reverb->arena, reverb->spectrum);
+    dsp_free(reverb->arena, reverb->fdl_re);
+    dsp_free(reverb->arena, reverb->fdl_im);
+    dsp_free(reverb->arena, reverb->acc_re);
+    dsp_free(reverb->arena, reverb->acc_im);
+    dsp_free(reverb->arena, reverb->in_block);
+    dsp_free(reverb->arena, reverb->wet_block);
+    reverb_impulse_release(reverb->ir);
+    for (int l = 0; l < REVERB_FDN_LINES; l++) {
+        dsp_free(reverb->arena, reverb->lines[l]);
+    }
+    dsp_free(reverb->arena, reverb);
+}
+
+/**
+ * Clears all reverb state (tails, delay lines and the wet gain).
+ *
+ * @param reverb The reverb.
+ */
+void reverb_reset(ReverbEngine* reverb) {
+    if (reverb->ir) {
+        size_t fdl = reverb->ir->partitions * REVERB_BINS;
+        memset(reverb->time, 0, sizeof(float) * REVERB_FFT_SIZE);
+        memset(reverb->fdl_re, 0, sizeof(float) * fdl);
+        memset(reverb->fdl_im, 0, sizeof(float) * fdl);
+        memset(reverb->in_block, 0, sizeof(float) * REVERB_PARTITION);
+        memset(reverb->wet_block, 0, sizeof(float) * REVERB_PARTITION);
+        reverb->fdl_pos = 0;
+        reverb->fill = 0;
+    }
+    for (int l = 0; l < REVERB_FDN_LINES; l++) {
+        memset(reverb->lines[l], 0, sizeof(float) * reverb->line_length[l]);
+        reverb->line_pos[l] = 0;
+        reverb->line_lowpass[l] = 0.0f;
+    }
+    reverb->active = 0;
+    reverb->wet = 0.0f;
+}
+
+/**
+ * Multiply-accumulates `count` partitions of the frequency-domain delay line
+ * against the impulse response, starting at FDL slot `slot` and partition `k`.
+ * Split real/imaginary storage keeps the inner loop a plain vectorisable
+ * complex multiply.
+ */
+static void accumulate_partitions(ReverbEngine* reverb, size_t slot, size_t k, size_t count) {
+    float* acc_re = reverb->acc_re;
+    float* acc_im = reverb->acc_im;
+
+    for (size_t p = 0; p < count; p++) {
+        const float* x_re = reverb->fdl_re + (slot + p) * REVERB_BINS;
+        const float* x_im = reverb->fdl_im + (slot + p) * REVERB_BINS;
+        const float* h_re = reverb->ir->re + (k + p) * REVERB_BINS;
+        const float* h_im = reverb->ir->im + (k + p) * REVERB_BINS;
+        for (size_t b = 0; b < REVERB_BINS; b++) {
+            acc_re[b] += x_re[b] * h_re[b] - x_im[b] * h_im[b];
+            acc_im[b] += x_re[b] * h_im[b] + x_im[b] * h_re[b];
+        }
+    }
+}
+
+/**
+ * Convolves one complete input partition with the whole impulse response
+ * (uniformly partitioned overlap-save): one forward FFT, one complex
+ * multiply-accumulate per partition, one inverse FFT. The cost is the same
+ * for every block, however long the response.
+ */
+static void convolve_partition(ReverbEngine* reverb) {
+    const size_t partitions = reverb->ir->partitions;
+
+    // Slide the input window: [previous block | this block]
+    memcpy(reverb->time, reverb->time + REVERB_PARTITION, sizeof(float) * REVERB_PARTITION);
+    memcpy(reverb->time + REVERB_PARTITION, reverb->in_block, sizeof(float) * REVERB_PARTITION);
+    fftwf_execute_dft_r2c(reverb->forward_plan, reverb->time, reverb->spectrum);
+
+    // The newest spectrum goes in front; slot fdl_pos + k holds the block k partitions old
+    reverb->fdl_pos = (reverb->fdl_pos + partitions - 1) % partitions;
+    float* x_re = reverb->fdl_re + reverb->fdl_pos * REVERB_BINS;
+    float* x_im = reverb->fdl_im + reverb->fdl_pos * REVERB_BINS;
+    for (size_t b = 0; b < REVERB_BINS; b++) {
+        x_re[b] = crealf(reverb->spectrum[b]);
+        x_im[b] = cimagf(reverb->spectrum[b]);
+    }
+
+    memset(reverb->acc_re, 0, sizeof(float) * REVERB_BINS);
+    memset(reverb->acc_im, 0, sizeof(float) * REVERB_BINS);
+    size_t first = partitions - reverb->fdl_pos;
+    accumulate_partitions(reverb, reverb->fdl_pos, 0, first);
+    accumulate_partitions(reverb, 0, first, partitions - first);
+
+    for (size_t b = 0; b < REVERB_BINS; b++) {
+        reverb->spectrum[b] = reverb->acc_re[b] + I * reverb->acc_im[b];
+    }
+    fftwf_execute_dft_c2r(reverb->inverse_plan, reverb->spectrum, reverb->out_time);
+
+    // Overlap-save: the second half is the linear convolution of this block
+    memcpy(reverb->wet_block, reverb->out_time + REVERB_PARTITION, sizeof(float) * REVERB_PARTITION);
+}
+
+static void process_convolution(ReverbEngine* reverb, float* samples, size_t length,
+                                float wet, float wet_step) {
+    size_t done = 0;
+    while (done < length) {
+        size_t n = REVERB_PARTITION - reverb->fill;
+        if (n > length - done) n = length - done;
+
+        // The wet signal of the previous partition plays while this one fills
+        float* in = reverb->in_block + reverb->fill;
+        const float* out = reverb->wet_block + reverb->fill;
+        float* x = samples + done;
+        for (size_t i = 0; i < n; i++) {
+            in[i] = x[i];
+            x[i] += (wet + wet_step * (float)(done + i)) * out[i];
+        }
+
+        reverb->fill += n;
+        done += n;
+        if (reverb->fill == REVERB_PARTITION) {
+            convolve_partition(reverb);
+            reverb->fill = 0;
+        }
+    }
+}
+
+/**
+ * 8-line feedback delay network: each line is read, damped by a one-pole
+ * lowpass and attenuated for REVERB_FDN_RT60, mixed through a normalised
+ * Hadamard matrix and written back together with the input.
+ */
+static void process_fdn(ReverbEngine* reverb, float* samples, size_t length,
+                        float wet, float wet_step) {
+    const float norm = 0.35355339f;  // 1 / sqrt(REVERB_FDN_LINES)
+
+    for (size_t i = 0; i < length; i++) {
+        float v[REVERB_FDN_LINES];
+        float out = 0.0f;
+
+        for (int l = 0; l < REVERB_FDN_LINES; l++) {
+            float delayed = reverb->lines[l][reverb->line_pos[l]];
+            float lp = delayed + REVERB_FDN_DAMPING * (reverb->line_lowpass[l] - delayed);
+            if (fabsf(lp) < 1e-30f) lp = 0.0f;  // Keep the decaying tail out of denormals
+            reverb->line_lowpass[l] = lp;
+            v[l] = lp * reverb->line_gain[l];
+            out += (l & 1) ? -v[l] : v[l];
+        }
+
+        // Fast Walsh-Hadamard transform
+        for (int span = 1; span < REVERB_FDN_LINES; span <<= 1) {
+            for (int l = 0; l < REVERB_FDN_LINES; l += 2 * span) {
+                for (int j = l; j < l + span; j++) {
+                    float a = v[j], b = v[j + span];
+                    v[j] = a + b;
+                    v[j + span] = a - b;
+                }
+            }
+        }
+
+        float input = samples[i] * norm;
+        for (int l = 0; l < REVERB_FDN_LINES; l++) {
+            reverb->lines[l][reverb->line_pos[l]] = input + v[l] * norm;
+            if (++reverb->line_pos[l] == reverb->line_length[l]) reverb->line_pos[l] = 0;
+        }
+
+        samples[i] += (wet + wet_step * (float)i) * out * norm;
+    }
+}
+
+/**
+ * Adds reverb to a block of samples, in place.
+ *
+ * The convolution mode delays the wet signal by REVERB_PARTITION samples (a
+ * pre-delay) and costs one partition's worth of work per REVERB_PARTITION
+ * samples regardless of the response length; it falls back to the FDN when
+ * no impulse response was loaded. While the intensity is zero nothing runs,
+ * and the state is cleared when the reverb is turned back on, so stale
+ * tails never play. Never allocates or locks.
+ *
+ * @param reverb The reverb.
+ * @param samples The samples to process.
+ * @param length The number of samples.
+ * @param intensity Wet level (0.0 - 1.0), ramped over REVERB_GAIN_GLIDE_MS.
+ * @param mode The reverb algorithm.
+ */
+void reverb_process(ReverbEngine* reverb, float* samples, size_t length, float intensity, ReverbMode mode) {
+    if (intensity < 0.0f) intensity = 0.0f;
+    if (intensity > 1.0f) intensity = 1.0f;
+    if (mode == REVERB_MODE_CONVOLUTION && !reverb->ir) mode = REVERB_MODE_FDN;
+
+    if (intensity == 0.0f && reverb->wet < 1e-4f) {
+        reverb->active = 0;
+        reverb->wet = 0.0f;
+        return;
+    }
+    if (!reverb->active || mode != reverb->mode) {
+        reverb_reset(reverb);
+        reverb->mode = mode;
+        reverb->active = 1;
+    }
+
+    // Linear ramp towards the target at gain_coef per sample, then hold
+    float wet = reverb->wet;
+    float delta = intensity - wet;
+    size_t ramp = (size_t)(fabsf(delta) / reverb->gain_coef);
+    if (ramp > length) ramp = length;
+    float wet_step = ramp > 0 ? (delta > 0.0f ? reverb->gain_coef : -reverb->gain_coef) : 0.0f;
+    float target = wet + wet_step * (float)ramp;
+    if (ramp < length) target = intensity;
+
+    if (mode == REVERB_MODE_CONVOLUTION) {
+        process_convolution(reverb, samples, ramp, wet, wet_step);
+        process_convolution(reverb, samples + ramp, length - ramp, target, 0.0f);
+    } else {
+        process_fdn(reverb, samples, ramp, wet, wet_step);
+        process_fdn(reverb, samples + ramp, length - ramp, target, 0.0f);
+    }
+    reverb->wet = target;
+}
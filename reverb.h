@@ -0,0 +1,80 @@
+#ifndef REVERB_H
+#define REVERB_H
+
+#include <stddef.h>
+#include <pthread.h>
+#include "phase_vocoder.h"
+
+// Partition length of the convolution: the wet signal is delayed by this
+// many samples (a natural pre-delay), and every partition costs the same
+#define REVERB_PARTITION HOP_SIZE
+#define REVERB_FFT_SIZE (2 * REVERB_PARTITION)
+#define REVERB_BINS (REVERB_PARTITION + 1)
+#define REVERB_MAX_IR_SECONDS 10
+
+#define REVERB_FDN_LINES 8
+#define REVERB_FDN_RT60 1.8f        // Decay time of the algorithmic reverb (seconds)
+#define REVERB_FDN_DAMPING 0.35f    // One-pole lowpass in each line (0 = bright)
+#define REVERB_GAIN_GLIDE_MS 20.0f  // Duration of a full-scale intensity change
+
+typedef enum {
+    REVERB_MODE_CONVOLUTION = 0,  // Impulse response from a WAV file (FDN if none was loaded)
+    REVERB_MODE_FDN               // Algorithmic feedback delay network
+} ReverbMode;
+
+// Impulse response cut into REVERB_PARTITION-sample partitions and stored as
+// split real/imaginary spectra. Read-only once loaded, so every stream using
+// the same file at the same rate shares one copy.
+typedef struct ReverbImpulse {
+    char* path;
+    size_t sample_rate;
+    size_t partitions;
+    float* re;                 // partitions * REVERB_BINS (mlocked when possible)
+    float* im;
+    int refs;
+    struct ReverbImpulse* next;
+} ReverbImpulse;
+
+// One reverb per pipeline. All buffers and plans are created up front;
+// reverb_process() never allocates or locks.
+typedef struct {
+    ReverbMode mode;           // Mode the state below was last used in
+
+    // Uniformly partitioned overlap-save convolution
+    ReverbImpulse* ir;
+    fftwf_plan forward_plan;
+    fftwf_plan inverse_plan;
+    float* time;               // REVERB_FFT_SIZE: previous and current input block
+    fftwf_complex* spectrum;   // REVERB_BINS
+    float* fdl_re;             // Frequency-domain delay line: partitions * REVERB_BINS
+    float* fdl_im;
+    size_t fdl_pos;            // Slot of the newest input spectrum
+    float* acc_re;             // Accumulated output spectrum
+    float* acc_im;
+    float* in_block;           // Input collected for the next partition
+    float* out_time;           // REVERB_FFT_SIZE: inverse transform of the last partition
+    float* wet_block;          // Wet output of the last partition
+    size_t fill;               // Samples in in_block
+
+    // Feedback delay network
+    float* lines[REVERB_FDN_LINES];
+    size_t line_length[REVERB_FDN_LINES];
+    size_t line_pos[REVERB_FDN_LINES];
+    float line_gain[REVERB_FDN_LINES];
+    float line_lowpass[REVERB_FDN_LINES];
+
+    int active;                // State is live (cleared again when the reverb is turned on)
+    float wet;                 // Smoothed wet gain
+    float gain_coef;           // Wet gain change per sample
+    size_t sample_rate;
+    DspArena* arena;           // Owner of the struct and buffers (NULL = heap)
+} ReverbEngine;
+
+ReverbImpulse* reverb_impulse_acquire(const char* path, size_t sample_rate);
+void reverb_impulse_release(ReverbImpulse* ir);
+ReverbEngine* reverb_create(size_t sample_rate, const char* ir_path, DspArena* arena);
+void reverb_destroy(ReverbEngine* reverb);
+void reverb_reset(ReverbEngine* reverb);
+void reverb_process(ReverbEngine* reverb, float* samples, size_t length, float intensity, ReverbMode mode);
+
+#endif
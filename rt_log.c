@@ -0,0 +1,239 @@
+#include "rt_log.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+// One preformatted message. `sequence` hands the slot between producers
+// and the drainer (bounded MPMC queue): it equals the slot's enqueue
+// position when free and position + 1 once filled.
+typedef struct {
+    atomic_size_t sequence;
+    RtLogLevel level;
+    char text[RT_LOG_TEXT];
+} RtLogRecord;
+
+static RtLogRecord records[RT_LOG_RECORDS];
+static atomic_size_t enqueue_pos;
+static size_t dequeue_pos;                 // Guarded by drain_lock
+static pthread_mutex_t drain_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static atomic_int running;                 // Records go through the ring (else straight to stdout)
+static atomic_ulong logged;
+static atomic_ulong dropped;
+static atomic_ulong suppressed;
+static unsigned long dropped_reported;     // Guarded by drain_lock
+
+static pthread_t drainer;
+static pthread_mutex_t drainer_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t drainer_wake = PTHREAD_COND_INITIALIZER;
+static int drainer_stop;
+
+static unsigned long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long)ts.tv_sec * 1000000000ul + (unsigned long)ts.tv_nsec;
+}
+
+static const char* level_prefix(RtLogLevel level) {
+    switch (level) {
+        case RT_LOG_ERROR: return "Error: ";
+        case RT_LOG_WARNING: return "Warning: ";
+        default: return "";
+    }
+}
+
+/**
+ * Prints every complete record in the ring, oldest first, and reports new
+ * drops. Called by the drainer and by rt_log_flush().
+ */
+static void drain(void) {
+    pthread_mutex_lock(&drain_lock);
+    for (;;) {
+        RtLogRecord* record = &records[dequeue_pos & (RT_LOG_RECORDS - 1)];
+        size_t sequence = atomic_load_explicit(&record->sequence, memory_order_acquire);
+        if (sequence != dequeue_pos + 1) break;  // Empty, or still being written
+
+        printf("%s%s\n", level_prefix(record->level), record->text);
+        atomic_store_explicit(&record->sequence, dequeue_pos + RT_LOG_RECORDS, memory_order_release);
+        dequeue_pos++;
+    }
+
+    unsigned long lost = atomic_load_explicit(&dropped, memory_order_relaxed);
+    if (lost != dropped_reported) {
+        printf("Warning: Log ring full, %lu messages dropped\n", lost - dropped_reported);
+        dropped_reported = lost;
+    }
+    fflush(stdout);
+    pthread_mutex_unlock(&drain_lock);
+}
+
+static void* drainer_thread(void* arg) {
+    // Best effort: lowest normal priority, so printing never competes with audio
+    struct sched_param param = { .sched_priority = sched_get_priority_min(SCHED_OTHER) };
+    pthread_setschedparam(pthread_self(), SCHED_OTHER, &param);
+
+    pthread_mutex_lock(&drainer_lock);
+    while (!drainer_stop) {
+        pthread_mutex_unlock(&drainer_lock);
+        drain();
+
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += RT_LOG_DRAIN_MS * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        pthread_mutex_lock(&drainer_lock);
+        if (!drainer_stop) {
+            pthread_cond_timedwait(&drainer_wake, &drainer_lock, &deadline);
+        }
+    }
+    pthread_mutex_unlock(&drainer_lock);
+    return NULL;
+}
+
+/**
+ * Starts the drainer thread. From here until rt_log_stop() messages are
+ * queued instead of printed by the caller.
+ *
+ * @return 0 on success, -1 if the thread could not be created (messages
+ *         are then printed directly).
+ */
+int rt_log_start(void) {
+    if (atomic_load(&running)) return 0;
+
+    for (size_t i = 0; i < RT_LOG_RECORDS; i++) {
+        atomic_init(&records[i].sequence, i);
+    }
+    atomic_store(&enqueue_pos, 0);
+    dequeue_pos = 0;
+    drainer_stop = 0;
+
+    if (pthread_create(&drainer, NULL, drainer_thread, NULL) != 0) {
+        printf("Warning: Failed to start the log drainer; logging directly.\n");
+        return -1;
+    }
+    atomic_store_explicit(&running, 1, memory_order_release);
+    return 0;
+}
+
+/**
+ * Prints everything still queued and stops the drainer. Callers must have
+ * stopped logging from other threads first.
+ */
+void rt_log_stop(void) {
+    if (!atomic_load(&running)) return;
+
+    pthread_mutex_lock(&drainer_lock);
+    drainer_stop = 1;
+    pthread_cond_signal(&drainer_wake);
+    pthread_mutex_unlock(&drainer_lock);
+    pthread_join(drainer, NULL);
+
+    drain();
+    atomic_store_explicit(&running, 0, memory_order_release);
+}
+
+/**
+ * Prints everything queued so far from the calling thread, so that control
+ * thread output that follows keeps its order.
+ */
+void rt_log_flush(void) {
+    if (atomic_load_explicit(&running, memory_order_acquire)) {
+        drain();
+    }
+}
+
+static void log_record(RtLogLevel level, unsigned long repeats, const char* format, va_list args) {
+    if (!atomic_load_explicit(&running, memory_order_acquire)) {
+        // No drainer: not on the audio path, print directly
+        printf("%s", level_prefix(level));
+        vprintf(format, args);
+        if (repeats > 0) printf(" (%lu more suppressed)", repeats);
+        printf("\n");
+        return;
+    }
+
+    // Claim a free slot; give up rather than wait when the ring is full
+    size_t pos = atomic_load_explicit(&enqueue_pos, memory_order_relaxed);
+    RtLogRecord* record;
+    for (;;) {
+        record = &records[pos & (RT_LOG_RECORDS - 1)];
+        size_t sequence = atomic_load_explicit(&record->sequence, memory_order_acquire);
+        intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&enqueue_pos, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            atomic_fetch_add_explicit(&dropped, 1, memory_order_relaxed);
+            return;
+        } else {
+            pos = atomic_load_explicit(&enqueue_pos, memory_order_relaxed);
+        }
+    }
+
+    record->level = level;
+    int n = vsnprintf(record->text, RT_LOG_TEXT, format, args);
+    if (repeats > 0 && n >= 0 && n < RT_LOG_TEXT) {
+        snprintf(record->text + n, RT_LOG_TEXT - n, " (%lu more suppressed)", repeats);
+    }
+    atomic_fetch_add_explicit(&logged, 1, memory_order_relaxed);
+    atomic_store_explicit(&record->sequence, pos + 1, memory_order_release);
+}
+
+/**
+ * Logs one message. While the drainer runs this formats into a ring slot
+ * and returns without locking, blocking or allocating, so audio threads
+ * may call it; if the ring is full the message is dropped and counted.
+ *
+ * @param level The severity, which selects the printed prefix.
+ * @param format printf format of the message (no trailing newline).
+ */
+void rt_log(RtLogLevel level, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    log_record(level, 0, format, args);
+    va_end(args);
+}
+
+/**
+ * Logs one message unless the same call site already did within
+ * RT_LOG_RATE_LIMIT_MS. Swallowed repeats are counted and mentioned in the
+ * next message that goes out. Use through RT_LOG_LIMITED.
+ *
+ * @param limiter The call site's state.
+ * @param level The severity.
+ * @param format printf format of the message.
+ */
+void rt_log_limited(RtLogLimiter* limiter, RtLogLevel level, const char* format, ...) {
+    unsigned long now = now_ns();
+    unsigned long next = atomic_load_explicit(&limiter->next_ns, memory_order_relaxed);
+    if (now < next || !atomic_compare_exchange_strong_explicit(&limiter->next_ns, &next,
+                                                               now + RT_LOG_RATE_LIMIT_MS * 1000000ul,
+                                                               memory_order_relaxed, memory_order_relaxed)) {
+        atomic_fetch_add_explicit(&limiter->suppressed, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&suppressed, 1, memory_order_relaxed);
+        return;
+    }
+
+    va_list args;
+    va_start(args, format);
+    log_record(level, atomic_exchange_explicit(&limiter->suppressed, 0, memory_order_relaxed), format, args);
+    va_end(args);
+}
+
+/**
+ * @param counts Receives the number of messages queued, dropped and
+ *               suppressed since the program started.
+ */
+void rt_log_counts(RtLogCounts* counts) {
+    counts->logged = atomic_load_explicit(&logged, memory_order_relaxed);
+    counts->dropped = atomic_load_explicit(&dropped, memory_order_relaxed);
+    counts->suppressed = atomic_load_explicit(&suppressed, memory_order_relaxed);
+}
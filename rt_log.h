@@ -0,0 +1,46 @@
+#ifndef RT_LOG_H
+#define RT_LOG_H
+
+#include <stdatomic.h>
+
+#define RT_LOG_RECORDS 256          // Ring capacity (power of two)
+#define RT_LOG_TEXT 200             // Longest message; longer ones are truncated
+#define RT_LOG_DRAIN_MS 20          // Drainer poll period
+#define RT_LOG_RATE_LIMIT_MS 1000   // RT_LOG_LIMITED: at most one message per call site per period
+
+typedef enum {
+    RT_LOG_INFO = 0,
+    RT_LOG_WARNING,                 // Printed with a "Warning: " prefix
+    RT_LOG_ERROR                    // Printed with an "Error: " prefix
+} RtLogLevel;
+
+// Per-call-site rate limit state (see RT_LOG_LIMITED)
+typedef struct {
+    atomic_ulong next_ns;           // Earliest time the next message may go out
+    atomic_ulong suppressed;        // Messages swallowed since the last one that went out
+} RtLogLimiter;
+
+typedef struct {
+    unsigned long logged;           // Records queued
+    unsigned long dropped;          // Records lost because the ring was full
+    unsigned long suppressed;       // Messages swallowed by rate limits
+} RtLogCounts;
+
+int rt_log_start(void);
+void rt_log_stop(void);
+void rt_log_flush(void);
+void rt_log(RtLogLevel level, const char* format, ...) __attribute__((format(printf, 2, 3)));
+void rt_log_limited(RtLogLimiter* limiter, RtLogLevel level, const char* format, ...)
+    __attribute__((format(printf, 3, 4)));
+void rt_log_counts(RtLogCounts* counts);
+
+// Logs from a call site that may repeat every block: the first message goes
+// out, repeats within RT_LOG_RATE_LIMIT_MS are counted and reported with the
+// next one that does
+#define RT_LOG_LIMITED(level, ...)                   \
+    do {                                             \
+        static RtLogLimiter rt_log_limiter_;         \
+        rt_log_limited(&rt_log_limiter_, level, __VA_ARGS__); \
+    } while (0)
+
+#endif
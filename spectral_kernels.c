@@ -0,0 +1,1132 @@
+#include "spectral_kernels.h"
+#include <math.h>
+#include <stdio.h>
+
+// Each kernel is built once per instruction set. The x86 variants carry
+// target attributes, so the build needs no -march for them and
+// spectral_kernels_init() can pick the widest set the CPU runs.
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SPECTRAL_X86 1
+#define TARGET_SSE42 __attribute__((target("sse4.2")))
+#define TARGET_AVX2 __attribute__((target("avx2,fma")))
+#define TARGET_AVX512 __attribute__((target("avx512f,avx512dq")))
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define SPECTRAL_NEON 1
+#endif
+
+// atan(a) on [0, 1]: odd minimax polynomial, |error| <= 2.0e-6 rad
+#define ATAN_C1  0.99997726f
+#define ATAN_C3 -0.33262347f
+#define ATAN_C5  0.19354346f
+#define ATAN_C7 -0.11643287f
+#define ATAN_C9  0.05265332f
+#define ATAN_C11 -0.01172120f
+
+// sin/cos on [-pi/4, pi/4] (Cephes single-precision coefficients)
+#define SIN_C1 -1.6666654611e-1f
+#define SIN_C2  8.3321608736e-3f
+#define SIN_C3 -1.9515295891e-4f
+#define COS_C1  4.166664568298827e-2f
+#define COS_C2 -1.388731625493765e-3f
+#define COS_C3  2.443315711809948e-5f
+
+// pi/2 split in three so that j * PIO2_1 and j * PIO2_2 are exact for small j
+// (Cody-Waite reduction, Cephes constants scaled from pi/4)
+#define PIO2_1 1.5703125f
+#define PIO2_2 4.837512969970703125e-4f
+#define PIO2_3 7.54978995489188216e-8f
+#define TWO_OVER_PI 0.63661977236758134f
+#define HALF_PI 1.57079632679489662f
+#define PI_F 3.14159265358979324f
+
+// Guards 0/0 when both components are zero
+#define ATAN_TINY 1e-30f
+
+// Half-sample point of a 4-tap cubic interpolator, (9 * (b + c) - (a + d)) / 16,
+// used as the true-peak estimate between two samples
+#define HALF_NEAR 0.5625f
+#define HALF_FAR 0.0625f
+
+// One instruction set's kernels
+typedef struct {
+    void (*to_polar)(const fftwf_complex* bins, float* mag, float* phase, size_t n);
+    void (*to_cartesian)(const float* mag, const float* phase, fftwf_complex* bins, size_t n);
+    void (*cross_correlate)(const float* ref, const float* signal, size_t length, float* corr, size_t lags);
+    void (*multiply)(float* samples, const float* factors, size_t n);
+    float (*sum_of_squares)(const float* samples, size_t n);
+    void (*gain_and_clip)(float* samples, size_t n, float gain);
+    float (*gain_ramp_peak)(const float* in, float* out, size_t n, float gain, float step, float* energy);
+    void (*gain_ramp_clip)(const float* in, float* out, size_t n, float gain, float step);
+} KernelTable;
+
+/**
+ * Scalar version of the vector atan2 approximation, used for loop tails so
+ * every bin sees the same arithmetic whatever its index.
+ */
+static inline float atan2_approx(float y, float x) {
+    float ax = fabsf(x);
+    float ay = fabsf(y);
+    float mx = ax > ay ? ax : ay;
+    float mn = ax > ay ? ay : ax;
+    float a = mn / (mx > ATAN_TINY ? mx : ATAN_TINY);
+    float s = a * a;
+    float r = a * (ATAN_C1 + s * (ATAN_C3 + s * (ATAN_C5 + s * (ATAN_C7 + s * (ATAN_C9 + s * ATAN_C11)))));
+    if (ay > ax) r = HALF_PI - r;
+    if (x < 0.0f) r = PI_F - r;
+    return copysignf(r, y);
+}
+
+/**
+ * Scalar version of the vector sincos approximation.
+ */
+static inline void sincos_approx(float x, float* s, float* c) {
+    int j = (int)lrintf(x * TWO_OVER_PI);
+    float fj = (float)j;
+    float r = ((x - fj * PIO2_1) - fj * PIO2_2) - fj * PIO2_3;
+    float r2 = r * r;
+    float sp = r + r * r2 * (SIN_C1 + r2 * (SIN_C2 + r2 * SIN_C3));
+    float cp = 1.0f - 0.5f * r2 + r2 * r2 * (COS_C1 + r2 * (COS_C2 + r2 * COS_C3));
+
+    float sv = (j & 1) ? cp : sp;
+    float cv = (j & 1) ? sp : cp;
+    *s = (j & 2) ? -sv : sv;
+    *c = ((j + 1) & 2) ? -cv : cv;
+}
+
+static inline float clip_sample(float sample) {
+    if (sample > 1.0f) sample = 1.0f;
+    if (sample < -1.0f) sample = -1.0f;
+    return sample;
+}
+
+/* Portable C: the same approximations one bin at a time, which the compiler
+ * may still vectorise for the build's baseline. */
+
+static void to_polar_scalar(const fftwf_complex* bins, float* mag, float* phase, size_t n) {
+    const float* in = (const float*)bins;
+    for (size_t k = 0; k < n; k++) {
+        float re = in[2 * k];
+        float im = in[2 * k + 1];
+        mag[k] = sqrtf(re * re + im * im);
+        phase[k] = atan2_approx(im, re);
+    }
+}
+
+static void to_cartesian_scalar(const float* mag, const float* phase, fftwf_complex* bins, size_t n) {
+    float* out = (float*)bins;
+    for (size_t k = 0; k < n; k++) {
+        float s, c;
+        sincos_approx(phase[k], &s, &c);
+        out[2 * k] = mag[k] * c;
+        out[2 * k + 1] = mag[k] * s;
+    }
+}
+
+static void cross_correlate_c(const float* ref, const float* signal, size_t length, float* corr, size_t lags) {
+    for (size_t k = 0; k < lags; k++) {
+        float acc = 0.0f;
+        for (size_t i = 0; i < length; i++) {
+            acc += ref[i] * signal[k + i];
+        }
+        corr[k] = acc;
+    }
+}
+
+static void multiply_c(float* samples, const float* factors, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        samples[i] *= factors[i];
+    }
+}
+
+static float sum_of_squares_c(const float* samples, size_t n) {
+    float sum = 0.0f;
+    for (size_t i = 0; i < n; i++) {
+        sum += samples[i] * samples[i];
+    }
+    return sum;
+}
+
+static void gain_and_clip_c(float* samples, size_t n, float gain) {
+    for (size_t i = 0; i < n; i++) {
+        samples[i] = clip_sample(samples[i] * gain);
+    }
+}
+
+// Ramps samples [start, n), adds their input energy and returns their peak
+static float ramp_peak_c(const float* in, float* out, size_t start, size_t n, float gain, float step,
+                         float* energy) {
+    float sum = 0.0f;
+    float peak = 0.0f;
+    for (size_t i = start; i < n; i++) {
+        float y = in[i] * (gain + step * (float)i);
+        out[i] = y;
+        sum += in[i] * in[i];
+        peak = fmaxf(peak, fabsf(y));
+    }
+    *energy += sum;
+    return peak;
+}
+
+// Peak of the half-sample points between y[i - 2] and y[i - 1] for i in [start, n)
+static float half_sample_peak_c(const float* y, size_t start, size_t n) {
+    float peak = 0.0f;
+    for (size_t i = start; i < n; i++) {
+        const float* p = y + i;
+        float mid = HALF_NEAR * (p[-2] + p[-1]) - HALF_FAR * (p[-3] + p[0]);
+        peak = fmaxf(peak, fabsf(mid));
+    }
+    return peak;
+}
+
+static float gain_ramp_peak_c(const float* in, float* out, size_t n, float gain, float step, float* energy) {
+    *energy = 0.0f;
+    float peak = ramp_peak_c(in, out, 0, n, gain, step, energy);
+    return fmaxf(peak, half_sample_peak_c(out, 0, n));
+}
+
+// Ramps and clips samples [start, n)
+static void ramp_clip_c(const float* in, float* out, size_t start, size_t n, float gain, float step) {
+    for (size_t i = start; i < n; i++) {
+        out[i] = clip_sample(in[i] * (gain + step * (float)i));
+    }
+}
+
+static void gain_ramp_clip_c(const float* in, float* out, size_t n, float gain, float step) {
+    ramp_clip_c(in, out, 0, n, gain, step);
+}
+
+#if SPECTRAL_X86
+
+/* SSE4.2: four lanes, no FMA. */
+
+TARGET_SSE42 static inline __m128 atan2_sse42(__m128 y, __m128 x) {
+    const __m128 sign_mask = _mm_set1_ps(-0.0f);
+    __m128 ax = _mm_andnot_ps(sign_mask, x);
+    __m128 ay = _mm_andnot_ps(sign_mask, y);
+    __m128 mx = _mm_max_ps(ax, ay);
+    __m128 mn = _mm_min_ps(ax, ay);
+    __m128 a = _mm_div_ps(mn, _mm_max_ps(mx, _mm_set1_ps(ATAN_TINY)));
+    __m128 s = _mm_mul_ps(a, a);
+
+    __m128 r = _mm_set1_ps(ATAN_C11);
+    r = _mm_add_ps(_mm_mul_ps(r, s), _mm_set1_ps(ATAN_C9));
+    r = _mm_add_ps(_mm_mul_ps(r, s), _mm_set1_ps(ATAN_C7));
+    r = _mm_add_ps(_mm_mul_ps(r, s), _mm_set1_ps(ATAN_C5));
+    r = _mm_add_ps(_mm_mul_ps(r, s), _mm_set1_ps(ATAN_C3));
+    r = _mm_add_ps(_mm_mul_ps(r, s), _mm_set1_ps(ATAN_C1));
+    r = _mm_mul_ps(r, a);
+
+    r = _mm_blendv_ps(r, _mm_sub_ps(_mm_set1_ps(HALF_PI), r), _mm_cmpgt_ps(ay, ax));
+    r = _mm_blendv_ps(r, _mm_sub_ps(_mm_set1_ps(PI_F), r), _mm_cmplt_ps(x, _mm_setzero_ps()));
+    return _mm_or_ps(r, _mm_and_ps(y, sign_mask));
+}
+
+TARGET_SSE42 static inline void sincos_sse42(__m128 x, __m128* s, __m128* c) {
+    __m128i j = _mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(TWO_OVER_PI)));
+    __m128 fj = _mm_cvtepi32_ps(j);
+    __m128 r = _mm_sub_ps(x, _mm_mul_ps(fj, _mm_set1_ps(PIO2_1)));
+    r = _mm_sub_ps(r, _mm_mul_ps(fj, _mm_set1_ps(PIO2_2)));
+    r = _mm_sub_ps(r, _mm_mul_ps(fj, _mm_set1_ps(PIO2_3)));
+    __m128 r2 = _mm_mul_ps(r, r);
+
+    __m128 sp = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(SIN_C3), r2), _mm_set1_ps(SIN_C2));
+    sp = _mm_add_ps(_mm_mul_ps(sp, r2), _mm_set1_ps(SIN_C1));
+    sp = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(sp, r2), r), r);
+
+    __m128 cp = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(COS_C3), r2), _mm_set1_ps(COS_C2));
+    cp = _mm_add_ps(_mm_mul_ps(cp, r2), _mm_set1_ps(COS_C1));
+    cp = _mm_mul_ps(cp, _mm_mul_ps(r2, r2));
+    cp = _mm_add_ps(_mm_sub_ps(_mm_set1_ps(1.0f), _mm_mul_ps(_mm_set1_ps(0.5f), r2)), cp);
+
+    __m128i one = _mm_set1_epi32(1);
+    __m128i two = _mm_set1_epi32(2);
+    __m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(j, one), one));
+    __m128 sv = _mm_blendv_ps(sp, cp, swap);
+    __m128 cv = _mm_blendv_ps(cp, sp, swap);
+    __m128 sin_sign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(j, two), 30));
+    __m128 cos_sign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(_mm_add_epi32(j, one), two), 30));
+    *s = _mm_xor_ps(sv, sin_sign);
+    *c = _mm_xor_ps(cv, cos_sign);
+}
+
+TARGET_SSE42 static void to_polar_sse42(const fftwf_complex* bins, float* mag, float* phase, size_t n) {
+    const float* in = (const float*)bins;
+    size_t k = 0;
+    for (; k + 4 <= n; k += 4) {
+        __m128 a = _mm_loadu_ps(in + 2 * k);
+        __m128 b = _mm_loadu_ps(in + 2 * k + 4);
+        __m128 re = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+        __m128 im = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+        _mm_storeu_ps(mag + k, _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(re, re), _mm_mul_ps(im, im))));
+        _mm_storeu_ps(phase + k, atan2_sse42(im, re));
+    }
+    to_polar_scalar(bins + k, mag + k, phase + k, n - k);
+}
+
+TARGET_SSE42 static void to_cartesian_sse42(const float* mag, const float* phase, fftwf_complex* bins, size_t n) {
+    float* out = (float*)bins;
+    size_t k = 0;
+    for (; k + 4 <= n; k += 4) {
+        __m128 m = _mm_loadu_ps(mag + k);
+        __m128 s, c;
+        sincos_sse42(_mm_loadu_ps(phase + k), &s, &c);
+        __m128 re = _mm_mul_ps(m, c);
+        __m128 im = _mm_mul_ps(m, s);
+        _mm_storeu_ps(out + 2 * k, _mm_unpacklo_ps(re, im));
+        _mm_storeu_ps(out + 2 * k + 4, _mm_unpackhi_ps(re, im));
+    }
+    to_cartesian_scalar(mag + k, phase + k, bins + k, n - k);
+}
+
+TARGET_SSE42 static void cross_correlate_sse42(const float* ref, const float* signal, size_t length, float* corr,
+                                               size_t lags) {
+    size_t k = 0;
+    for (; k + 4 <= lags; k += 4) {
+        __m128 acc = _mm_setzero_ps();
+        for (size_t i = 0; i < length; i++) {
+            acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(ref[i]), _mm_loadu_ps(signal + k + i)));
+        }
+        _mm_storeu_ps(corr + k, acc);
+    }
+    cross_correlate_c(ref, signal + k, length, corr + k, lags - k);
+}
+
+TARGET_SSE42 static void multiply_sse42(float* samples, const float* factors, size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        _mm_storeu_ps(samples + i, _mm_mul_ps(_mm_loadu_ps(samples + i), _mm_loadu_ps(factors + i)));
+    }
+    multiply_c(samples + i, factors + i, n - i);
+}
+
+TARGET_SSE42 static float sum_of_squares_sse42(const float* samples, size_t n) {
+    __m128 acc = _mm_setzero_ps();
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128 v = _mm_loadu_ps(samples + i);
+        acc = _mm_add_ps(acc, _mm_mul_ps(v, v));
+    }
+    acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+    acc = _mm_add_ss(acc, _mm_shuffle_ps(acc, acc, 1));
+    return _mm_cvtss_f32(acc) + sum_of_squares_c(samples + i, n - i);
+}
+
+TARGET_SSE42 static void gain_and_clip_sse42(float* samples, size_t n, float gain) {
+    const __m128 g = _mm_set1_ps(gain);
+    const __m128 hi = _mm_set1_ps(1.0f);
+    const __m128 lo = _mm_set1_ps(-1.0f);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128 v = _mm_mul_ps(_mm_loadu_ps(samples + i), g);
+        _mm_storeu_ps(samples + i, _mm_max_ps(_mm_min_ps(v, hi), lo));
+    }
+    gain_and_clip_c(samples + i, n - i, gain);
+}
+
+TARGET_SSE42 static inline float hmax_sse42(__m128 v) {
+    v = _mm_max_ps(v, _mm_movehl_ps(v, v));
+    return _mm_cvtss_f32(_mm_max_ss(v, _mm_shuffle_ps(v, v, 1)));
+}
+
+TARGET_SSE42 static inline float hsum_sse42(__m128 v) {
+    v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+    return _mm_cvtss_f32(_mm_add_ss(v, _mm_shuffle_ps(v, v, 1)));
+}
+
+TARGET_SSE42 static float gain_ramp_peak_sse42(const float* in, float* out, size_t n, float gain, float step,
+                                               float* energy) {
+    const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    const __m128 g = _mm_set1_ps(gain);
+    const __m128 s = _mm_set1_ps(step);
+    const __m128 near = _mm_set1_ps(HALF_NEAR);
+    const __m128 far = _mm_set1_ps(HALF_FAR);
+    __m128 index = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+    __m128 sum = _mm_setzero_ps();
+    __m128 peak = _mm_setzero_ps();
+    __m128 prev = _mm_setr_ps(0.0f, out[-3], out[-2], out[-1]);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128 x = _mm_loadu_ps(in + i);
+        __m128 y = _mm_mul_ps(x, _mm_add_ps(g, _mm_mul_ps(index, s)));
+        _mm_storeu_ps(out + i, y);
+        sum = _mm_add_ps(sum, _mm_mul_ps(x, x));
+        peak = _mm_max_ps(peak, _mm_and_ps(y, abs_mask));
+
+        // The earlier samples are shifted in from the previous vector rather
+        // than reloaded from out, which would stall on the store above
+        __m128i cur = _mm_castps_si128(y);
+        __m128i last = _mm_castps_si128(prev);
+        __m128 inner = _mm_add_ps(_mm_castsi128_ps(_mm_alignr_epi8(cur, last, 8)),
+                                  _mm_castsi128_ps(_mm_alignr_epi8(cur, last, 12)));
+        __m128 outer = _mm_add_ps(_mm_castsi128_ps(_mm_alignr_epi8(cur, last, 4)), y);
+        __m128 mid = _mm_sub_ps(_mm_mul_ps(near, inner), _mm_mul_ps(far, outer));
+        peak = _mm_max_ps(peak, _mm_and_ps(mid, abs_mask));
+        prev = y;
+        index = _mm_add_ps(index, _mm_set1_ps(4.0f));
+    }
+    *energy = hsum_sse42(sum);
+    float tail = ramp_peak_c(in, out, i, n, gain, step, energy);
+    return fmaxf(hmax_sse42(peak), fmaxf(tail, half_sample_peak_c(out, i, n)));
+}
+
+TARGET_SSE42 static void gain_ramp_clip_sse42(const float* in, float* out, size_t n, float gain, float step) {
+    const __m128 hi = _mm_set1_ps(1.0f);
+    const __m128 lo = _mm_set1_ps(-1.0f);
+    const __m128 g = _mm_set1_ps(gain);
+    const __m128 s = _mm_set1_ps(step);
+    __m128 index = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128 y = _mm_mul_ps(_mm_loadu_ps(in + i), _mm_add_ps(g, _mm_mul_ps(index, s)));
+        _mm_storeu_ps(out + i, _mm_max_ps(_mm_min_ps(y, hi), lo));
+        index = _mm_add_ps(index, _mm_set1_ps(4.0f));
+    }
+    ramp_clip_c(in, out, i, n, gain, step);
+}
+
+/* AVX2 + FMA: eight lanes. */
+
+TARGET_AVX2 static inline __m256 atan2_avx2(__m256 y, __m256 x) {
+    const __m256 sign_mask = _mm256_set1_ps(-0.0f);
+    __m256 ax = _mm256_andnot_ps(sign_mask, x);
+    __m256 ay = _mm256_andnot_ps(sign_mask, y);
+    __m256 mx = _mm256_max_ps(ax, ay);
+    __m256 mn = _mm256_min_ps(ax, ay);
+    __m256 a = _mm256_div_ps(mn, _mm256_max_ps(mx, _mm256_set1_ps(ATAN_TINY)));
+    __m256 s = _mm256_mul_ps(a, a);
+
+    __m256 r = _mm256_set1_ps(ATAN_C11);
+    r = _mm256_fmadd_ps(r, s, _mm256_set1_ps(ATAN_C9));
+    r = _mm256_fmadd_ps(r, s, _mm256_set1_ps(ATAN_C7));
+    r = _mm256_fmadd_ps(r, s, _mm256_set1_ps(ATAN_C5));
+    r = _mm256_fmadd_ps(r, s, _mm256_set1_ps(ATAN_C3));
+    r = _mm256_fmadd_ps(r, s, _mm256_set1_ps(ATAN_C1));
+    r = _mm256_mul_ps(r, a);
+
+    __m256 swap = _mm256_cmp_ps(ay, ax, _CMP_GT_OQ);
+    r = _mm256_blendv_ps(r, _mm256_sub_ps(_mm256_set1_ps(HALF_PI), r), swap);
+    __m256 xneg = _mm256_cmp_ps(x, _mm256_setzero_ps(), _CMP_LT_OQ);
+    r = _mm256_blendv_ps(r, _mm256_sub_ps(_mm256_set1_ps(PI_F), r), xneg);
+    return _mm256_or_ps(r, _mm256_and_ps(y, sign_mask));
+}
+
+TARGET_AVX2 static inline void sincos_avx2(__m256 x, __m256* s, __m256* c) {
+    __m256i j = _mm256_cvtps_epi32(_mm256_mul_ps(x, _mm256_set1_ps(TWO_OVER_PI)));
+    __m256 fj = _mm256_cvtepi32_ps(j);
+    __m256 r = _mm256_fnmadd_ps(fj, _mm256_set1_ps(PIO2_1), x);
+    r = _mm256_fnmadd_ps(fj, _mm256_set1_ps(PIO2_2), r);
+    r = _mm256_fnmadd_ps(fj, _mm256_set1_ps(PIO2_3), r);
+    __m256 r2 = _mm256_mul_ps(r, r);
+
+    __m256 sp = _mm256_fmadd_ps(_mm256_set1_ps(SIN_C3), r2, _mm256_set1_ps(SIN_C2));
+    sp = _mm256_fmadd_ps(sp, r2, _mm256_set1_ps(SIN_C1));
+    sp = _mm256_fmadd_ps(_mm256_mul_ps(sp, r2), r, r);
+
+    __m256 cp = _mm256_fmadd_ps(_mm256_set1_ps(COS_C3), r2, _mm256_set1_ps(COS_C2));
+    cp = _mm256_fmadd_ps(cp, r2, _mm256_set1_ps(COS_C1));
+    cp = _mm256_mul_ps(cp, _mm256_mul_ps(r2, r2));
+    cp = _mm256_add_ps(_mm256_fnmadd_ps(_mm256_set1_ps(0.5f), r2, _mm256_set1_ps(1.0f)), cp);
+
+    __m256i one = _mm256_set1_epi32(1);
+    __m256i two = _mm256_set1_epi32(2);
+    __m256 swap = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(j, one), one));
+    __m256 sv = _mm256_blendv_ps(sp, cp, swap);
+    __m256 cv = _mm256_blendv_ps(cp, sp, swap);
+    __m256 sin_sign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(j, two), 30));
+    __m256 cos_sign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(_mm256_add_epi32(j, one), two), 30));
+    *s = _mm256_xor_ps(sv, sin_sign);
+    *c = _mm256_xor_ps(cv, cos_sign);
+}
+
+TARGET_AVX2 static void to_polar_avx2(const fftwf_complex* bins, float* mag, float* phase, size_t n) {
+    const float* in = (const float*)bins;
+    size_t k = 0;
+    for (; k + 8 <= n; k += 8) {
+        __m256 a = _mm256_loadu_ps(in + 2 * k);
+        __m256 b = _mm256_loadu_ps(in + 2 * k + 8);
+        __m256 re = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(_mm256_shuffle_ps(a, b, 0x88)), 0xD8));
+        __m256 im = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(_mm256_shuffle_ps(a, b, 0xDD)), 0xD8));
+        _mm256_storeu_ps(mag + k, _mm256_sqrt_ps(_mm256_fmadd_ps(re, re, _mm256_mul_ps(im, im))));
+        _mm256_storeu_ps(phase + k, atan2_avx2(im, re));
+    }
+    to_polar_scalar(bins + k, mag + k, phase + k, n - k);
+}
+
+TARGET_AVX2 static void to_cartesian_avx2(const float* mag, const float* phase, fftwf_complex* bins, size_t n) {
+    float* out = (float*)bins;
+    size_t k = 0;
+    for (; k + 8 <= n; k += 8) {
+        __m256 m = _mm256_loadu_ps(mag + k);
+        __m256 s, c;
+        sincos_avx2(_mm256_loadu_ps(phase + k), &s, &c);
+        __m256 re = _mm256_mul_ps(m, c);
+        __m256 im = _mm256_mul_ps(m, s);
+        __m256 lo = _mm256_unpacklo_ps(re, im);
+        __m256 hi = _mm256_unpackhi_ps(re, im);
+        _mm256_storeu_ps(out + 2 * k, _mm256_permute2f128_ps(lo, hi, 0x20));
+        _mm256_storeu_ps(out + 2 * k + 8, _mm256_permute2f128_ps(lo, hi, 0x31));
+    }
+    to_cartesian_scalar(mag + k, phase + k, bins + k, n - k);
+}
+
+TARGET_AVX2 static void cross_correlate_avx2(const float* ref, const float* signal, size_t length, float* corr,
+                                             size_t lags) {
+    size_t k = 0;
+    for (; k + 8 <= lags; k += 8) {
+        __m256 acc = _mm256_setzero_ps();
+        for (size_t i = 0; i < length; i++) {
+            acc = _mm256_fmadd_ps(_mm256_set1_ps(ref[i]), _mm256_loadu_ps(signal + k + i), acc);
+        }
+        _mm256_storeu_ps(corr + k, acc);
+    }
+    cross_correlate_c(ref, signal + k, length, corr + k, lags - k);
+}
+
+TARGET_AVX2 static void multiply_avx2(float* samples, const float* factors, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        _mm256_storeu_ps(samples + i, _mm256_mul_ps(_mm256_loadu_ps(samples + i), _mm256_loadu_ps(factors + i)));
+    }
+    multiply_c(samples + i, factors + i, n - i);
+}
+
+TARGET_AVX2 static float sum_of_squares_avx2(const float* samples, size_t n) {
+    __m256 acc = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 v = _mm256_loadu_ps(samples + i);
+        acc = _mm256_fmadd_ps(v, v, acc);
+    }
+    __m128 half = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+    half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+    half = _mm_add_ss(half, _mm_shuffle_ps(half, half, 1));
+    return _mm_cvtss_f32(half) + sum_of_squares_c(samples + i, n - i);
+}
+
+TARGET_AVX2 static void gain_and_clip_avx2(float* samples, size_t n, float gain) {
+    const __m256 g = _mm256_set1_ps(gain);
+    const __m256 hi = _mm256_set1_ps(1.0f);
+    const __m256 lo = _mm256_set1_ps(-1.0f);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 v = _mm256_mul_ps(_mm256_loadu_ps(samples + i), g);
+        _mm256_storeu_ps(samples + i, _mm256_max_ps(_mm256_min_ps(v, hi), lo));
+    }
+    gain_and_clip_c(samples + i, n - i, gain);
+}
+
+TARGET_AVX2 static float gain_ramp_peak_avx2(const float* in, float* out, size_t n, float gain, float step,
+                                             float* energy) {
+    const __m256 abs_mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+    const __m256 g = _mm256_set1_ps(gain);
+    const __m256 s = _mm256_set1_ps(step);
+    const __m256 near = _mm256_set1_ps(HALF_NEAR);
+    const __m256 far = _mm256_set1_ps(HALF_FAR);
+    __m256 index = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+    __m256 sum = _mm256_setzero_ps();
+    __m256 peak = _mm256_setzero_ps();
+    __m256 prev = _mm256_setr_ps(0.0f, 0.0f, 0.0f, 0.0f, 0.0f, out[-3], out[-2], out[-1]);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 x = _mm256_loadu_ps(in + i);
+        __m256 y = _mm256_mul_ps(x, _mm256_fmadd_ps(index, s, g));
+        _mm256_storeu_ps(out + i, y);
+        sum = _mm256_fmadd_ps(x, x, sum);
+        peak = _mm256_max_ps(peak, _mm256_and_ps(y, abs_mask));
+
+        // alignr shifts within 128-bit lanes, so pair each lane with the one before it
+        __m256i cur = _mm256_castps_si256(y);
+        __m256i last = _mm256_castps_si256(_mm256_permute2f128_ps(prev, y, 0x21));
+        __m256 inner = _mm256_add_ps(_mm256_castsi256_ps(_mm256_alignr_epi8(cur, last, 8)),
+                                     _mm256_castsi256_ps(_mm256_alignr_epi8(cur, last, 12)));
+        __m256 outer = _mm256_add_ps(_mm256_castsi256_ps(_mm256_alignr_epi8(cur, last, 4)), y);
+        __m256 mid = _mm256_fmsub_ps(near, inner, _mm256_mul_ps(far, outer));
+        peak = _mm256_max_ps(peak, _mm256_and_ps(mid, abs_mask));
+        prev = y;
+        index = _mm256_add_ps(index, _mm256_set1_ps(8.0f));
+    }
+    *energy = hsum_sse42(_mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1)));
+    float tail = ramp_peak_c(in, out, i, n, gain, step, energy);
+    float vector_peak = hmax_sse42(_mm_max_ps(_mm256_castps256_ps128(peak), _mm256_extractf128_ps(peak, 1)));
+    return fmaxf(vector_peak, fmaxf(tail, half_sample_peak_c(out, i, n)));
+}
+
+TARGET_AVX2 static void gain_ramp_clip_avx2(const float* in, float* out, size_t n, float gain, float step) {
+    const __m256 hi = _mm256_set1_ps(1.0f);
+    const __m256 lo = _mm256_set1_ps(-1.0f);
+    const __m256 g = _mm256_set1_ps(gain);
+    const __m256 s = _mm256_set1_ps(step);
+    __m256 index = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 y = _mm256_mul_ps(_mm256_loadu_ps(in + i), _mm256_fmadd_ps(index, s, g));
+        _mm256_storeu_ps(out + i, _mm256_max_ps(_mm256_min_ps(y, hi), lo));
+        index = _mm256_add_ps(index, _mm256_set1_ps(8.0f));
+    }
+    ramp_clip_c(in, out, i, n, gain, step);
+}
+
+/* AVX-512 F + DQ: sixteen lanes, with mask registers instead of blends. */
+
+TARGET_AVX512 static inline __m512 atan2_avx512(__m512 y, __m512 x) {
+    const __m512 sign_mask = _mm512_set1_ps(-0.0f);
+    __m512 ax = _mm512_andnot_ps(sign_mask, x);
+    __m512 ay = _mm512_andnot_ps(sign_mask, y);
+    __m512 mx = _mm512_max_ps(ax, ay);
+    __m512 mn = _mm512_min_ps(ax, ay);
+    __m512 a = _mm512_div_ps(mn, _mm512_max_ps(mx, _mm512_set1_ps(ATAN_TINY)));
+    __m512 s = _mm512_mul_ps(a, a);
+
+    __m512 r = _mm512_set1_ps(ATAN_C11);
+    r = _mm512_fmadd_ps(r, s, _mm512_set1_ps(ATAN_C9));
+    r = _mm512_fmadd_ps(r, s, _mm512_set1_ps(ATAN_C7));
+    r = _mm512_fmadd_ps(r, s, _mm512_set1_ps(ATAN_C5));
+    r = _mm512_fmadd_ps(r, s, _mm512_set1_ps(ATAN_C3));
+    r = _mm512_fmadd_ps(r, s, _mm512_set1_ps(ATAN_C1));
+    r = _mm512_mul_ps(r, a);
+
+    __mmask16 swap = _mm512_cmp_ps_mask(ay, ax, _CMP_GT_OQ);
+    r = _mm512_mask_sub_ps(r, swap, _mm512_set1_ps(HALF_PI), r);
+    __mmask16 xneg = _mm512_cmp_ps_mask(x, _mm512_setzero_ps(), _CMP_LT_OQ);
+    r = _mm512_mask_sub_ps(r, xneg, _mm512_set1_ps(PI_F), r);
+    return _mm512_or_ps(r, _mm512_and_ps(y, sign_mask));
+}
+
+TARGET_AVX512 static inline void sincos_avx512(__m512 x, __m512* s, __m512* c) {
+    __m512i j = _mm512_cvtps_epi32(_mm512_mul_ps(x, _mm512_set1_ps(TWO_OVER_PI)));
+    __m512 fj = _mm512_cvtepi32_ps(j);
+    __m512 r = _mm512_fnmadd_ps(fj, _mm512_set1_ps(PIO2_1), x);
+    r = _mm512_fnmadd_ps(fj, _mm512_set1_ps(PIO2_2), r);
+    r = _mm512_fnmadd_ps(fj, _mm512_set1_ps(PIO2_3), r);
+    __m512 r2 = _mm512_mul_ps(r, r);
+
+    __m512 sp = _mm512_fmadd_ps(_mm512_set1_ps(SIN_C3), r2, _mm512_set1_ps(SIN_C2));
+    sp = _mm512_fmadd_ps(sp, r2, _mm512_set1_ps(SIN_C1));
+    sp = _mm512_fmadd_ps(_mm512_mul_ps(sp, r2), r, r);
+
+    __m512 cp = _mm512_fmadd_ps(_mm512_set1_ps(COS_C3), r2, _mm512_set1_ps(COS_C2));
+    cp = _mm512_fmadd_ps(cp, r2, _mm512_set1_ps(COS_C1));
+    cp = _mm512_mul_ps(cp, _mm512_mul_ps(r2, r2));
+    cp = _mm512_add_ps(_mm512_fnmadd_ps(_mm512_set1_ps(0.5f), r2, _mm512_set1_ps(1.0f)), cp);
+
+    __m512i one = _mm512_set1_epi32(1);
+    __m512i two = _mm512_set1_epi32(2);
+    __mmask16 swap = _mm512_test_epi32_mask(j, one);
+    __m512 sv = _mm512_mask_blend_ps(swap, sp, cp);
+    __m512 cv = _mm512_mask_blend_ps(swap, cp, sp);
+    __m512 sin_sign = _mm512_castsi512_ps(_mm512_slli_epi32(_mm512_and_si512(j, two), 30));
+    __m512 cos_sign = _mm512_castsi512_ps(_mm512_slli_epi32(_mm512_and_si512(_mm512_add_epi32(j, one), two), 30));
+    *s = _mm512_xor_ps(sv, sin_sign);
+    *c = _mm512_xor_ps(cv, cos_sign);
+}
+
+TARGET_AVX512 static void to_polar_avx512(const fftwf_complex* bins, float* mag, float* phase, size_t n) {
+    const float* in = (const float*)bins;
+    const __m512i even = _mm512_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14, 16, 18, 20, 22, 24, 26, 28, 30);
+    const __m512i odd = _mm512_setr_epi32(1, 3, 5, 7, 9, 11, 13, 15, 17, 19, 21, 23, 25, 27, 29, 31);
+    size_t k = 0;
+    for (; k + 16 <= n; k += 16) {
+        __m512 a = _mm512_loadu_ps(in + 2 * k);
+        __m512 b = _mm512_loadu_ps(in + 2 * k + 16);
+        __m512 re = _mm512_permutex2var_ps(a, even, b);
+        __m512 im = _mm512_permutex2var_ps(a, odd, b);
+        _mm512_storeu_ps(mag + k, _mm512_sqrt_ps(_mm512_fmadd_ps(re, re, _mm512_mul_ps(im, im))));
+        _mm512_storeu_ps(phase + k, atan2_avx512(im, re));
+    }
+    to_polar_scalar(bins + k, mag + k, phase + k, n - k);
+}
+
+TARGET_AVX512 static void to_cartesian_avx512(const float* mag, const float* phase, fftwf_complex* bins, size_t n) {
+    float* out = (float*)bins;
+    const __m512i low = _mm512_setr_epi32(0, 16, 1, 17, 2, 18, 3, 19, 4, 20, 5, 21, 6, 22, 7, 23);
+    const __m512i high = _mm512_setr_epi32(8, 24, 9, 25, 10, 26, 11, 27, 12, 28, 13, 29, 14, 30, 15, 31);
+    size_t k = 0;
+    for (; k + 16 <= n; k += 16) {
+        __m512 m = _mm512_loadu_ps(mag + k);
+        __m512 s, c;
+        sincos_avx512(_mm512_loadu_ps(phase + k), &s, &c);
+        __m512 re = _mm512_mul_ps(m, c);
+        __m512 im = _mm512_mul_ps(m, s);
+        _mm512_storeu_ps(out + 2 * k, _mm512_permutex2var_ps(re, low, im));
+        _mm512_storeu_ps(out + 2 * k + 16, _mm512_permutex2var_ps(re, high, im));
+    }
+    to_cartesian_scalar(mag + k, phase + k, bins + k, n - k);
+}
+
+TARGET_AVX512 static void cross_correlate_avx512(const float* ref, const float* signal, size_t length, float* corr,
+                                                 size_t lags) {
+    size_t k = 0;
+    for (; k + 16 <= lags; k += 16) {
+        __m512 acc = _mm512_setzero_ps();
+        for (size_t i = 0; i < length; i++) {
+            acc = _mm512_fmadd_ps(_mm512_set1_ps(ref[i]), _mm512_loadu_ps(signal + k + i), acc);
+        }
+        _mm512_storeu_ps(corr + k, acc);
+    }
+    cross_correlate_c(ref, signal + k, length, corr + k, lags - k);
+}
+
+TARGET_AVX512 static void multiply_avx512(float* samples, const float* factors, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        _mm512_storeu_ps(samples + i, _mm512_mul_ps(_mm512_loadu_ps(samples + i), _mm512_loadu_ps(factors + i)));
+    }
+    multiply_c(samples + i, factors + i, n - i);
+}
+
+TARGET_AVX512 static float sum_of_squares_avx512(const float* samples, size_t n) {
+    __m512 acc = _mm512_setzero_ps();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m512 v = _mm512_loadu_ps(samples + i);
+        acc = _mm512_fmadd_ps(v, v, acc);
+    }
+    return _mm512_reduce_add_ps(acc) + sum_of_squares_c(samples + i, n - i);
+}
+
+TARGET_AVX512 static void gain_and_clip_avx512(float* samples, size_t n, float gain) {
+    const __m512 g = _mm512_set1_ps(gain);
+    const __m512 hi = _mm512_set1_ps(1.0f);
+    const __m512 lo = _mm512_set1_ps(-1.0f);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m512 v = _mm512_mul_ps(_mm512_loadu_ps(samples + i), g);
+        _mm512_storeu_ps(samples + i, _mm512_max_ps(_mm512_min_ps(v, hi), lo));
+    }
+    gain_and_clip_c(samples + i, n - i, gain);
+}
+
+TARGET_AVX512 static float gain_ramp_peak_avx512(const float* in, float* out, size_t n, float gain, float step,
+                                                 float* energy) {
+    const __m512 g = _mm512_set1_ps(gain);
+    const __m512 s = _mm512_set1_ps(step);
+    __m512 index = _mm512_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f,
+                                  8.0f, 9.0f, 10.0f, 11.0f, 12.0f, 13.0f, 14.0f, 15.0f);
+    __m512 sum = _mm512_setzero_ps();
+    __m512 peak = _mm512_setzero_ps();
+    const __m512 near = _mm512_set1_ps(HALF_NEAR);
+    const __m512 far = _mm512_set1_ps(HALF_FAR);
+    // Only the top three lanes are read, so the lanes before the history never fault
+    __m512i prev = _mm512_castps_si512(_mm512_maskz_loadu_ps(0xe000, out - 16));
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m512 x = _mm512_loadu_ps(in + i);
+        __m512 y = _mm512_mul_ps(x, _mm512_fmadd_ps(index, s, g));
+        _mm512_storeu_ps(out + i, y);
+        sum = _mm512_fmadd_ps(x, x, sum);
+        peak = _mm512_max_ps(peak, _mm512_abs_ps(y));
+
+        __m512i cur = _mm512_castps_si512(y);
+        __m512 inner = _mm512_add_ps(_mm512_castsi512_ps(_mm512_alignr_epi32(cur, prev, 14)),
+                                     _mm512_castsi512_ps(_mm512_alignr_epi32(cur, prev, 15)));
+        __m512 outer = _mm512_add_ps(_mm512_castsi512_ps(_mm512_alignr_epi32(cur, prev, 13)), y);
+        __m512 mid = _mm512_fmsub_ps(near, inner, _mm512_mul_ps(far, outer));
+        peak = _mm512_max_ps(peak, _mm512_abs_ps(mid));
+        prev = cur;
+        index = _mm512_add_ps(index, _mm512_set1_ps(16.0f));
+    }
+    *energy = _mm512_reduce_add_ps(sum);
+    float tail = ramp_peak_c(in, out, i, n, gain, step, energy);
+    return fmaxf(_mm512_reduce_max_ps(peak), fmaxf(tail, half_sample_peak_c(out, i, n)));
+}
+
+TARGET_AVX512 static void gain_ramp_clip_avx512(const float* in, float* out, size_t n, float gain, float step) {
+    const __m512 hi = _mm512_set1_ps(1.0f);
+    const __m512 lo = _mm512_set1_ps(-1.0f);
+    const __m512 g = _mm512_set1_ps(gain);
+    const __m512 s = _mm512_set1_ps(step);
+    __m512 index = _mm512_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f,
+                                  8.0f, 9.0f, 10.0f, 11.0f, 12.0f, 13.0f, 14.0f, 15.0f);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m512 y = _mm512_mul_ps(_mm512_loadu_ps(in + i), _mm512_fmadd_ps(index, s, g));
+        _mm512_storeu_ps(out + i, _mm512_max_ps(_mm512_min_ps(y, hi), lo));
+        index = _mm512_add_ps(index, _mm512_set1_ps(16.0f));
+    }
+    ramp_clip_c(in, out, i, n, gain, step);
+}
+
+#endif
+
+#if SPECTRAL_NEON
+
+/* AArch64 Advanced SIMD: four lanes with FMA, part of the baseline. */
+
+static inline float32x4_t atan2_neon(float32x4_t y, float32x4_t x) {
+    float32x4_t ax = vabsq_f32(x);
+    float32x4_t ay = vabsq_f32(y);
+    float32x4_t mx = vmaxq_f32(ax, ay);
+    float32x4_t mn = vminq_f32(ax, ay);
+    float32x4_t a = vdivq_f32(mn, vmaxq_f32(mx, vdupq_n_f32(ATAN_TINY)));
+    float32x4_t s = vmulq_f32(a, a);
+
+    float32x4_t r = vdupq_n_f32(ATAN_C11);
+    r = vfmaq_f32(vdupq_n_f32(ATAN_C9), r, s);
+    r = vfmaq_f32(vdupq_n_f32(ATAN_C7), r, s);
+    r = vfmaq_f32(vdupq_n_f32(ATAN_C5), r, s);
+    r = vfmaq_f32(vdupq_n_f32(ATAN_C3), r, s);
+    r = vfmaq_f32(vdupq_n_f32(ATAN_C1), r, s);
+    r = vmulq_f32(r, a);
+
+    r = vbslq_f32(vcgtq_f32(ay, ax), vsubq_f32(vdupq_n_f32(HALF_PI), r), r);
+    r = vbslq_f32(vcltq_f32(x, vdupq_n_f32(0.0f)), vsubq_f32(vdupq_n_f32(PI_F), r), r);
+    uint32x4_t sign = vandq_u32(vreinterpretq_u32_f32(y), vdupq_n_u32(0x80000000u));
+    return vreinterpretq_f32_u32(vorrq_u32(vreinterpretq_u32_f32(r), sign));
+}
+
+static inline void sincos_neon(float32x4_t x, float32x4_t* s, float32x4_t* c) {
+    int32x4_t j = vcvtnq_s32_f32(vmulq_n_f32(x, TWO_OVER_PI));
+    float32x4_t fj = vcvtq_f32_s32(j);
+    float32x4_t r = vfmsq_f32(x, fj, vdupq_n_f32(PIO2_1));
+    r = vfmsq_f32(r, fj, vdupq_n_f32(PIO2_2));
+    r = vfmsq_f32(r, fj, vdupq_n_f32(PIO2_3));
+    float32x4_t r2 = vmulq_f32(r, r);
+
+    float32x4_t sp = vfmaq_f32(vdupq_n_f32(SIN_C2), vdupq_n_f32(SIN_C3), r2);
+    sp = vfmaq_f32(vdupq_n_f32(SIN_C1), sp, r2);
+    sp = vfmaq_f32(r, vmulq_f32(sp, r2), r);
+
+    float32x4_t cp = vfmaq_f32(vdupq_n_f32(COS_C2), vdupq_n_f32(COS_C3), r2);
+    cp = vfmaq_f32(vdupq_n_f32(COS_C1), cp, r2);
+    cp = vmulq_f32(cp, vmulq_f32(r2, r2));
+    cp = vaddq_f32(vfmsq_f32(vdupq_n_f32(1.0f), vdupq_n_f32(0.5f), r2), cp);
+
+    uint32x4_t ju = vreinterpretq_u32_s32(j);
+    uint32x4_t swap = vtstq_u32(ju, vdupq_n_u32(1));
+    float32x4_t sv = vbslq_f32(swap, cp, sp);
+    float32x4_t cv = vbslq_f32(swap, sp, cp);
+    uint32x4_t sin_sign = vshlq_n_u32(vandq_u32(ju, vdupq_n_u32(2)), 30);
+    uint32x4_t cos_sign = vshlq_n_u32(vandq_u32(vaddq_u32(ju, vdupq_n_u32(1)), vdupq_n_u32(2)), 30);
+    *s = vreinterpretq_f32_u32(veorq_u32(vreinterpretq_u32_f32(sv), sin_sign));
+    *c = vreinterpretq_f32_u32(veorq_u32(vreinterpretq_u32_f32(cv), cos_sign));
+}
+
+static void to_polar_neon(const fftwf_complex* bins, float* mag, float* phase, size_t n) {
+    const float* in = (const float*)bins;
+    size_t k = 0;
+    for (; k + 4 <= n; k += 4) {
+        float32x4x2_t v = vld2q_f32(in + 2 * k);
+        float32x4_t re = v.val[0];
+        float32x4_t im = v.val[1];
+        vst1q_f32(mag + k, vsqrtq_f32(vfmaq_f32(vmulq_f32(im, im), re, re)));
+        vst1q_f32(phase + k, atan2_neon(im, re));
+    }
+    to_polar_scalar(bins + k, mag + k, phase + k, n - k);
+}
+
+static void to_cartesian_neon(const float* mag, const float* phase, fftwf_complex* bins, size_t n) {
+    float* out = (float*)bins;
+    size_t k = 0;
+    for (; k + 4 <= n; k += 4) {
+        float32x4_t m = vld1q_f32(mag + k);
+        float32x4_t s, c;
+        sincos_neon(vld1q_f32(phase + k), &s, &c);
+        float32x4x2_t v;
+        v.val[0] = vmulq_f32(m, c);
+        v.val[1] = vmulq_f32(m, s);
+        vst2q_f32(out + 2 * k, v);
+    }
+    to_cartesian_scalar(mag + k, phase + k, bins + k, n - k);
+}
+
+static void cross_correlate_neon(const float* ref, const float* signal, size_t length, float* corr, size_t lags) {
+    size_t k = 0;
+    for (; k + 4 <= lags; k += 4) {
+        float32x4_t acc = vdupq_n_f32(0.0f);
+        for (size_t i = 0; i < length; i++) {
+            acc = vfmaq_n_f32(acc, vld1q_f32(signal + k + i), ref[i]);
+        }
+        vst1q_f32(corr + k, acc);
+    }
+    cross_correlate_c(ref, signal + k, length, corr + k, lags - k);
+}
+
+static void multiply_neon(float* samples, const float* factors, size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        vst1q_f32(samples + i, vmulq_f32(vld1q_f32(samples + i), vld1q_f32(factors + i)));
+    }
+    multiply_c(samples + i, factors + i, n - i);
+}
+
+static float sum_of_squares_neon(const float* samples, size_t n) {
+    float32x4_t acc = vdupq_n_f32(0.0f);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        float32x4_t v = vld1q_f32(samples + i);
+        acc = vfmaq_f32(acc, v, v);
+    }
+    return vaddvq_f32(acc) + sum_of_squares_c(samples + i, n - i);
+}
+
+static void gain_and_clip_neon(float* samples, size_t n, float gain) {
+    const float32x4_t hi = vdupq_n_f32(1.0f);
+    const float32x4_t lo = vdupq_n_f32(-1.0f);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        float32x4_t v = vmulq_n_f32(vld1q_f32(samples + i), gain);
+        vst1q_f32(samples + i, vmaxq_f32(vminq_f32(v, hi), lo));
+    }
+    gain_and_clip_c(samples + i, n - i, gain);
+}
+
+static float gain_ramp_peak_neon(const float* in, float* out, size_t n, float gain, float step, float* energy) {
+    const float32x4_t g = vdupq_n_f32(gain);
+    const float32x4_t s = vdupq_n_f32(step);
+    const float lanes[4] = { 0.0f, 1.0f, 2.0f, 3.0f };
+    float32x4_t index = vld1q_f32(lanes);
+    float32x4_t sum = vdupq_n_f32(0.0f);
+    float32x4_t peak = vdupq_n_f32(0.0f);
+    const float history[4] = { 0.0f, out[-3], out[-2], out[-1] };
+    float32x4_t prev = vld1q_f32(history);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        float32x4_t x = vld1q_f32(in + i);
+        float32x4_t y = vmulq_f32(x, vfmaq_f32(g, index, s));
+        vst1q_f32(out + i, y);
+        sum = vfmaq_f32(sum, x, x);
+        peak = vmaxq_f32(peak, vabsq_f32(y));
+
+        float32x4_t inner = vaddq_f32(vextq_f32(prev, y, 2), vextq_f32(prev, y, 3));
+        float32x4_t outer = vaddq_f32(vextq_f32(prev, y, 1), y);
+        float32x4_t mid = vfmsq_n_f32(vmulq_n_f32(inner, HALF_NEAR), outer, HALF_FAR);
+        peak = vmaxq_f32(peak, vabsq_f32(mid));
+        prev = y;
+        index = vaddq_f32(index, vdupq_n_f32(4.0f));
+    }
+    *energy = vaddvq_f32(sum);
+    float tail = ramp_peak_c(in, out, i, n, gain, step, energy);
+    return fmaxf(vmaxvq_f32(peak), fmaxf(tail, half_sample_peak_c(out, i, n)));
+}
+
+static void gain_ramp_clip_neon(const float* in, float* out, size_t n, float gain, float step) {
+    const float32x4_t hi = vdupq_n_f32(1.0f);
+    const float32x4_t lo = vdupq_n_f32(-1.0f);
+    const float32x4_t g = vdupq_n_f32(gain);
+    const float32x4_t s = vdupq_n_f32(step);
+    const float lanes[4] = { 0.0f, 1.0f, 2.0f, 3.0f };
+    float32x4_t index = vld1q_f32(lanes);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        float32x4_t y = vmulq_f32(vld1q_f32(in + i), vfmaq_f32(g, index, s));
+        vst1q_f32(out + i, vmaxq_f32(vminq_f32(y, hi), lo));
+        index = vaddq_f32(index, vdupq_n_f32(4.0f));
+    }
+    ramp_clip_c(in, out, i, n, gain, step);
+}
+
+#endif
+
+// Sets this build has no kernels for stay zeroed
+static const KernelTable kernel_tables[CPU_ISA_COUNT] = {
+    [CPU_ISA_SCALAR] = { to_polar_scalar, to_cartesian_scalar, cross_correlate_c,
+                         multiply_c, sum_of_squares_c, gain_and_clip_c,
+                         gain_ramp_peak_c, gain_ramp_clip_c },
+#if SPECTRAL_X86
+    [CPU_ISA_SSE42] = { to_polar_sse42, to_cartesian_sse42, cross_correlate_sse42,
+                        multiply_sse42, sum_of_squares_sse42, gain_and_clip_sse42,
+                        gain_ramp_peak_sse42, gain_ramp_clip_sse42 },
+    [CPU_ISA_AVX2] = { to_polar_avx2, to_cartesian_avx2, cross_correlate_avx2,
+                       multiply_avx2, sum_of_squares_avx2, gain_and_clip_avx2,
+                       gain_ramp_peak_avx2, gain_ramp_clip_avx2 },
+    [CPU_ISA_AVX512] = { to_polar_avx512, to_cartesian_avx512, cross_correlate_avx512,
+                         multiply_avx512, sum_of_squares_avx512, gain_and_clip_avx512,
+                         gain_ramp_peak_avx512, gain_ramp_clip_avx512 },
+#endif
+#if SPECTRAL_NEON
+    [CPU_ISA_NEON] = { to_polar_neon, to_cartesian_neon, cross_correlate_neon,
+                       multiply_neon, sum_of_squares_neon, gain_and_clip_neon,
+                       gain_ramp_peak_neon, gain_ramp_clip_neon },
+#endif
+};
+
+// Written once by spectral_kernels_init() before any DSP thread starts
+static CpuIsa active_isa = CPU_ISA_SCALAR;
+static const KernelTable* kernels = &kernel_tables[CPU_ISA_SCALAR];
+
+/**
+ * Selects the kernel variants every DSP call uses from now on. Call it once
+ * at startup, before any pipeline runs; until then the portable C kernels
+ * are used.
+ *
+ * @param isa The instruction set, or CPU_ISA_AUTO for the best one the CPU
+ *            supports.
+ * @return 0 on success, -1 if this CPU or build cannot run the set.
+ */
+int spectral_kernels_init(CpuIsa isa) {
+    CpuIsa best = cpu_detect_isa();
+    if (isa == CPU_ISA_AUTO) isa = best;
+    if (isa < 0 || isa >= CPU_ISA_COUNT || !cpu_isa_supported(isa) || !kernel_tables[isa].to_polar) {
+        printf("Error: The %s kernels cannot run on this CPU (best: %s).\n", cpu_isa_name(isa), cpu_isa_name(best));
+        return -1;
+    }
+
+    active_isa = isa;
+    kernels = &kernel_tables[isa];
+    return 0;
+}
+
+/**
+ * @return The name of the kernel variants in use.
+ */
+const char* spectral_kernels_isa(void) {
+    return cpu_isa_name(active_isa);
+}
+
+/**
+ * Converts FFT bins to magnitude and phase.
+ *
+ * @param bins The complex bins.
+ * @param mag Receives the magnitude of each bin.
+ * @param phase Receives the phase of each bin in [-pi, pi].
+ * @param n The number of bins.
+ */
+void cartesian_to_polar(const fftwf_complex* bins, float* mag, float* phase, size_t n) {
+    kernels->to_polar(bins, mag, phase, n);
+}
+
+/**
+ * Converts magnitude and phase back to FFT bins.
+ *
+ * @param mag The magnitude of each bin.
+ * @param phase The phase of each bin.
+ * @param bins Receives the complex bins.
+ * @param n The number of bins.
+ */
+void polar_to_cartesian(const float* mag, const float* phase, fftwf_complex* bins, size_t n) {
+    kernels->to_cartesian(mag, phase, bins, n);
+}
+
+/**
+ * Reference conversion of FFT bins to magnitude and phase using libm.
+ *
+ * @param bins The complex bins.
+ * @param mag Receives the magnitude of each bin.
+ * @param phase Receives the phase of each bin in [-pi, pi].
+ * @param n The number of bins.
+ */
+void cartesian_to_polar_scalar(const fftwf_complex* bins, float* mag, float* phase, size_t n) {
+    for (size_t k = 0; k < n; k++) {
+        float re = crealf(bins[k]);
+        float im = cimagf(bins[k]);
+        mag[k] = sqrtf(re * re + im * im);
+        phase[k] = atan2f(im, re);
+    }
+}
+
+/**
+ * Reference conversion of magnitude and phase back to FFT bins using libm.
+ *
+ * @param mag The magnitude of each bin.
+ * @param phase The phase of each bin.
+ * @param bins Receives the complex bins.
+ * @param n The number of bins.
+ */
+void polar_to_cartesian_scalar(const float* mag, const float* phase, fftwf_complex* bins, size_t n) {
+    for (size_t k = 0; k < n; k++) {
+        bins[k] = mag[k] * (cosf(phase[k]) + I * sinf(phase[k]));
+    }
+}
+
+/**
+ * Cross-correlates a reference segment with every lag of a longer signal:
+ * corr[k] = sum(ref[i] * signal[k + i]) for i < length and k < lags.
+ *
+ * The vector versions process a group of adjacent lags per pass, so every
+ * reference sample is broadcast once and multiplied into unaligned loads of
+ * the signal; no horizontal sums are needed.
+ *
+ * @param ref The reference segment (length samples).
+ * @param signal The searched signal (length + lags - 1 samples).
+ * @param length The number of samples compared per lag.
+ * @param corr Receives one correlation per lag.
+ * @param lags The number of lags.
+ */
+void cross_correlate(const float* ref, const float* signal, size_t length, float* corr, size_t lags) {
+    kernels->cross_correlate(ref, signal, length, corr, lags);
+}
+
+/**
+ * Reference cross-correlation in double precision, one lag at a time.
+ *
+ * @param ref The reference segment (length samples).
+ * @param signal The searched signal (length + lags - 1 samples).
+ * @param length The number of samples compared per lag.
+ * @param corr Receives one correlation per lag.
+ * @param lags The number of lags.
+ */
+void cross_correlate_scalar(const float* ref, const float* signal, size_t length, float* corr, size_t lags) {
+    for (size_t k = 0; k < lags; k++) {
+        double acc = 0.0;
+        for (size_t i = 0; i < length; i++) {
+            acc += (double)ref[i] * signal[k + i];
+        }
+        corr[k] = (float)acc;
+    }
+}
+
+/**
+ * Multiplies samples element-wise in place (windowing).
+ *
+ * @param samples The samples to scale.
+ * @param factors One factor per sample.
+ * @param n The number of samples.
+ */
+void multiply_samples(float* samples, const float* factors, size_t n) {
+    kernels->multiply(samples, factors, n);
+}
+
+/**
+ * @param samples The samples.
+ * @param n The number of samples.
+ * @return The sum of their squares.
+ */
+float sum_of_squares(const float* samples, size_t n) {
+    return kernels->sum_of_squares(samples, n);
+}
+
+/**
+ * Applies a gain and hard-limits the result to [-1, 1] in place.
+ *
+ * @param samples The samples to scale.
+ * @param n The number of samples.
+ * @param gain The linear gain.
+ */
+void gain_and_clip(float* samples, size_t n, float gain) {
+    kernels->gain_and_clip(samples, n, gain);
+}
+
+/**
+ * Applies a linear gain ramp, gain + step * i for sample i, and estimates
+ * the true peak of the result: the largest magnitude of its samples and of
+ * the half-sample points between them. out[-3] to out[-1] must hold the
+ * samples written before out; the points between them and out[0] are
+ * included.
+ *
+ * @param in The input samples.
+ * @param out Receives the ramped samples (must not overlap in).
+ * @param n The number of samples.
+ * @param gain The gain of the first sample.
+ * @param step The gain change per sample.
+ * @param energy Receives the sum of squares of the input.
+ * @return The true peak estimate.
+ */
+float gain_ramp_peak(const float* in, float* out, size_t n, float gain, float step, float* energy) {
+    return kernels->gain_ramp_peak(in, out, n, gain, step, energy);
+}
+
+/**
+ * Applies a linear gain ramp, gain + step * i for sample i, and
+ * hard-limits the result to [-1, 1].
+ *
+ * @param in The input samples.
+ * @param out Receives the result (may equal in).
+ * @param n The number of samples.
+ * @param gain The gain of the first sample.
+ * @param step The gain change per sample.
+ */
+void gain_ramp_clip(const float* in, float* out, size_t n, float gain, float step) {
+    kernels->gain_ramp_clip(in, out, n, gain, step);
+}
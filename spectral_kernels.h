@@ -0,0 +1,44 @@
+#ifndef SPECTRAL_KERNELS_H
+#define SPECTRAL_KERNELS_H
+
+#include <stddef.h>
+#include <complex.h>
+#include <fftw3.h>
+#include "cpu_features.h"
+
+// Polar <-> cartesian conversion of FFT bins.
+//
+// Every kernel here is built for each instruction set in cpu_features.h and
+// spectral_kernels_init() picks one set at startup. All of them, including
+// the portable C one, use polynomial approximations instead of libm:
+//   atan2:    |error| <= 2.0e-6 rad (degree-11 odd minimax on [0, 1])
+//   sin/cos:  |error| <= 1.5e-7 for |x| <= 16 * pi (degree-7/8 minimax on
+//             [-pi/4, pi/4] after a three-part Cody-Waite reduction);
+//             <= 1.0e-6 for |x| <= 4 * pi under -ffast-math, which may
+//             reassociate the reduction. process_fft_bins keeps phases
+//             wrapped to [-pi, pi].
+//   sqrt:     hardware sqrt (correctly rounded without -ffast-math)
+// The _scalar versions call sqrtf/atan2f/sinf/cosf and are kept as the
+// reference the approximations are checked against.
+
+void cartesian_to_polar(const fftwf_complex* bins, float* mag, float* phase, size_t n);
+void polar_to_cartesian(const float* mag, const float* phase, fftwf_complex* bins, size_t n);
+void cartesian_to_polar_scalar(const fftwf_complex* bins, float* mag, float* phase, size_t n);
+void polar_to_cartesian_scalar(const float* mag, const float* phase, fftwf_complex* bins, size_t n);
+int spectral_kernels_init(CpuIsa isa);
+const char* spectral_kernels_isa(void);
+
+// Sliding cross-correlation for the time-domain pitch shifter's splice search
+void cross_correlate(const float* ref, const float* signal, size_t length, float* corr, size_t lags);
+void cross_correlate_scalar(const float* ref, const float* signal, size_t length, float* corr, size_t lags);
+
+// Block kernels for windowing, levels and the output limiter
+void multiply_samples(float* samples, const float* factors, size_t n);
+float sum_of_squares(const float* samples, size_t n);
+void gain_and_clip(float* samples, size_t n, float gain);
+
+// Gain ramps of the dynamics stage (see dynamics.c)
+float gain_ramp_peak(const float* in, float* out, size_t n, float gain, float step, float* energy);
+void gain_ramp_clip(const float* in, float* out, size_t n, float gain, float step);
+
+#endif
@@ -0,0 +1,444 @@
+#include "stream_server.h"
+#include "rt_log.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef MSG_NOSIGNAL
+#define SEND_FLAGS MSG_NOSIGNAL
+#else
+#define SEND_FLAGS 0  // SO_NOSIGPIPE is set on the socket instead
+#endif
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static long long seconds_to_ns(double seconds) {
+    long long ns = (long long)(seconds * 1e9);
+    return ns > 0 ? ns : 0;
+}
+
+/**
+ * Creates a stream server. Streams are added with stream_server_add_file()
+ * and stream_server_accept_sockets() and run with stream_server_run().
+ *
+ * @param num_workers Worker threads; 0 picks one per online core.
+ * @param realtime Non-zero to pace file streams at their sample rate.
+ * @return The server, or NULL on failure.
+ */
+StreamServer* stream_server_create(int num_workers, int realtime) {
+    StreamServer* server = calloc(1, sizeof(StreamServer));
+    if (!server) {
+        printf("Error: Failed to allocate stream server\n");
+        return NULL;
+    }
+    server->num_workers = num_workers;
+    server->realtime = realtime;
+    server->listen_fd = -1;
+    return server;
+}
+
+static Stream* create_stream(StreamServer* server, StreamSource source, const ModulationParams* params,
+                             size_t sample_rate) {
+    if (server->num_streams >= STREAM_SERVER_MAX_STREAMS) {
+        printf("Error: At most %d streams are supported\n", STREAM_SERVER_MAX_STREAMS);
+        return NULL;
+    }
+
+    Stream* stream = calloc(1, sizeof(Stream));
+    if (!stream) {
+        printf("Error: Failed to allocate stream\n");
+        return NULL;
+    }
+
+    stream->chain = dsp_chain_create(STREAM_BLOCK_SIZE, sample_rate, params->reverb_ir_path, params->lookahead);
+    if (!stream->chain) {
+        free(stream);
+        return NULL;
+    }
+    dsp_arena_freeze(stream->chain->arena);  // Fully built; blocks must not allocate
+
+    stream->id = server->num_streams;
+    stream->source = source;
+    stream->params = *params;
+    stream->params.sample_rate = sample_rate;
+    stream->period = (double)STREAM_BLOCK_SIZE / sample_rate;
+    stream->fd = -1;
+    server->streams[server->num_streams++] = stream;
+    return stream;
+}
+
+static void destroy_stream(Stream* stream) {
+    dsp_chain_destroy(stream->chain);
+    free(stream);
+}
+
+static void close_stream(Stream* stream) {
+    if (stream->reader) {
+        wav_reader_close(stream->reader);
+        stream->reader = NULL;
+    }
+    if (stream->writer) {
+        if (wav_writer_close(stream->writer) < 0) {
+            rt_log(RT_LOG_ERROR, "Stream %d failed to finalize its output file.", stream->id);
+        }
+        stream->writer = NULL;
+    }
+    if (stream->fd >= 0) {
+        close(stream->fd);
+        stream->fd = -1;
+    }
+}
+
+/**
+ * Adds a stream that reads one WAV file and writes another.
+ *
+ * @param server The server.
+ * @param input_path The WAV file to read (downmixed to mono).
+ * @param output_path The mono 32-bit float WAV file to write.
+ * @param params The stream's parameters; sample_rate is taken from the file.
+ * @return 0 on success, -1 on failure.
+ */
+int stream_server_add_file(StreamServer* server, const char* input_path, const char* output_path,
+                           const ModulationParams* params) {
+    WavReader* reader = wav_reader_open(input_path);
+    if (!reader) return -1;
+
+    WavWriter* writer = wav_writer_open(output_path, reader->sample_rate);
+    Stream* stream = writer ? create_stream(server, STREAM_SOURCE_FILE, params, reader->sample_rate) : NULL;
+    if (!stream) {
+        if (writer) wav_writer_close(writer);
+        wav_reader_close(reader);
+        return -1;
+    }
+
+    stream->reader = reader;
+    stream->writer = writer;
+    stream->total_frames = reader->total_frames;
+    stream->to_skip = dsp_chain_latency(stream->chain, &stream->params);
+    return 0;
+}
+
+/**
+ * Listens on a local (Unix domain) socket and accepts `count` clients, each
+ * of which becomes a stream.
+ *
+ * A client sends raw mono float32 samples at params->sample_rate and reads
+ * back the same number of processed samples, delayed by the DSP chain
+ * latency. It shuts down its sending side when done; the server then sends
+ * the rest of the output and closes the connection. Blocks until every
+ * client has connected.
+ *
+ * @param server The server.
+ * @param socket_path The socket path (an existing file there is replaced).
+ * @param count The number of clients to accept.
+ * @param params The parameters given to every socket stream.
+ * @return 0 on success, -1 on failure.
+ */
+int stream_server_accept_sockets(StreamServer* server, const char* socket_path, int count,
+                                 const ModulationParams* params) {
+    struct sockaddr_un address = { .sun_family = AF_UNIX };
+    if (strlen(socket_path) >= sizeof(address.sun_path)) {
+        printf("Error: Socket path is too long: %s\n", socket_path);
+        return -1;
+    }
+    strcpy(address.sun_path, socket_path);
+
+    server->listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (server->listen_fd < 0) {
+        printf("Error: Failed to create socket: %s\n", strerror(errno));
+        return -1;
+    }
+
+    unlink(socket_path);
+    if (bind(server->listen_fd, (struct sockaddr*)&address, sizeof(address)) < 0 ||
+        listen(server->listen_fd, count) < 0) {
+        printf("Error: Failed to listen on %s: %s\n", socket_path, strerror(errno));
+        close(server->listen_fd);
+        server->listen_fd = -1;
+        return -1;
+    }
+
+    printf("Waiting for %d clients on %s...\n", count, socket_path);
+    int result = 0;
+    for (int i = 0; i < count; i++) {
+        int fd = accept(server->listen_fd, NULL, NULL);
+        if (fd < 0) {
+            printf("Error: Failed to accept client: %s\n", strerror(errno));
+            result = -1;
+            break;
+        }
+
+        Stream* stream = create_stream(server, STREAM_SOURCE_SOCKET, params, params->sample_rate);
+        if (!stream) {
+            close(fd);
+            result = -1;
+            break;
+        }
+
+#ifdef SO_NOSIGPIPE
+        int on = 1;
+        setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        stream->fd = fd;
+    }
+
+    close(server->listen_fd);
+    server->listen_fd = -1;
+    unlink(socket_path);
+    return result;
+}
+
+/**
+ * Runs one block through the stream's DSP chain and records its timing
+ * against the block's deadline.
+ */
+static void process_block(Stream* stream) {
+    double start = now_seconds();
+    if (process_audio_frame(stream->chain, stream->input, stream->output,
+                            STREAM_BLOCK_SIZE, &stream->params) < 0) {
+        memset(stream->output, 0, sizeof(stream->output));
+    }
+    double end = now_seconds();
+
+    double elapsed = end - start;
+    stream->busy_seconds += elapsed;
+    if (elapsed > stream->max_block_seconds) stream->max_block_seconds = elapsed;
+    stream->blocks++;
+
+    double lateness = end - (stream->block_ready + stream->period);
+    if (lateness > 0.0) {
+        stream->deadline_misses++;
+        if (lateness > stream->max_lateness) stream->max_lateness = lateness;
+    }
+}
+
+static long long finish_stream(Stream* stream) {
+    close_stream(stream);
+    stream->finish_time = now_seconds();
+    return WORK_POOL_DONE;
+}
+
+/**
+ * Processes the next block of a file stream. In realtime mode block k is
+ * released once its last sample would have arrived, (k + 1) periods after
+ * the start.
+ */
+static long long step_file_stream(StreamServer* server, Stream* stream) {
+    double now = now_seconds();
+    if (server->realtime) {
+        double ready = stream->start_time + (stream->blocks + 1) * stream->period;
+        if (now < ready) return seconds_to_ns(ready - now) + 1;
+        stream->block_ready = ready;
+    } else {
+        stream->block_ready = now;
+    }
+
+    size_t n = wav_read_frames(stream->reader, stream->input, STREAM_BLOCK_SIZE);
+    if (n < STREAM_BLOCK_SIZE) {
+        memset(stream->input + n, 0, (STREAM_BLOCK_SIZE - n) * sizeof(float));
+    }
+    stream->frames_read += n;
+
+    process_block(stream);
+
+    // Trim the DSP chain delay and flush its tail so the output is
+    // sample-aligned with the input, as in offline mode
+    size_t offset = stream->to_skip < STREAM_BLOCK_SIZE ? stream->to_skip : STREAM_BLOCK_SIZE;
+    stream->to_skip -= offset;
+    size_t count = STREAM_BLOCK_SIZE - offset;
+    if (count > stream->total_frames - stream->frames_written) {
+        count = stream->total_frames - stream->frames_written;
+    }
+    if (wav_write_frames(stream->writer, stream->output + offset, count) < 0) {
+        rt_log(RT_LOG_ERROR, "Stream %d failed to write its output file.", stream->id);
+        return finish_stream(stream);
+    }
+    stream->frames_written += count;
+
+    if (stream->frames_written >= stream->total_frames) {
+        return finish_stream(stream);
+    }
+    if (server->realtime) {
+        double next = stream->start_time + (stream->blocks + 1) * stream->period;
+        return seconds_to_ns(next - now_seconds());
+    }
+    return 0;
+}
+
+static int send_all(int fd, const void* data, size_t length) {
+    const char* bytes = (const char*)data;
+    while (length > 0) {
+        ssize_t sent = send(fd, bytes, length, SEND_FLAGS);
+        if (sent > 0) {
+            bytes += sent;
+            length -= (size_t)sent;
+        } else if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+            // The client is not reading; back off instead of spinning
+            usleep(100);
+        } else {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Receives what the client has sent and processes the block once it is
+ * complete (or the client has finished). The socket is non-blocking, so a
+ * stream waiting for its client never holds a worker.
+ */
+static long long step_socket_stream(Stream* stream) {
+    if (!stream->eof) {
+        ssize_t got = recv(stream->fd, (char*)stream->input + stream->bytes_in,
+                           sizeof(stream->input) - stream->bytes_in, 0);
+        if (got > 0) {
+            stream->bytes_in += (size_t)got;
+        } else if (got == 0) {
+            stream->eof = 1;
+        } else if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            rt_log(RT_LOG_ERROR, "Stream %d receive failed: %s", stream->id, strerror(errno));
+            stream->eof = 1;
+        }
+    }
+
+    if (stream->bytes_in < sizeof(stream->input) && !stream->eof) {
+        // Poll well within the block period
+        return seconds_to_ns(stream->period / 8);
+    }
+
+    size_t frames = stream->bytes_in / sizeof(float);
+    if (frames == 0) {
+        return finish_stream(stream);
+    }
+    if (frames < STREAM_BLOCK_SIZE) {
+        memset(stream->input + frames, 0, (STREAM_BLOCK_SIZE - frames) * sizeof(float));
+    }
+
+    stream->block_ready = now_seconds();
+    process_block(stream);
+    stream->frames_read += frames;
+    stream->bytes_in = 0;
+
+    if (send_all(stream->fd, stream->output, frames * sizeof(float)) < 0) {
+        rt_log(RT_LOG_ERROR, "Stream %d send failed: %s", stream->id, strerror(errno));
+        return finish_stream(stream);
+    }
+    stream->frames_written += frames;
+
+    return stream->eof ? finish_stream(stream) : 0;
+}
+
+static long long step_stream(void* ctx, void* item, int worker) {
+    StreamServer* server = (StreamServer*)ctx;
+    Stream* stream = (Stream*)item;
+    (void)worker;
+
+    if (stream->source == STREAM_SOURCE_FILE) {
+        return step_file_stream(server, stream);
+    }
+    return step_socket_stream(stream);
+}
+
+static void print_report(StreamServer* server, WorkPool* pool, double wall) {
+    double total_audio = 0.0;
+    unsigned long total_misses = 0;
+
+    printf("stream,source,sample_rate,audio_s,blocks,busy_ms,max_block_us,deadline_misses,max_late_ms,realtime_factor,peak_backlog_ms\n");
+    for (int i = 0; i < server->num_streams; i++) {
+        Stream* stream = server->streams[i];
+        double audio = (double)stream->frames_read / stream->params.sample_rate;
+        total_audio += audio;
+        total_misses += stream->deadline_misses;
+        printf("%d,%s,%zu,%.3f,%lu,%.2f,%.1f,%lu,%.3f,%.1f,%.1f\n",
+               stream->id, stream->source == STREAM_SOURCE_FILE ? "file" : "socket",
+               stream->params.sample_rate, audio, stream->blocks,
+               stream->busy_seconds * 1000.0, stream->max_block_seconds * 1e6,
+               stream->deadline_misses, stream->max_lateness * 1000.0,
+               stream->busy_seconds > 0 ? audio / stream->busy_seconds : 0.0,
+               stream->chain->vocoder->backlog_peak * 1000.0 / stream->params.sample_rate);
+    }
+
+    unsigned long steals = 0;
+    double idle = 0.0;
+    for (int i = 0; i < pool->num_workers; i++) {
+        steals += pool->workers[i].steals;
+        idle += pool->workers[i].idle_seconds;
+    }
+
+    printf("%d streams on %d workers: %.2f s of audio in %.3f s (aggregate realtime factor %.1fx), "
+           "%lu deadline misses, %lu steals, %.0f%% idle\n",
+           server->num_streams, pool->num_workers, total_audio, wall,
+           wall > 0 ? total_audio / wall : 0.0, total_misses, steals,
+           wall > 0 ? 100.0 * idle / (wall * pool->num_workers) : 0.0);
+}
+
+/**
+ * Runs every stream to completion on a work-stealing pool and prints a
+ * per-stream CSV report followed by an aggregate summary.
+ *
+ * Each scheduling step processes one STREAM_BLOCK_SIZE block of one stream,
+ * so a stream only ever runs on one worker at a time while an idle worker
+ * can take over any stream whose next block is ready.
+ *
+ * @param server The server.
+ * @return 0 on success, -1 on failure.
+ */
+int stream_server_run(StreamServer* server) {
+    if (server->num_streams == 0) {
+        printf("Error: No streams to run.\n");
+        return -1;
+    }
+
+    WorkPool* pool = work_pool_create(server->num_workers, server->num_streams, 1);
+    if (!pool) return -1;
+
+    // Workers report stream errors through the log ring instead of stdout
+    rt_log_start();
+    double start = now_seconds();
+    for (int i = 0; i < server->num_streams; i++) {
+        Stream* stream = server->streams[i];
+        stream->start_time = start;
+        if (work_pool_add(pool, stream) < 0) {
+            work_pool_destroy(pool);
+            rt_log_stop();
+            return -1;
+        }
+    }
+
+    int result = work_pool_run(pool, step_stream, server);
+    double wall = now_seconds() - start;
+    rt_log_stop();
+
+    if (result == 0) {
+        print_report(server, pool, wall);
+    }
+    work_pool_destroy(pool);
+    return result;
+}
+
+/**
+ * Closes every stream and frees the server.
+ *
+ * @param server The server (may be NULL).
+ */
+void stream_server_destroy(StreamServer* server) {
+    if (!server) return;
+
+    for (int i = 0; i < server->num_streams; i++) {
+        close_stream(server->streams[i]);
+        destroy_stream(server->streams[i]);
+    }
+    if (server->listen_fd >= 0) {
+        close(server->listen_fd);
+    }
+    free(server);
+}
@@ -0,0 +1,73 @@
+#ifndef STREAM_SERVER_H
+#define STREAM_SERVER_H
+
+#include "voice_modulator.h"
+#include "wav_io.h"
+#include "work_pool.h"
+
+#define STREAM_SERVER_MAX_STREAMS 256
+
+// Samples processed per scheduling step; one hop keeps per-stream latency at
+// the phase vocoder's minimum
+#define STREAM_BLOCK_SIZE HOP_SIZE
+
+typedef enum {
+    STREAM_SOURCE_FILE = 0,  // WAV in, WAV out (trimmed and sample-aligned, like offline mode)
+    STREAM_SOURCE_SOCKET     // Raw float32 mono over a connected local socket, both directions
+} StreamSource;
+
+// One independent modulation pipeline
+typedef struct {
+    int id;
+    StreamSource source;
+    ModulationParams params;       // Per-stream copy; never shared with other streams
+    DspChain* chain;
+
+    WavReader* reader;             // STREAM_SOURCE_FILE
+    WavWriter* writer;
+    size_t total_frames;
+    size_t frames_read;
+    size_t frames_written;
+    size_t to_skip;                // DSP chain delay still to trim from the output
+
+    int fd;                        // STREAM_SOURCE_SOCKET
+    size_t bytes_in;               // Bytes of the current block received so far
+    int eof;
+
+    float input[STREAM_BLOCK_SIZE];
+    float output[STREAM_BLOCK_SIZE];
+
+    // Scheduling and deadlines. Block k is complete at release_time(k) and
+    // must be finished one block period later.
+    double period;                 // Seconds of audio per block
+    double start_time;
+    double block_ready;            // When the block being processed became available
+    unsigned long blocks;
+    unsigned long deadline_misses;
+    double max_lateness;           // Worst finish time past a deadline (seconds)
+    double busy_seconds;           // Time spent in the DSP chain
+    double max_block_seconds;
+    double finish_time;
+} Stream;
+
+// Hosts many streams on a work-stealing pool. In realtime mode file streams
+// are paced at their sample rate so deadlines are meaningful; otherwise they
+// run as fast as the cores allow and the aggregate realtime factor measures
+// capacity. Socket streams are paced by their clients.
+typedef struct {
+    Stream* streams[STREAM_SERVER_MAX_STREAMS];
+    int num_streams;
+    int num_workers;
+    int realtime;
+    int listen_fd;
+} StreamServer;
+
+StreamServer* stream_server_create(int num_workers, int realtime);
+int stream_server_add_file(StreamServer* server, const char* input_path, const char* output_path,
+                           const ModulationParams* params);
+int stream_server_accept_sockets(StreamServer* server, const char* socket_path, int count,
+                                 const ModulationParams* params);
+int stream_server_run(StreamServer* server);
+void stream_server_destroy(StreamServer* server);
+
+#endif
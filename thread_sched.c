@@ -0,0 +1,234 @@
+#ifdef __linux__
+#define _GNU_SOURCE
+#endif
+#include "thread_sched.h"
+#include <errno.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static int native_policy(SchedPolicy policy) {
+    return policy == SCHED_POLICY_RR ? SCHED_RR : SCHED_FIFO;
+}
+
+static const char* native_policy_name(int policy) {
+    switch (policy) {
+        case SCHED_FIFO: return "SCHED_FIFO";
+        case SCHED_RR: return "SCHED_RR";
+        case SCHED_OTHER: return "SCHED_OTHER";
+#ifdef SCHED_BATCH
+        case SCHED_BATCH: return "SCHED_BATCH";
+#endif
+#ifdef SCHED_IDLE
+        case SCHED_IDLE: return "SCHED_IDLE";
+#endif
+        default: return "unknown policy";
+    }
+}
+
+// The requested priority, clamped to what the policy accepts
+static int native_priority(const ThreadSched* sched) {
+    int policy = native_policy(sched->policy);
+    int low = sched_get_priority_min(policy);
+    int high = sched_get_priority_max(policy);
+    if (sched->priority < low) return low;
+    if (sched->priority > high) return high;
+    return sched->priority;
+}
+
+/**
+ * Parses a thread scheduling spec of the form [policy][:priority][@cpu],
+ * where policy is fifo, rr or other. "fifo" alone uses
+ * THREAD_SCHED_DEFAULT_PRIORITY; "@2" only pins the thread.
+ *
+ * @param spec The spec, e.g. "fifo:80@2".
+ * @param sched Receives the request.
+ * @return 0 on success, -1 if the spec is malformed.
+ */
+int thread_sched_parse(const char* spec, ThreadSched* sched) {
+    ThreadSched parsed = THREAD_SCHED_NONE;
+    size_t name_length = strcspn(spec, ":@");
+    if (name_length == 4 && strncmp(spec, "fifo", 4) == 0) {
+        parsed.policy = SCHED_POLICY_FIFO;
+    } else if (name_length == 2 && strncmp(spec, "rr", 2) == 0) {
+        parsed.policy = SCHED_POLICY_RR;
+    } else if (name_length != 0 && !(name_length == 5 && strncmp(spec, "other", 5) == 0)) {
+        return -1;
+    }
+    const char* rest = spec + name_length;
+
+    if (*rest == ':') {
+        char* end;
+        long priority = strtol(rest + 1, &end, 10);
+        if (end == rest + 1 || priority < 1 || priority > 99 || parsed.policy == SCHED_POLICY_DEFAULT) {
+            return -1;
+        }
+        parsed.priority = (int)priority;
+        rest = end;
+    } else if (parsed.policy != SCHED_POLICY_DEFAULT) {
+        parsed.priority = THREAD_SCHED_DEFAULT_PRIORITY;
+    }
+
+    if (*rest == '@') {
+        char* end;
+        long cpu = strtol(rest + 1, &end, 10);
+        if (end == rest + 1 || cpu < 0 || cpu > 1023) return -1;
+        parsed.cpu = (int)cpu;
+        rest = end;
+    }
+    if (*rest != '\0') return -1;
+
+    *sched = parsed;
+    return 0;
+}
+
+/**
+ * Applies a scheduling request to a running thread. Every part that is
+ * allowed is applied even if another part fails.
+ *
+ * @param thread The thread.
+ * @param sched The request.
+ * @return 0 if everything was applied, otherwise the error of the first
+ *         part that failed (EPERM without CAP_SYS_NICE or an rtprio limit,
+ *         ENOTSUP for pinning where it is not available).
+ */
+int thread_sched_apply(pthread_t thread, const ThreadSched* sched) {
+    int error = 0;
+    if (sched->policy != SCHED_POLICY_DEFAULT) {
+        struct sched_param param = { .sched_priority = native_priority(sched) };
+        error = pthread_setschedparam(thread, native_policy(sched->policy), &param);
+    }
+    if (sched->cpu >= 0) {
+#ifdef __linux__
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(sched->cpu, &set);
+        int pin_error = pthread_setaffinity_np(thread, sizeof(set), &set);
+#else
+        int pin_error = ENOTSUP;
+#endif
+        if (!error) error = pin_error;
+    }
+    return error;
+}
+
+/**
+ * Starts a thread with the requested policy, priority and core.
+ *
+ * The thread is created with explicit scheduling attributes, so it never
+ * runs a single instruction at the default priority. When that is refused
+ * (typically EPERM for an unprivileged process) it is started with the
+ * default attributes instead and whatever part of the request is allowed
+ * is applied afterwards, so a missing privilege never stops the pipeline.
+ *
+ * @param thread Receives the thread.
+ * @param sched The request (NULL = defaults).
+ * @param start The thread function.
+ * @param arg Its argument.
+ * @param sched_error Receives 0, or the error that kept part of the request
+ *                    from being applied.
+ * @return 0 on success, otherwise the pthread_create() error.
+ */
+int thread_sched_create(pthread_t* thread, const ThreadSched* sched, void* (*start)(void*), void* arg,
+                        int* sched_error) {
+    *sched_error = 0;
+    if (!sched || (sched->policy == SCHED_POLICY_DEFAULT && sched->cpu < 0)) {
+        return pthread_create(thread, NULL, start, arg);
+    }
+
+    pthread_attr_t attr;
+    int error = pthread_attr_init(&attr);
+    if (error == 0) {
+        if (sched->policy != SCHED_POLICY_DEFAULT) {
+            struct sched_param param = { .sched_priority = native_priority(sched) };
+            error = pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+            if (!error) error = pthread_attr_setschedpolicy(&attr, native_policy(sched->policy));
+            if (!error) error = pthread_attr_setschedparam(&attr, &param);
+        }
+#ifdef __linux__
+        if (!error && sched->cpu >= 0) {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(sched->cpu, &set);
+            error = pthread_attr_setaffinity_np(&attr, sizeof(set), &set);
+        }
+#endif
+        if (!error) error = pthread_create(thread, &attr, start, arg);
+        pthread_attr_destroy(&attr);
+        if (error == 0) {
+#ifndef __linux__
+            if (sched->cpu >= 0) *sched_error = ENOTSUP;
+#endif
+            return 0;
+        }
+    }
+
+    int result = pthread_create(thread, NULL, start, arg);
+    if (result == 0) {
+        *sched_error = thread_sched_apply(*thread, sched);
+        if (*sched_error == 0) *sched_error = error;
+    }
+    return result;
+}
+
+/**
+ * Describes the scheduling a thread actually runs with, e.g.
+ * "SCHED_FIFO priority 80, CPU 2" or "SCHED_OTHER, any CPU".
+ *
+ * @param thread The thread.
+ * @param text Receives the description.
+ * @param size Size of text.
+ */
+void thread_sched_describe(pthread_t thread, char* text, size_t size) {
+    int policy;
+    struct sched_param param;
+    int length;
+    if (pthread_getschedparam(thread, &policy, &param) != 0) {
+        length = snprintf(text, size, "unknown policy");
+    } else if (policy == SCHED_FIFO || policy == SCHED_RR) {
+        length = snprintf(text, size, "%s priority %d", native_policy_name(policy), param.sched_priority);
+    } else {
+        length = snprintf(text, size, "%s", native_policy_name(policy));
+    }
+    if (length < 0 || (size_t)length >= size) return;
+
+#ifdef __linux__
+    cpu_set_t set;
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    if (pthread_getaffinity_np(thread, sizeof(set), &set) == 0 && CPU_COUNT(&set) < online) {
+        const char* separator = CPU_COUNT(&set) == 1 ? ", CPU " : ", CPUs ";
+        for (int cpu = 0; cpu < CPU_SETSIZE && (size_t)length < size; cpu++) {
+            if (!CPU_ISSET(cpu, &set)) continue;
+            length += snprintf(text + length, size - length, "%s%d", separator, cpu);
+            separator = ",";
+        }
+        return;
+    }
+#endif
+    snprintf(text + length, size - length, ", any CPU");
+}
+
+/**
+ * Describes a request the way thread_sched_describe() describes a thread.
+ *
+ * @param sched The request.
+ * @param text Receives the description.
+ * @param size Size of text.
+ */
+void thread_sched_format(const ThreadSched* sched, char* text, size_t size) {
+    int length;
+    if (sched->policy == SCHED_POLICY_DEFAULT) {
+        length = snprintf(text, size, "default policy");
+    } else {
+        length = snprintf(text, size, "%s priority %d", native_policy_name(native_policy(sched->policy)),
+                          native_priority(sched));
+    }
+    if (length < 0 || (size_t)length >= size) return;
+    if (sched->cpu >= 0) {
+        snprintf(text + length, size - length, ", CPU %d", sched->cpu);
+    } else {
+        snprintf(text + length, size - length, ", any CPU");
+    }
+}
@@ -0,0 +1,32 @@
+#ifndef THREAD_SCHED_H
+#define THREAD_SCHED_H
+
+#include <stddef.h>
+#include <pthread.h>
+
+#define THREAD_SCHED_DEFAULT_PRIORITY 70  // Real-time priority when a spec names only the policy
+
+typedef enum {
+    SCHED_POLICY_DEFAULT = 0,  // Leave the thread as created (normally SCHED_OTHER)
+    SCHED_POLICY_FIFO,         // SCHED_FIFO: runs until it blocks or a higher priority wakes
+    SCHED_POLICY_RR            // SCHED_RR: like FIFO, round-robin among equal priorities
+} SchedPolicy;
+
+// Requested scheduling of one thread
+typedef struct {
+    SchedPolicy policy;
+    int priority;              // 1-99, clamped to the policy's range (ignored for DEFAULT)
+    int cpu;                   // Core to pin to (-1 = any)
+} ThreadSched;
+
+// Initializer for a thread that keeps the defaults
+#define THREAD_SCHED_NONE { SCHED_POLICY_DEFAULT, 0, -1 }
+
+int thread_sched_parse(const char* spec, ThreadSched* sched);
+int thread_sched_create(pthread_t* thread, const ThreadSched* sched, void* (*start)(void*), void* arg,
+                        int* sched_error);
+int thread_sched_apply(pthread_t thread, const ThreadSched* sched);
+void thread_sched_describe(pthread_t thread, char* text, size_t size);
+void thread_sched_format(const ThreadSched* sched, char* text, size_t size);
+
+#endif
@@ -0,0 +1,336 @@
+#include "virtual_device.h"
+#include "wav_io.h"
+#include "rt_log.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// Device state. The capture fields belong to the input thread and the
+// playback fields to the output thread; the stats are split the same way.
+typedef struct {
+    VirtualDeviceConfig config;
+    size_t sample_rate;
+    size_t frames;
+    uint64_t period_ns;         // Real time per block (device period / clock_scale)
+    uint64_t jitter_ns;
+    uint64_t start_ns;
+
+    // Capture
+    unsigned long next_block;   // Device block the next read returns
+    uint64_t rng;
+    float* source;              // VIRTUAL_SOURCE_FILE samples
+    size_t source_length;
+
+    // Playback
+    unsigned long run_blocks;   // Blocks written since playback (re)started
+    uint64_t run_start_ns;      // When the first block of the run is played (0 = not started)
+    WavWriter* sink;
+    float* silence;
+
+    VirtualDeviceStats stats;
+} VirtualDevice;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static void sleep_until(uint64_t deadline) {
+    uint64_t now = now_ns();
+    if (deadline <= now) return;
+    uint64_t wait = deadline - now;
+    struct timespec ts = { (time_t)(wait / 1000000000u), (long)(wait % 1000000000u) };
+    nanosleep(&ts, NULL);
+}
+
+// xorshift64*: cheap, repeatable, never allocates
+static uint64_t next_random(uint64_t* state) {
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 2685821657736338717ull;
+}
+
+/**
+ * Fills `config` with the defaults: a VIRTUAL_DEVICE_FREQUENCY sine, no
+ * output file, wall-clock timing and no jitter.
+ *
+ * @param config The configuration.
+ */
+void virtual_device_config_init(VirtualDeviceConfig* config) {
+    memset(config, 0, sizeof(*config));
+    config->source = VIRTUAL_SOURCE_SINE;
+    config->frequency = VIRTUAL_DEVICE_FREQUENCY;
+    config->clock_scale = 1.0f;
+    config->capture_blocks = VIRTUAL_DEVICE_CAPTURE_BLOCKS;
+    config->playback_blocks = VIRTUAL_DEVICE_PLAYBACK_BLOCKS;
+    config->seed = 1;
+    config->duration = VIRTUAL_DEVICE_DURATION;
+}
+
+/**
+ * Parses a source spec: "sine[:hz]", "noise", or the path of a WAV file.
+ *
+ * @param spec The spec.
+ * @param config Receives the source.
+ * @return 0 on success, -1 if the spec is malformed.
+ */
+int virtual_device_parse_source(const char* spec, VirtualDeviceConfig* config) {
+    if (strcmp(spec, "noise") == 0) {
+        config->source = VIRTUAL_SOURCE_NOISE;
+    } else if (strncmp(spec, "sine", 4) == 0 && (spec[4] == '\0' || spec[4] == ':')) {
+        config->source = VIRTUAL_SOURCE_SINE;
+        if (spec[4] == ':') {
+            char* end;
+            config->frequency = strtof(spec + 5, &end);
+            if (end == spec + 5 || *end != '\0' || config->frequency <= 0.0f) return -1;
+        }
+    } else if (spec[0] != '\0') {
+        config->source = VIRTUAL_SOURCE_FILE;
+        config->input_path = spec;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+static int load_source(VirtualDevice* dev) {
+    WavReader* reader = wav_reader_open(dev->config.input_path);
+    if (!reader) return -1;
+    if (reader->sample_rate != dev->sample_rate) {
+        rt_log(RT_LOG_WARNING, "Virtual device: %s is %u Hz, played at %zu Hz", dev->config.input_path,
+               reader->sample_rate, dev->sample_rate);
+    }
+    dev->source = malloc((reader->total_frames + 1) * sizeof(float));
+    dev->source_length = dev->source ? wav_read_frames(reader, dev->source, reader->total_frames) : 0;
+    wav_reader_close(reader);
+    if (dev->source_length == 0) {
+        rt_log(RT_LOG_ERROR, "Virtual device: %s has no audio", dev->config.input_path);
+        return -1;
+    }
+    return 0;
+}
+
+// Generates device block `block` into buffer. Positions follow the block
+// index, so dropped blocks are skipped in the source as well.
+static void generate_block(VirtualDevice* dev, unsigned long block, float* buffer) {
+    size_t first = (size_t)block * dev->frames;
+    switch (dev->config.source) {
+        case VIRTUAL_SOURCE_SINE: {
+            double step = 2.0 * M_PI * dev->config.frequency / dev->sample_rate;
+            for (size_t i = 0; i < dev->frames; i++) {
+                buffer[i] = 0.5f * (float)sin(fmod(step * (double)(first + i), 2.0 * M_PI));
+            }
+            break;
+        }
+        case VIRTUAL_SOURCE_NOISE:
+            for (size_t i = 0; i < dev->frames; i++) {
+                buffer[i] = 0.3f * ((float)(next_random(&dev->rng) >> 40) / (float)(1 << 23) - 1.0f);
+            }
+            break;
+        case VIRTUAL_SOURCE_FILE:
+            for (size_t i = 0; i < dev->frames; i++) {
+                buffer[i] = dev->source[(first + i) % dev->source_length];
+            }
+            break;
+    }
+}
+
+static void write_silence(VirtualDevice* dev, size_t blocks) {
+    for (size_t b = 0; b < blocks && dev->sink; b++) {
+        wav_write_frames(dev->sink, dev->silence, dev->frames);
+    }
+}
+
+static void virtual_stop(AudioBackend* backend) {
+    VirtualDevice* dev = backend->state;
+    if (dev->sink) wav_writer_close(dev->sink);
+    dev->sink = NULL;
+    free(dev->source);
+    dev->source = NULL;
+    free(dev->silence);
+    dev->silence = NULL;
+}
+
+// The latency argument is ignored: the buffers are set by the configuration
+static int virtual_start(AudioBackend* backend, size_t sample_rate, size_t frames, double latency) {
+    VirtualDevice* dev = backend->state;
+    dev->sample_rate = sample_rate;
+    dev->frames = frames;
+    dev->period_ns = (uint64_t)(frames * 1e9 / (sample_rate * (double)dev->config.clock_scale));
+    dev->jitter_ns = (uint64_t)(dev->config.jitter_ms * 1e6);
+    dev->rng = 0x9E3779B97F4A7C15ull ^ dev->config.seed;
+    dev->silence = calloc(frames, sizeof(float));
+    if (!dev->silence) return -1;
+
+    if (dev->config.source == VIRTUAL_SOURCE_FILE && load_source(dev) < 0) {
+        virtual_stop(backend);
+        return -1;
+    }
+    if (dev->config.output_path) {
+        dev->sink = wav_writer_open(dev->config.output_path, (uint32_t)sample_rate);
+        if (!dev->sink) {
+            virtual_stop(backend);
+            return -1;
+        }
+    }
+
+    memset(&dev->stats, 0, sizeof(dev->stats));
+    dev->stats.min_slack = -1.0;
+    dev->next_block = 0;
+    dev->run_start_ns = 0;
+    dev->start_ns = now_ns();
+    rt_log(RT_LOG_INFO, "Virtual device: %zu-frame blocks every %.3f ms (clock x%.2f), jitter up to %.2f ms, "
+           "capture buffer %zu blocks, playback buffer %zu blocks",
+           frames, dev->period_ns * 1e-6, dev->config.clock_scale, dev->config.jitter_ms,
+           dev->config.capture_blocks, dev->config.playback_blocks);
+    return 0;
+}
+
+/**
+ * Returns the next captured block once the device clock has produced it,
+ * plus the injected wakeup delay. A reader that falls more than
+ * capture_blocks behind loses the oldest blocks, like a real driver.
+ */
+static AudioIoStatus virtual_read(AudioBackend* backend, float* buffer, size_t frames) {
+    VirtualDevice* dev = backend->state;
+    if (frames != dev->frames) return AUDIO_IO_ERROR;
+
+    AudioIoStatus status = AUDIO_IO_OK;
+    uint64_t now = now_ns();
+    unsigned long complete = (unsigned long)((now - dev->start_ns) / dev->period_ns);
+    if (complete > dev->next_block + dev->config.capture_blocks) {
+        unsigned long dropped = complete - dev->config.capture_blocks - dev->next_block;
+        dev->next_block += dropped;
+        dev->stats.blocks_dropped += dropped;
+        dev->stats.overflows++;
+        status = AUDIO_IO_OVERFLOW;
+    }
+
+    uint64_t jitter = dev->jitter_ns > 0 ? next_random(&dev->rng) % (dev->jitter_ns + 1) : 0;
+    if (jitter * 1e-9 > dev->stats.max_jitter) dev->stats.max_jitter = jitter * 1e-9;
+    sleep_until(dev->start_ns + (dev->next_block + 1) * dev->period_ns + jitter);
+
+    generate_block(dev, dev->next_block++, buffer);
+    dev->stats.blocks_captured++;
+    return status;
+}
+
+/**
+ * Queues one block for playback. The device plays a block every period,
+ * starting playback_blocks periods after the first write, and a write
+ * waits until the buffer has room. A write that arrives after its block
+ * was due is a deadline miss: the gap is played as silence and the buffer
+ * is primed again.
+ */
+static AudioIoStatus virtual_write(AudioBackend* backend, const float* buffer, size_t frames) {
+    VirtualDevice* dev = backend->state;
+    if (frames != dev->frames) return AUDIO_IO_ERROR;
+
+    AudioIoStatus status = AUDIO_IO_OK;
+    uint64_t now = now_ns();
+    uint64_t prime_ns = dev->config.playback_blocks * dev->period_ns;
+    if (dev->run_start_ns == 0) {
+        dev->run_start_ns = now + prime_ns;
+        dev->run_blocks = 0;
+        write_silence(dev, dev->config.playback_blocks);
+    }
+
+    uint64_t due = dev->run_start_ns + dev->run_blocks * dev->period_ns;
+    if (now > due) {
+        double late = (now - due) * 1e-9;
+        dev->stats.deadline_misses++;
+        if (late > dev->stats.max_late) dev->stats.max_late = late;
+        write_silence(dev, (size_t)((now - due) / dev->period_ns) + 1 + dev->config.playback_blocks);
+        dev->run_start_ns = now + prime_ns;
+        dev->run_blocks = 0;
+        status = AUDIO_IO_UNDERFLOW;
+    } else {
+        double slack = (due - now) * 1e-9;
+        if (dev->stats.min_slack < 0.0 || slack < dev->stats.min_slack) dev->stats.min_slack = slack;
+        // Wait for room: the buffer holds playback_blocks blocks
+        if (due > now + prime_ns) sleep_until(due - prime_ns);
+    }
+
+    if (dev->sink) wav_write_frames(dev->sink, buffer, frames);
+    dev->run_blocks++;
+    dev->stats.blocks_played++;
+    return status;
+}
+
+static void virtual_report(AudioBackend* backend) {
+    VirtualDeviceStats stats;
+    virtual_device_stats(backend, &stats);
+    printf("Virtual device: %lu blocks captured (%lu dropped in %lu overflows), %lu played, "
+           "%lu deadline misses (worst %.3f ms late), least slack %.3f ms, jitter up to %.3f ms\n",
+           stats.blocks_captured, stats.blocks_dropped, stats.overflows, stats.blocks_played,
+           stats.deadline_misses, stats.max_late * 1000.0,
+           stats.min_slack > 0.0 ? stats.min_slack * 1000.0 : 0.0, stats.max_jitter * 1000.0);
+}
+
+// A block becomes readable a period after it starts; playback is buffered
+// playback_blocks periods ahead (both in device time)
+static double virtual_latency(AudioBackend* backend) {
+    VirtualDevice* dev = backend->state;
+    return (double)dev->frames * (1 + dev->config.playback_blocks) / dev->sample_rate;
+}
+
+static const char* virtual_error_text(AudioBackend* backend) {
+    (void)backend;
+    return "block size does not match the device";
+}
+
+/**
+ * Creates a virtual device: the input is a generated signal or a looped
+ * WAV file, the output goes to a WAV file (or nowhere), and both sides run
+ * on a simulated device clock that can run faster than real time and
+ * inject wakeup jitter. The threaded pipeline runs on it unchanged, so its
+ * deadline misses can be measured without sound hardware.
+ *
+ * @param config The device configuration (copied).
+ * @return The backend, or NULL on failure.
+ */
+AudioBackend* virtual_device_create(const VirtualDeviceConfig* config) {
+    if (config->clock_scale <= 0.0f || config->jitter_ms < 0.0f || config->capture_blocks == 0) {
+        rt_log(RT_LOG_ERROR, "Invalid virtual device configuration");
+        return NULL;
+    }
+    AudioBackend* backend = calloc(1, sizeof(AudioBackend));
+    VirtualDevice* dev = calloc(1, sizeof(VirtualDevice));
+    if (!backend || !dev) {
+        free(backend);
+        free(dev);
+        return NULL;
+    }
+    dev->config = *config;
+    backend->name = "virtual";
+    backend->state = dev;
+    backend->start = virtual_start;
+    backend->read = virtual_read;
+    backend->write = virtual_write;
+    backend->stop = virtual_stop;
+    backend->report = virtual_report;
+    backend->error_text = virtual_error_text;
+    backend->latency = virtual_latency;
+    return backend;
+}
+
+/**
+ * @param backend A backend from virtual_device_create().
+ * @param stats Receives the counters of the current run (all zero for any
+ *              other backend).
+ */
+void virtual_device_stats(AudioBackend* backend, VirtualDeviceStats* stats) {
+    if (!backend || backend->read != virtual_read) {
+        memset(stats, 0, sizeof(*stats));
+        return;
+    }
+    *stats = ((VirtualDevice*)backend->state)->stats;
+}
@@ -0,0 +1,49 @@
+#ifndef VIRTUAL_DEVICE_H
+#define VIRTUAL_DEVICE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "audio_backend.h"
+
+#define VIRTUAL_DEVICE_FREQUENCY 220.0f   // Default sine source
+#define VIRTUAL_DEVICE_CAPTURE_BLOCKS 4   // Blocks the capture side holds before it overflows
+#define VIRTUAL_DEVICE_PLAYBACK_BLOCKS 2  // Playback buffer (output latency) in blocks
+#define VIRTUAL_DEVICE_DURATION 10.0f     // Default headless run, in device seconds
+
+typedef enum {
+    VIRTUAL_SOURCE_SINE = 0,
+    VIRTUAL_SOURCE_NOISE,
+    VIRTUAL_SOURCE_FILE       // WAV file, looped
+} VirtualSource;
+
+typedef struct {
+    VirtualSource source;
+    float frequency;          // Sine frequency in Hz
+    const char* input_path;   // VIRTUAL_SOURCE_FILE
+    const char* output_path;  // Played audio is written here (NULL = discarded)
+    float clock_scale;        // Device time runs this many times faster than real time (1 = wall clock)
+    float jitter_ms;          // Each capture wakes up late by a random 0..jitter_ms (real time)
+    size_t capture_blocks;
+    size_t playback_blocks;
+    unsigned seed;            // Jitter and noise generator seed, for repeatable runs
+    float duration;           // Device seconds a headless run lasts
+} VirtualDeviceConfig;
+
+// Counters of one run; read after the pipeline threads have stopped
+typedef struct {
+    unsigned long blocks_captured;
+    unsigned long blocks_dropped;     // Overwritten before the input thread read them
+    unsigned long overflows;          // Reads that reported lost input
+    unsigned long blocks_played;
+    unsigned long deadline_misses;    // Blocks written after the device needed them
+    double max_late;                  // Worst miss (seconds of real time)
+    double min_slack;                 // Least time to spare before a deadline that was met
+    double max_jitter;                // Largest injected wakeup delay
+} VirtualDeviceStats;
+
+void virtual_device_config_init(VirtualDeviceConfig* config);
+int virtual_device_parse_source(const char* spec, VirtualDeviceConfig* config);
+AudioBackend* virtual_device_create(const VirtualDeviceConfig* config);
+void virtual_device_stats(AudioBackend* backend, VirtualDeviceStats* stats);
+
+#endif
@@ -1,12 +1,45 @@
 #include "voice_modulator.h"
+#include "calibrate.h"
+#include "wav_io.h"
+#include "param_store.h"
+#include "rt_log.h"
+#include <errno.h>
+#include <time.h>
 
 // Global variables for threads and resources
 static pthread_t input_thread, processing_thread, output_thread;
 static int audio_running = 0; // Indicates if the audio pipeline is running
-static PaStream *input_stream, *output_stream;
-static float input_buffer[FRAME_SIZE];
-static float output_buffer[FRAME_SIZE];
-static CircularBuffer* audio_buffer;
+static AudioBackend* audio_backend = NULL; // Blocking I/O of the threaded pipeline
+static PaStream *duplex_stream;
+static int threads_started = 0; // Pipeline threads created (joined in creation order)
+static DuplexTiming duplex_timing;
+static DspPool* dsp_pool = NULL; // Workers for the phase vocoder's frame batches
+static DspChain* chain = NULL; // DSP state of the live pipeline
+static ParamStore live_params; // GUI -> audio thread parameter snapshots
+static ThreadSched callback_sched; // Applied by the first duplex callback
+static int callback_sched_pending = 0;
+// Frames of the threaded pipeline (in the chain's arena). They are handed
+// from stage to stage by pointer, so each stage writes a sample once and no
+// two threads ever touch the same frame.
+static FramePool* capture_pool;
+static FramePool* playback_pool;
+static FrameQueue* captured_frames; // Input thread -> processing thread
+static FrameQueue* free_capture;    // Processing thread -> input thread
+static FrameQueue* free_playback;   // Output thread (through the jitter buffer) -> processing thread
+static JitterBuffer* jitter_buffer; // Processing thread -> output thread
+static size_t live_frame_size;      // Samples per frame (params->frame_size)
+
+// Stage timings and xruns of the live pipeline
+static PipelineStats live_stats;
+
+// Periodic stats dump
+static pthread_t stats_thread;
+static int stats_thread_started = 0;
+static int stats_running = 0;
+static pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t stats_wake = PTHREAD_COND_INITIALIZER;
+static float stats_interval = 0.0f;
+static float latency_slo_ms = 0.0f;
 
 static ThreadSync sync = {
     .lock = PTHREAD_MUTEX_INITIALIZER,
@@ -19,142 +52,462 @@ static ThreadSync sync = {
 };
 
 // Function prototypes
-int capture_audio_input();
-int send_audio_output();
+int capture_audio_input(float* buffer);
+int send_audio_output(const float* buffer);
 void cleanup_audio_pipeline();
 void cleanup_audio_io();
 void* audio_input_thread(void* arg);
 void* audio_processing_thread(void* arg);
 void* audio_output_thread(void* arg);
 
-int init_audio_io(size_t sample_rate) {
-    PaError err = Pa_Initialize();
-    if (err != paNoError) {
-        printf("Error: Failed to initialize PortAudio: %s\n", Pa_GetErrorText(err));
+/**
+ * Starts the blocking I/O of the threaded pipeline on the backend the
+ * parameters select: the virtual device when one is configured, otherwise
+ * the default PortAudio devices.
+ *
+ * @param params The modulation parameters.
+ * @return 0 on success, -1 on failure.
+ */
+int init_audio_io(ModulationParams* params) {
+    audio_backend = params->virtual_device ? virtual_device_create(params->virtual_device)
+                                           : portaudio_backend_create();
+    if (!audio_backend) {
+        rt_log(RT_LOG_ERROR, "Failed to create the audio backend.");
+        return -1;
+    }
+    if (audio_backend->start(audio_backend, params->sample_rate, live_frame_size, params->device_latency) < 0) {
+        audio_backend_destroy(audio_backend);
+        audio_backend = NULL;
+        return -1;
+    }
+    if (audio_backend->latency) {
+        rt_log(RT_LOG_INFO, "Device latency: %.2f ms in + out (%.2f ms suggested per direction)",
+               audio_backend->latency(audio_backend) * 1000.0, params->device_latency * 1000.0);
+    }
+    return 0;
+}
+
+/**
+ * Reads one frame from the backend (input thread only).
+ *
+ * @param buffer Receives one frame (params->frame_size samples).
+ * @return AUDIO_IO_OK, AUDIO_IO_OVERFLOW (the frame is intact, input before
+ *         it was lost) or AUDIO_IO_ERROR.
+ */
+int capture_audio_input(float* buffer) {
+    AudioIoStatus status = audio_backend->read(audio_backend, buffer, live_frame_size);
+    if (status == AUDIO_IO_ERROR) {
+        RT_LOG_LIMITED(RT_LOG_ERROR, "Failed to read from input stream: %s",
+                       audio_backend->error_text ? audio_backend->error_text(audio_backend) : "unknown error");
+    }
+    return status;
+}
+
+/**
+ * Writes one frame to the backend (output thread only).
+ *
+ * @param buffer One frame.
+ * @return AUDIO_IO_OK, AUDIO_IO_UNDERFLOW (written, but the device had
+ *         already run dry) or AUDIO_IO_ERROR.
+ */
+int send_audio_output(const float* buffer) {
+    AudioIoStatus status = audio_backend->write(audio_backend, buffer, live_frame_size);
+    if (status == AUDIO_IO_ERROR) {
+        RT_LOG_LIMITED(RT_LOG_ERROR, "Failed to write to output stream: %s",
+                       audio_backend->error_text ? audio_backend->error_text(audio_backend) : "unknown error");
+    }
+    return status;
+}
+
+/**
+ * Computes the RMS level of a block.
+ *
+ * @param input The samples to measure.
+ * @param length The number of samples.
+ * @return The RMS level.
+ */
+float compute_frame_rms(const float* input, size_t length) {
+    return sqrtf(sum_of_squares(input, length) / length);
+}
+
+/**
+ * Applies a gain and hard-limits the result to [-1, 1] in place.
+ *
+ * @param samples The samples to scale.
+ * @param length The number of samples.
+ * @param gain The linear gain.
+ */
+void apply_gain_limiter(float* samples, size_t length, float gain) {
+    gain_and_clip(samples, length, gain);
+}
+
+/**
+ * Creates the DSP state of one pipeline.
+ *
+ * @param block_size The block length process_audio_frame() will be called
+ *                   with (see phase_vocoder_create()).
+ * @param sample_rate The sample rate in Hz.
+ * @param reverb_ir_path Impulse response for the convolution reverb, or NULL.
+ * @param lookahead The limiter's look-ahead in samples (see dynamics_create()).
+ * @return The chain, or NULL on failure.
+ */
+DspChain* dsp_chain_create(size_t block_size, size_t sample_rate, const char* reverb_ir_path,
+                           size_t lookahead) {
+    DspArena* arena = dsp_arena_create(DSP_ARENA_CHUNK);
+    DspChain* dsp = arena ? dsp_alloc(arena, sizeof(DspChain)) : NULL;
+    if (!dsp) {
+        printf("Error: Failed to allocate DSP chain\n");
+        dsp_arena_destroy(arena);
+        return NULL;
+    }
+
+    dsp->arena = arena;
+    dsp->sample_rate = sample_rate;
+    dsp->vocoder = phase_vocoder_create(block_size, arena);
+    dsp->wsola = wsola_create(sample_rate, arena);
+    dsp->engine = PITCH_ENGINE_PHASE_VOCODER;
+    dsp->echo = echo_create(sample_rate, arena);
+    dsp->reverb = reverb_create(sample_rate, reverb_ir_path, arena);
+    dsp->dynamics = dynamics_create(sample_rate, lookahead, arena);
+    if (!dsp->vocoder || !dsp->wsola || !dsp->echo || !dsp->reverb || !dsp->dynamics) {
+        dsp_chain_destroy(dsp);
+        return NULL;
+    }
+    return dsp;
+}
+
+/**
+ * Frees a pipeline's DSP state.
+ *
+ * @param dsp The chain (NULL is ignored).
+ */
+void dsp_chain_destroy(DspChain* dsp) {
+    if (!dsp) return;
+    phase_vocoder_destroy(dsp->vocoder);
+    wsola_destroy(dsp->wsola);
+    echo_destroy(dsp->echo);
+    reverb_destroy(dsp->reverb);
+    dynamics_destroy(dsp->dynamics);
+    dsp_arena_destroy(dsp->arena);  // Also frees dsp
+}
+
+/**
+ * @param dsp The chain.
+ * @param params The parameters the chain runs with (pitch engine and pitch).
+ * @return The delay from input to output in samples (the mean delay for
+ *         the WSOLA engine, whose delay moves with every splice), including
+ *         the limiter's look-ahead.
+ */
+size_t dsp_chain_latency(DspChain* dsp, const ModulationParams* params) {
+    if (params->pitch_engine == PITCH_ENGINE_WSOLA) {
+        return wsola_latency(dsp->wsola, params->pitch_factor) + dsp->dynamics->lookahead;
+    }
+    return phase_vocoder_latency(dsp->vocoder) + dsp->dynamics->lookahead;
+}
+
+/**
+ * Applies everything after the pitch shifter: the echo, the reverb, and the
+ * dynamics stage (noise gate, AGC and look-ahead limiter). The gate is keyed
+ * on the mix, so effect tails ring on until they fall below NOISE_FLOOR.
+ */
+static void apply_effects(DspChain* dsp, float* samples, size_t length, const ModulationParams* params) {
+    echo_process(dsp->echo, samples, length, params->echo_intensity, (float)params->echo_delay);
+    reverb_process(dsp->reverb, samples, length, params->reverb_intensity, params->reverb_mode);
+    dynamics_process(dsp->dynamics, samples, length);
+}
+
+/**
+ * Runs one block of audio through the modulation chain.
+ *
+ * This is the DSP shared by every pipeline mode: the pitch shifter chosen
+ * by params->pitch_engine (the streaming phase vocoder, which also
+ * time-stretches, or the low-latency WSOLA shifter) followed by
+ * apply_effects(). The engine being switched to starts from a clean
+ * state. It never blocks or allocates once the chain is created, so it can
+ * be called from a PortAudio callback. With dsp->stats set, the pitch and
+ * effects stages are timed and the block's DSP load is recorded.
+ *
+ * @param dsp The DSP state of the pipeline the samples belong to.
+ * @param input The captured samples.
+ * @param output The buffer that receives the processed samples.
+ * @param length The number of samples in input and output.
+ * @param params The modulation parameters for this block.
+ * @return 0 on success, -1 if the phase vocoder failed.
+ */
+int process_audio_frame(DspChain* dsp, const float* input, float* output, size_t length,
+                        const ModulationParams* params) {
+    if (!params) return -1;
+
+    PipelineStats* stats = dsp->stats;
+    uint64_t start = stats ? stats_now_ns() : 0;
+    unsigned long underruns = dsp->vocoder->underruns;
+
+    if (params->pitch_engine != dsp->engine) {
+        if (params->pitch_engine == PITCH_ENGINE_WSOLA) {
+            wsola_reset(dsp->wsola);
+        } else {
+            phase_vocoder_reset(dsp->vocoder);
+        }
+        dsp->engine = params->pitch_engine;
+    }
+
+    // Both engines stream, so the active one must see every frame
+    // (including silent ones) to keep its phase and overlap state intact
+    if (dsp->engine == PITCH_ENGINE_WSOLA) {
+        wsola_process(dsp->wsola, input, output, length, params->pitch_factor);
+    } else if (phase_vocoder_process(dsp->vocoder, input, output, length, params->pitch_factor,
+                                     params->speed_factor) < 0) {
         return -1;
     }
+    uint64_t pitched = stats ? stats_now_ns() : 0;
+
+    apply_effects(dsp, output, length, params);
 
-    // Print available devices
-    int numDevices = Pa_GetDeviceCount();
-    printf("Available audio devices:\n");
-    for(int i = 0; i < numDevices; i++) {
-        const PaDeviceInfo* deviceInfo = Pa_GetDeviceInfo(i);
-        printf("%d: %s (in: %d, out: %d)\n", 
-               i, deviceInfo->name, 
-               deviceInfo->maxInputChannels,
-               deviceInfo->maxOutputChannels);
+    if (stats) {
+        uint64_t end = stats_now_ns();
+        latency_histogram_record(&stats->stages[STAGE_PITCH], pitched - start);
+        latency_histogram_record(&stats->stages[STAGE_EFFECTS], end - pitched);
+        pipeline_stats_record_block(stats, end - start, length, dsp->sample_rate);
+        if (dsp->vocoder->underruns != underruns) {
+            stats_count(&stats->vocoder_underruns, dsp->vocoder->underruns - underruns);
+        }
+    }
+    return 0;
+}
+
+static double elapsed_seconds(const struct timespec* start, const struct timespec* end) {
+    return (double)(end->tv_sec - start->tv_sec) + (double)(end->tv_nsec - start->tv_nsec) * 1e-9;
+}
+
+static const char* pipeline_thread_names[PIPELINE_THREAD_COUNT] = { "input", "processing", "output" };
+
+/**
+ * @param thread The pipeline thread.
+ * @return Its name in --sched options and reports.
+ */
+const char* pipeline_thread_name(PipelineThread thread) {
+    return thread < PIPELINE_THREAD_COUNT ? pipeline_thread_names[thread] : "unknown";
+}
+
+// Explains a scheduling request that could not be (fully) applied
+static void report_sched_error(const char* thread, const ThreadSched* sched, int error) {
+    char requested[96];
+    thread_sched_format(sched, requested, sizeof(requested));
+    rt_log(RT_LOG_WARNING, "Could not give the %s thread %s (%s)%s", thread, requested, strerror(error),
+           error == EPERM ? "; real-time scheduling needs CAP_SYS_NICE or an rtprio limit" : "");
+}
+
+static void report_thread_sched(const char* thread, pthread_t handle) {
+    char actual[96];
+    thread_sched_describe(handle, actual, sizeof(actual));
+    rt_log(RT_LOG_INFO, "Scheduling: %s thread runs %s", thread, actual);
+}
+
+// The host API creates the callback thread, so the request is applied from
+// inside the first callback (before it counts as real-time)
+static void apply_callback_sched(void) {
+    callback_sched_pending = 0;
+    if (callback_sched.policy != SCHED_POLICY_DEFAULT || callback_sched.cpu >= 0) {
+        int error = thread_sched_apply(pthread_self(), &callback_sched);
+        if (error) report_sched_error("callback", &callback_sched, error);
+    }
+    report_thread_sched("callback", pthread_self());
+}
+
+/**
+ * PortAudio duplex callback: capture, DSP and playback in one place.
+ *
+ * Runs on the host API's real-time audio thread, so it only touches
+ * preallocated state. The timing fields are plain stores; readers get a
+ * best-effort snapshot through get_duplex_timing(). The parameters are
+ * picked up once per callback from the store the GUI publishes to.
+ */
+static int duplex_callback(const void* input, void* output, unsigned long frame_count,
+                           const PaStreamCallbackTimeInfo* time_info,
+                           PaStreamCallbackFlags status_flags, void* user_data) {
+    const ModulationParams* params = param_store_acquire((ParamStore*)user_data);
+    float* out = (float*)output;
+    struct timespec start, end;
+
+    if (callback_sched_pending) apply_callback_sched();
+    dsp_realtime_enter();
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    if (input == NULL || process_audio_frame(chain, (const float*)input, out, frame_count, params) < 0) {
+        memset(out, 0, frame_count * sizeof(float));
+    }
+
+    if (status_flags & paInputOverflow) {
+        duplex_timing.input_overflows++;
+        stats_count(&live_stats.input_overflows, 1);
+    }
+    if (status_flags & paOutputUnderflow) {
+        duplex_timing.output_underflows++;
+        stats_count(&live_stats.output_underflows, 1);
+    }
+
+    // Some host APIs leave the timestamps at zero
+    if (time_info && time_info->inputBufferAdcTime > 0 && time_info->outputBufferDacTime > 0) {
+        double latency = time_info->outputBufferDacTime - time_info->inputBufferAdcTime;
+        latency_histogram_record(&live_stats.stages[STAGE_END_TO_END], (uint64_t)(latency * 1e9));
+        duplex_timing.adc_to_dac_latency = latency;
+        if (latency > duplex_timing.max_adc_to_dac_latency) {
+            duplex_timing.max_adc_to_dac_latency = latency;
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double callback_time = elapsed_seconds(&start, &end);
+    duplex_timing.callback_time = callback_time;
+    if (callback_time > duplex_timing.max_callback_time) {
+        duplex_timing.max_callback_time = callback_time;
+    }
+    duplex_timing.frames = frame_count;
+    duplex_timing.callbacks++;
+
+    dsp_realtime_leave();
+    return paContinue;
+}
+
+/**
+ * Opens and starts a single full-duplex callback stream.
+ *
+ * The callback is driven in params->callback_size blocks (one hop by
+ * default): the streaming phase vocoder only needs one hop of new input
+ * per call, so there is no extra frame of buffering between capture and
+ * playback and no thread handoff at all. The callback runs the live DSP
+ * chain, which the caller creates for that block size beforehand.
+ *
+ * @param params The initial modulation parameters (the callback reads its
+ *               parameters from live_params).
+ * @return 0 on success, -1 on failure (PortAudio is terminated again).
+ */
+int init_audio_io_duplex(ModulationParams* params) {
+    PaError err = Pa_Initialize();
+    if (err != paNoError) {
+        rt_log(RT_LOG_ERROR, "Failed to initialize PortAudio: %s", Pa_GetErrorText(err));
+        return -1;
     }
 
     PaDeviceIndex inputDevice = Pa_GetDefaultInputDevice();
     PaDeviceIndex outputDevice = Pa_GetDefaultOutputDevice();
-    
-    printf("Using input device: %s\n", Pa_GetDeviceInfo(inputDevice)->name);
-    printf("Using output device: %s\n", Pa_GetDeviceInfo(outputDevice)->name);
+    if (inputDevice == paNoDevice || outputDevice == paNoDevice) {
+        rt_log(RT_LOG_ERROR, "No default input/output device for duplex stream.");
+        Pa_Terminate();
+        return -1;
+    }
+
+    rt_log(RT_LOG_INFO, "Using input device: %s", Pa_GetDeviceInfo(inputDevice)->name);
+    rt_log(RT_LOG_INFO, "Using output device: %s", Pa_GetDeviceInfo(outputDevice)->name);
 
-    // Input stream parameters
     PaStreamParameters inputParams = {
         .device = inputDevice,
         .channelCount = 1,
         .sampleFormat = paFloat32,
-        .suggestedLatency = 0.005,
+        .suggestedLatency = params->device_latency,
         .hostApiSpecificStreamInfo = NULL
     };
 
-    // Output stream parameters
     PaStreamParameters outputParams = {
         .device = outputDevice,
         .channelCount = 1,
         .sampleFormat = paFloat32,
-        .suggestedLatency = 0.005,
+        .suggestedLatency = params->device_latency,
         .hostApiSpecificStreamInfo = NULL
     };
 
-    printf("Opening input stream...\n");
-    err = Pa_OpenStream(&input_stream,
-                       &inputParams,
-                       NULL,
-                       sample_rate,
-                       FRAME_SIZE,
-                       paClipOff,
-                       NULL,
-                       NULL);
-    if (err != paNoError) {
-        printf("Error: Failed to open input stream: %s\n", Pa_GetErrorText(err));
-        return -1;
-    }
+    memset(&duplex_timing, 0, sizeof(duplex_timing));
 
-    printf("Opening output stream...\n");
-    err = Pa_OpenStream(&output_stream,
-                       NULL,
+    rt_log(RT_LOG_INFO, "Opening duplex stream...");
+    err = Pa_OpenStream(&duplex_stream,
+                       &inputParams,
                        &outputParams,
-                       sample_rate,
-                       FRAME_SIZE,
+                       params->sample_rate,
+                       params->callback_size,
                        paClipOff,
-                       NULL,
-                       NULL);
+                       duplex_callback,
+                       &live_params);
     if (err != paNoError) {
-        printf("Error: Failed to open output stream: %s\n", Pa_GetErrorText(err));
-        Pa_CloseStream(input_stream);
+        rt_log(RT_LOG_ERROR, "Failed to open duplex stream: %s", Pa_GetErrorText(err));
+        duplex_stream = NULL;
+        Pa_Terminate();
         return -1;
     }
 
-    // Start streams with debug prints
-    printf("Starting input stream...\n");
-    err = Pa_StartStream(input_stream);
+    rt_log(RT_LOG_INFO, "Starting duplex stream...");
+    err = Pa_StartStream(duplex_stream);
     if (err != paNoError) {
-        printf("Error: Failed to start input stream: %s\n", Pa_GetErrorText(err));
-        Pa_CloseStream(input_stream);
-        Pa_CloseStream(output_stream);
+        rt_log(RT_LOG_ERROR, "Failed to start duplex stream: %s", Pa_GetErrorText(err));
+        Pa_CloseStream(duplex_stream);
+        duplex_stream = NULL;
+        Pa_Terminate();
         return -1;
     }
 
-    printf("Starting output stream...\n");
-    err = Pa_StartStream(output_stream);
-    if (err != paNoError) {
-        printf("Error: Failed to start output stream: %s\n", Pa_GetErrorText(err));
-        Pa_StopStream(input_stream);
-        Pa_CloseStream(input_stream);
-        Pa_CloseStream(output_stream);
-        return -1;
+    const PaStreamInfo* info = Pa_GetStreamInfo(duplex_stream);
+    if (info) {
+        rt_log(RT_LOG_INFO, "Duplex stream: %.0f Hz, %zu frames/callback, input latency %.2f ms, output latency %.2f ms",
+               info->sampleRate, params->callback_size, info->inputLatency * 1000.0, info->outputLatency * 1000.0);
     }
+    rt_log(RT_LOG_INFO, "Algorithmic latency: %.2f ms",
+           dsp_chain_latency(chain, params) * 1000.0 / params->sample_rate);
 
-    printf("Audio I/O initialized successfully\n");
     return 0;
 }
 
-int capture_audio_input() {
-    if (Pa_ReadStream(input_stream, input_buffer, FRAME_SIZE) != paNoError) {
-        printf("Error: Failed to read from input stream.\n");
-        return -1;
+/**
+ * Copies the most recent duplex callback timing.
+ *
+ * @param timing Receives the timing snapshot (all zero in threaded mode).
+ */
+void get_duplex_timing(DuplexTiming* timing) {
+    if (timing) {
+        *timing = duplex_timing;
     }
-
-    pthread_mutex_lock(&sync.lock);
-    sync.input_ready_flag = 1;
-    pthread_cond_signal(&sync.input_ready);
-    pthread_mutex_unlock(&sync.lock);
-
-    return 0;
 }
 
-int send_audio_output() {
-    PaError err = Pa_WriteStream(output_stream, output_buffer, FRAME_SIZE);
-    if (err != paNoError) {
-        printf("Error writing to output stream: %s\n", Pa_GetErrorText(err));
-        return -1;
+/**
+ * Summarises the live pipeline's stage latencies, DSP load and xruns since
+ * it started. Lock-free and safe to call from any thread at any time.
+ *
+ * @param report Receives the snapshot.
+ */
+void get_pipeline_stats(PipelineStatsReport* report) {
+    if (report) {
+        pipeline_stats_report(&live_stats, report);
     }
-    return 0;
 }
 
-// Update audio_input_thread
+// Captures straight into pool frames and hands each one to the processing
+// thread once it is complete
 void* audio_input_thread(void* arg) {
+    Frame* frame = frame_queue_pop(free_capture);
+
     while (audio_running) {
-        if (Pa_ReadStream(input_stream, input_buffer, FRAME_SIZE) != paNoError) {
-            printf("Error: Failed to read from input stream.\n");
+        uint64_t start = stats_now_ns();
+        int status = capture_audio_input(frame->samples);
+        if (status == AUDIO_IO_OVERFLOW) {
+            // The block is intact; input before it was lost
+            stats_count(&live_stats.input_overflows, 1);
+        } else if (status != AUDIO_IO_OK) {
             continue;
         }
+        uint64_t captured = stats_now_ns();
+        latency_histogram_record(&live_stats.stages[STAGE_CAPTURE], captured - start);
 
+        // With every other frame queued or being processed, processing has
+        // fallen buffer_frames behind: the next block is captured over this one
+        Frame* next = frame_queue_pop(free_capture);
+        if (!next) {
+            stats_count(&live_stats.ring_overruns, 1);
+            continue;
+        }
+        frame->captured_ns = captured;
+        frame_queue_push(captured_frames, frame);
+        frame = next;
+
+        // The queues are lock-free; only the wakeup goes through sync.lock
         pthread_mutex_lock(&sync.lock);
-        circular_buffer_write(audio_buffer, input_buffer, FRAME_SIZE);
         sync.input_ready_flag = 1;
         pthread_cond_signal(&sync.input_ready);
         pthread_mutex_unlock(&sync.lock);
@@ -162,139 +515,663 @@ void* audio_input_thread(void* arg) {
     return NULL;
 }
 
+// Runs the DSP from a captured frame straight into a playback frame, returns
+// the captured frame to the input thread and queues the playback frame
 void* audio_processing_thread(void* arg) {
-    ModulationParams* params = (ModulationParams*)arg;
-    float temp_buffer[FRAME_SIZE];
-    float processed_buffer[FRAME_SIZE];
-    float fixed_gain = 2.0f;  // Fixed gain instead of dynamic
-    
+    ParamStore* store = (ParamStore*)arg;
+    Frame* output = frame_queue_pop(free_playback);
+
+    dsp_realtime_enter();
     while (audio_running) {
-        pthread_mutex_lock(&sync.lock);
-        while (!sync.input_ready_flag && audio_running) {
-            pthread_cond_wait(&sync.input_ready, &sync.lock);
+        // Drain the queue first and only sleep when it is empty
+        Frame* input = frame_queue_pop(captured_frames);
+        if (!input) {
+            pthread_mutex_lock(&sync.lock);
+            while (!sync.input_ready_flag && audio_running) {
+                pthread_cond_wait(&sync.input_ready, &sync.lock);
+            }
+            sync.input_ready_flag = 0;
+            pthread_mutex_unlock(&sync.lock);
+            continue;
         }
-        
-        circular_buffer_read(audio_buffer, temp_buffer, FRAME_SIZE);
-        sync.input_ready_flag = 0;
-        pthread_mutex_unlock(&sync.lock);
 
-        // Simple RMS check
-        float frame_rms = 0.0f;
-        for (int i = 0; i < FRAME_SIZE; i++) {
-            frame_rms += temp_buffer[i] * temp_buffer[i];
+        const ModulationParams* params = param_store_acquire(store);
+        int result = process_audio_frame(chain, input->samples, output->samples, live_frame_size, params);
+        output->captured_ns = input->captured_ns;
+        frame_queue_push(free_capture, input);
+        if (result < 0) {
+            continue;
         }
-        frame_rms = sqrtf(frame_rms / FRAME_SIZE);
 
-        if (frame_rms < NOISE_FLOOR) {
-            memset(output_buffer, 0, FRAME_SIZE * sizeof(float));
-        } else {
-            // Process audio with simplified phase vocoder
-            if (params && phase_vocoder(temp_buffer, processed_buffer, FRAME_SIZE, params->pitch_factor) >= 0) {
-                // Apply fixed gain and simple limiting
-                for (int i = 0; i < FRAME_SIZE; i++) {
-                    float sample = processed_buffer[i] * fixed_gain;
-                    // Simple limiter
-                    if (sample > 1.0f) sample = 1.0f;
-                    if (sample < -1.0f) sample = -1.0f;
-                    output_buffer[i] = sample;
-                }
-            }
+        // A full jitter buffer refuses the frame, which is then reused. The
+        // playback pool has a frame for every jitter buffer slot, the one
+        // being played and this one, so a queued frame is always replaced.
+        if (jitter_buffer_push(jitter_buffer, output, stats_now_ns()) == 0) {
+            output = frame_queue_pop(free_playback);
         }
 
         pthread_mutex_lock(&sync.lock);
-        sync.output_ready_flag = 1;
         pthread_cond_signal(&sync.output_ready);
         pthread_mutex_unlock(&sync.lock);
     }
+    dsp_realtime_leave();
     return NULL;
 }
 
+// Converts a CLOCK_MONOTONIC time to the CLOCK_REALTIME deadline that
+// pthread_cond_timedwait() expects
+static void monotonic_to_timespec(uint64_t deadline_ns, struct timespec* ts) {
+    clock_gettime(CLOCK_REALTIME, ts);
+    uint64_t now = stats_now_ns();
+    uint64_t wait = deadline_ns > now ? deadline_ns - now : 0;
+    ts->tv_sec += wait / 1000000000u;
+    ts->tv_nsec += wait % 1000000000u;
+    if (ts->tv_nsec >= 1000000000L) {
+        ts->tv_sec++;
+        ts->tv_nsec -= 1000000000L;
+    }
+}
+
+// Plays one frame per period from the jitter buffer: waits for the next
+// frame, but only until its deadline, then lets the buffer conceal it
 void* audio_output_thread(void* arg) {
-    int frames_output = 0;
-    
     while (audio_running) {
         pthread_mutex_lock(&sync.lock);
-        while (!sync.output_ready_flag && audio_running) {
-            pthread_cond_wait(&sync.output_ready, &sync.lock);
+        uint64_t wake;
+        while (audio_running && (wake = jitter_buffer_poll(jitter_buffer, stats_now_ns())) != 0) {
+            if (wake == UINT64_MAX) {
+                pthread_cond_wait(&sync.output_ready, &sync.lock);
+            } else {
+                struct timespec deadline;
+                monotonic_to_timespec(wake, &deadline);
+                pthread_cond_timedwait(&sync.output_ready, &sync.lock, &deadline);
+            }
         }
-        sync.output_ready_flag = 0;
         pthread_mutex_unlock(&sync.lock);
+        if (!audio_running) break;
+
+        Frame* frame;
+        jitter_buffer_pop(jitter_buffer, stats_now_ns(), &frame);
+        uint64_t captured = frame->captured_ns;
 
-        PaError err = Pa_WriteStream(output_stream, output_buffer, FRAME_SIZE);
-        if (err != paNoError) {
-            printf("Error: Failed to write to output stream: %s\n", Pa_GetErrorText(err));
+        uint64_t start = stats_now_ns();
+        int status = send_audio_output(frame->samples);
+        uint64_t played = stats_now_ns();
+        jitter_buffer_written(jitter_buffer, start, played, status == AUDIO_IO_UNDERFLOW);
+        if (status == AUDIO_IO_UNDERFLOW) {
+            // Written, but the device had already run dry
+            stats_count(&live_stats.output_underflows, 1);
+        } else if (status != AUDIO_IO_OK) {
             continue;
         }
 
-        frames_output++;
-        if(frames_output % 100 == 0) {  // Print every 100 frames
-            printf("Output frame %d\n", frames_output);
+        latency_histogram_record(&live_stats.stages[STAGE_PLAYBACK], played - start);
+        if (captured != 0) {
+            latency_histogram_record(&live_stats.stages[STAGE_END_TO_END], played - captured);
         }
     }
     return NULL;
 }
 
-// Update init_audio_pipeline
-int init_audio_pipeline(ModulationParams* params) {
+/**
+ * Copies the state of the threaded pipeline's jitter buffer. Safe to call
+ * from any thread while the pipeline runs.
+ *
+ * @param stats Receives the snapshot.
+ * @return 0 on success, -1 if no jitter buffer is running (duplex mode).
+ */
+int get_jitter_buffer_stats(JitterBufferStats* stats) {
+    if (!jitter_buffer || !stats) return -1;
+    jitter_buffer_stats(jitter_buffer, stats);
+    return 0;
+}
+
+static void print_jitter_buffer_stats(const JitterBufferStats* stats, const char* label) {
+    printf("%s: jitter buffer adds %.2f ms (%zu frames queued), arrival jitter %.3f ms, "
+           "%lu underruns, %lu grows, %lu shrinks, %lu overflows\n",
+           label, stats->latency * 1000.0, stats->depth, stats->jitter * 1000.0,
+           stats->underruns, stats->grows, stats->shrinks, stats->overflows);
+}
+
+/**
+ * Prints a warning when the end-to-end p99 latency is over latency_slo_ms.
+ */
+static void check_latency_slo(const PipelineStatsReport* report) {
+    const LatencySummary* e2e = &report->stages[STAGE_END_TO_END];
+    if (latency_slo_ms > 0 && e2e->count > 0 && e2e->p99 * 1000.0 > latency_slo_ms) {
+        printf("Warning: End-to-end p99 latency %.2f ms is over the %.2f ms budget\n",
+               e2e->p99 * 1000.0, latency_slo_ms);
+    }
+}
+
+/**
+ * Prints the live stats every stats_interval seconds, with the DSP load of
+ * the last interval, until stop_stats_thread(). Only reads the counters,
+ * so the audio threads never wait for it.
+ */
+static void* stats_dump_thread(void* arg) {
+    PipelineStatsReport report;
+    JitterBufferStats jitter;
+    double last_busy = 0.0, last_audio = 0.0;
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+
+    pthread_mutex_lock(&stats_lock);
+    while (stats_running) {
+        long interval_ns = (long)(stats_interval * 1e9);
+        deadline.tv_sec += interval_ns / 1000000000L;
+        deadline.tv_nsec += interval_ns % 1000000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        while (stats_running && pthread_cond_timedwait(&stats_wake, &stats_lock, &deadline) == 0) {
+        }
+        if (!stats_running) break;
+        pthread_mutex_unlock(&stats_lock);
+
+        get_pipeline_stats(&report);
+        double audio = report.audio_seconds - last_audio;
+        printf("Stats: DSP load %.1f%% over the last %.1f s\n",
+               audio > 0 ? (report.busy_seconds - last_busy) * 100.0 / audio : 0.0, stats_interval);
+        pipeline_stats_print(&report, "Stats");
+        if (get_jitter_buffer_stats(&jitter) == 0) print_jitter_buffer_stats(&jitter, "Stats");
+        check_latency_slo(&report);
+        last_busy = report.busy_seconds;
+        last_audio = report.audio_seconds;
+
+        pthread_mutex_lock(&stats_lock);
+    }
+    pthread_mutex_unlock(&stats_lock);
+    return NULL;
+}
+
+static void start_stats_thread(const ModulationParams* params) {
+    stats_interval = params->stats_interval;
+    latency_slo_ms = params->latency_slo_ms;
+    if (stats_interval <= 0) return;
+
+    stats_running = 1;
+    if (pthread_create(&stats_thread, NULL, stats_dump_thread, NULL) != 0) {
+        printf("Warning: Failed to start the stats thread; stats are only printed at exit.\n");
+        stats_running = 0;
+        return;
+    }
+    stats_thread_started = 1;
+}
+
+static void stop_stats_thread(void) {
+    pthread_mutex_lock(&stats_lock);
+    stats_running = 0;
+    pthread_cond_broadcast(&stats_wake);
+    pthread_mutex_unlock(&stats_lock);
+    if (stats_thread_started) pthread_join(stats_thread, NULL);
+    stats_thread_started = 0;
+}
+
+static void report_startup(const struct timespec* start) {
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    rt_log(RT_LOG_INFO, "Startup: %.1f ms (FFT planning %.1f ms)",
+           elapsed_seconds(start, &end) * 1000.0, fft_planner_seconds() * 1000.0);
+}
+
+/**
+ * Closes the live chain's arena to further allocation and locks it in RAM.
+ * Called once everything the audio path touches has been allocated, just
+ * before the streams start.
+ */
+static void seal_live_memory(DspChain* dsp) {
+    dsp_arena_freeze(dsp->arena);
+    if (dsp_arena_lock(dsp->arena) < 0) {
+        rt_log(RT_LOG_WARNING, "Could not lock %zu KB of DSP memory (raise the memlock limit); "
+               "page faults remain possible", dsp->arena->reserved / 1024);
+    } else {
+        rt_log(RT_LOG_INFO, "DSP memory: %zu KB locked", dsp->arena->reserved / 1024);
+    }
+}
+
+/**
+ * Starts one thread of the threaded pipeline with the scheduling requested
+ * for it. A request that is refused is reported and the thread runs anyway.
+ *
+ * @return 0 on success, -1 if the thread could not be created.
+ */
+static int start_pipeline_thread(pthread_t* thread, PipelineThread which, void* (*start)(void*), void* arg,
+                                 const ModulationParams* params) {
+    int sched_error;
+    if (thread_sched_create(thread, &params->sched[which], start, arg, &sched_error) != 0) {
+        return -1;
+    }
+    if (sched_error) {
+        report_sched_error(pipeline_thread_name(which), &params->sched[which], sched_error);
+    }
+    return 0;
+}
+
+// The processing thread waits for the DSP pool inside every block, so the
+// workers get its policy and priority (they keep their own cores)
+static void apply_pool_sched(DspPool* pool, const ThreadSched* sched) {
+    if (!pool || sched->policy == SCHED_POLICY_DEFAULT) return;
+    ThreadSched worker = *sched;
+    worker.cpu = -1;
+    for (int i = 0; i < pool->num_workers; i++) {
+        int error = thread_sched_apply(pool->threads[i], &worker);
+        if (error) {
+            report_sched_error("DSP pool", &worker, error);
+            return;
+        }
+    }
+}
+
+// Fills in the defaults of the live block sizes and buffering left at 0
+static void resolve_live_config(ModulationParams* params) {
+    if (params->frame_size == 0) params->frame_size = LIVE_FRAME_SIZE;
+    if (params->callback_size == 0) params->callback_size = LIVE_CALLBACK_SIZE;
+    if (params->buffer_frames == 0) params->buffer_frames = LIVE_BUFFER_FRAMES;
+    if (params->device_latency <= 0.0) params->device_latency = LIVE_DEVICE_LATENCY;
+}
+
+// Body of init_audio_pipeline(); everything it prints goes through rt_log
+static int start_audio_pipeline(ModulationParams* params) {
     if (params == NULL) {
-        printf("Error: ModulationParams is NULL.\n");
+        rt_log(RT_LOG_ERROR, "ModulationParams is NULL.");
         return -1;
     }
 
-    // Initialize circular buffer
-    audio_buffer = create_circular_buffer(BUFFER_SIZE);
-    if (!audio_buffer) {
-        printf("Error: Failed to create audio buffer.\n");
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    pipeline_stats_reset(&live_stats);
+    if (fft_planner_configure(params->fft_rigor, params->wisdom_path) < 0) {
         return -1;
     }
 
-    if (init_audio_io(params->sample_rate) < 0) {
-        printf("Error: Failed to initialize audio I/O.\n");
+    // The virtual device is blocking I/O, so it always drives the threads
+    if (params->virtual_device) {
+        params->pipeline_mode = PIPELINE_MODE_THREADED;
+    }
+
+    resolve_live_config(params);
+    if (params->calibrate_miss_rate > 0.0f && calibrate_live_config(params) < 0) {
+        return -1;
+    }
+    param_store_init(&live_params, params);
+
+    if (params->pipeline_mode == PIPELINE_MODE_DUPLEX) {
+        chain = dsp_chain_create(params->callback_size, params->sample_rate, params->reverb_ir_path,
+                                 params->lookahead);
+        fft_planner_save_wisdom();
+        if (chain) {
+            chain->stats = &live_stats;
+            seal_live_memory(chain);
+        }
+        callback_sched = params->sched[PIPELINE_THREAD_PROCESSING];
+        callback_sched_pending = 1;
+        if (chain && init_audio_io_duplex(params) == 0) {
+            rt_log(RT_LOG_INFO, "Audio pipeline running in duplex callback mode");
+            report_startup(&start);
+            start_stats_thread(params);
+            return 0;
+        }
+        dsp_chain_destroy(chain);
+        chain = NULL;
+        rt_log(RT_LOG_WARNING, "Duplex mode unavailable, falling back to threaded pipeline.");
+        params->pipeline_mode = PIPELINE_MODE_THREADED;
+    }
+
+    // The processing thread hands the phase vocoder whole frames (several
+    // hops), which the pool can split when it measurably pays off
+    live_frame_size = params->frame_size;
+    chain = dsp_chain_create(live_frame_size, params->sample_rate, params->reverb_ir_path,
+                             params->lookahead);
+    if (!chain) {
+        rt_log(RT_LOG_ERROR, "Failed to create DSP chain.");
+        return -1;
+    }
+    chain->stats = &live_stats;
+    dsp_pool = dsp_pool_create(0, 1);
+    phase_vocoder_set_pool(chain->vocoder, dsp_pool);
+    apply_pool_sched(dsp_pool, &params->sched[PIPELINE_THREAD_PROCESSING]);
+    fft_planner_save_wisdom();
+
+    // The frame pools and queues share the chain's arena. A capture frame is
+    // being filled, queued or being processed; a playback frame is being
+    // processed, in the jitter buffer or being played. Every queue can hold
+    // a whole pool, so a push never fails.
+    capture_pool = frame_pool_create(chain->arena, params->buffer_frames + 2, live_frame_size);
+    playback_pool = frame_pool_create(chain->arena, JITTER_BUFFER_MAX_FRAMES + 2, live_frame_size);
+    if (capture_pool && playback_pool) {
+        captured_frames = frame_queue_create(chain->arena, capture_pool->count);
+        free_capture = frame_queue_create(chain->arena, capture_pool->count);
+        free_playback = frame_queue_create(chain->arena, playback_pool->count);
+    }
+    // The jitter buffer schedules in wall-clock time, which the virtual
+    // device's clock may outrun
+    size_t device_rate = params->virtual_device
+                             ? (size_t)(params->sample_rate * params->virtual_device->clock_scale)
+                             : params->sample_rate;
+    jitter_buffer = jitter_buffer_create(chain->arena, live_frame_size, device_rate, params->jitter_underrun_rate,
+                                         free_playback);
+    if (!captured_frames || !free_capture || !jitter_buffer ||
+        frame_queue_fill(free_capture, capture_pool, 0, capture_pool->count) < 0 ||
+        frame_queue_fill(free_playback, playback_pool, 0, playback_pool->count) < 0) {
+        rt_log(RT_LOG_ERROR, "Failed to create audio buffer.");
+        return -1;
+    }
+    seal_live_memory(chain);
+
+    if (init_audio_io(params) < 0) {
+        rt_log(RT_LOG_ERROR, "Failed to initialize audio I/O.");
         return -1;
     }
 
     audio_running = 1;
 
-    if (pthread_create(&input_thread, NULL, audio_input_thread, params) != 0) {
-        printf("Error: Failed to create input thread.\n");
+    if (start_pipeline_thread(&input_thread, PIPELINE_THREAD_INPUT, audio_input_thread, params, params) < 0) {
+        rt_log(RT_LOG_ERROR, "Failed to create input thread.");
         cleanup_audio_pipeline();
         return -1;
     }
+    threads_started++;
 
-    if (pthread_create(&processing_thread, NULL, audio_processing_thread, params) != 0) {
-        printf("Error: Failed to create processing thread.\n");
+    if (start_pipeline_thread(&processing_thread, PIPELINE_THREAD_PROCESSING, audio_processing_thread,
+                              &live_params, params) < 0) {
+        rt_log(RT_LOG_ERROR, "Failed to create processing thread.");
         cleanup_audio_pipeline();
         return -1;
     }
+    threads_started++;
 
-    if (pthread_create(&output_thread, NULL, audio_output_thread, params) != 0) {
-        printf("Error: Failed to create output thread.\n");
+    if (start_pipeline_thread(&output_thread, PIPELINE_THREAD_OUTPUT, audio_output_thread, params, params) < 0) {
+        rt_log(RT_LOG_ERROR, "Failed to create output thread.");
         cleanup_audio_pipeline();
         return -1;
     }
+    threads_started++;
 
+    report_thread_sched("input", input_thread);
+    report_thread_sched("processing", processing_thread);
+    report_thread_sched("output", output_thread);
+    if (dsp_pool) {
+        char actual[96];
+        thread_sched_describe(dsp_pool->threads[0], actual, sizeof(actual));
+        rt_log(RT_LOG_INFO, "Scheduling: %d DSP pool workers run %s (worker 1)", dsp_pool->num_workers, actual);
+    }
+
+    report_startup(&start);
+    start_stats_thread(params);
     return 0;
 }
 
+/**
+ * Builds every DSP resource and starts the audio streams.
+ *
+ * All FFT plans are created (normally straight from the wisdom cache) and the
+ * cache is saved before any stream starts, so the first callback never waits
+ * for the FFTW planner. The total startup time is reported.
+ *
+ * The audio thread never reads `params` itself: it starts from a copy, and
+ * later changes reach it through publish_modulation_params().
+ *
+ * The real-time log drainer starts here; messages from the audio threads
+ * go through it until cleanup_audio_pipeline().
+ *
+ * @param params The modulation parameters owned by the GUI.
+ * @return 0 on success, -1 on failure.
+ */
+int init_audio_pipeline(ModulationParams* params) {
+    rt_log_start();
+    int result = start_audio_pipeline(params);
+    rt_log_flush();
+    return result;
+}
+
+/**
+ * Writes offline output, dropping the first *to_skip samples (the chain
+ * delay) and anything past `limit` samples in total.
+ *
+ * @return 0 on success, -1 if the file could not be written.
+ */
+static int write_trimmed(WavWriter* writer, const char* path, const float* samples, size_t length,
+                         size_t* to_skip, size_t* written, size_t limit) {
+    size_t offset = *to_skip < length ? *to_skip : length;
+    *to_skip -= offset;
+    size_t count = length - offset;
+    if (count > limit - *written) count = limit - *written;
+
+    if (count > 0 && wav_write_frames(writer, samples + offset, count) < 0) {
+        printf("Error: Failed to write %s.\n", path);
+        return -1;
+    }
+    *written += count;
+    return 0;
+}
+
+/**
+ * Streams a WAV file through the modulation chain without a sound card.
+ *
+ * The file is processed in FRAME_SIZE blocks with process_audio_frame(),
+ * exactly as the threaded pipeline does, but as fast as the CPU allows.
+ * The pitch shifter's startup delay is trimmed and its tail flushed with
+ * silence so the output is sample-aligned with the input and has the same
+ * length. The realtime factor (audio duration / wall time) is reported.
+ *
+ * At a speed_factor other than 1 there is no live deadline to respect, so
+ * the stretch is unbounded: every block is pushed into the phase vocoder
+ * and everything it produces is run through the effects (gated on its own
+ * level) and written, giving an output 1 / speed_factor times as long.
+ * The WSOLA pitch engine does not time-stretch and ignores speed_factor.
+ *
+ * @param input_path The WAV file to read (downmixed to mono).
+ * @param output_path The mono 32-bit float WAV file to write.
+ * @param params The modulation parameters; sample_rate is taken from the file.
+ * @return 0 on success, -1 on failure.
+ */
+int run_offline_pipeline(const char* input_path, const char* output_path, ModulationParams* params) {
+    if (!input_path || !output_path || !params) {
+        printf("Error: Offline mode needs an input file, an output file and parameters.\n");
+        return -1;
+    }
+
+    WavReader* reader = wav_reader_open(input_path);
+    if (!reader) return -1;
+    params->sample_rate = reader->sample_rate;
+
+    WavWriter* writer = wav_writer_open(output_path, reader->sample_rate);
+    if (!writer) {
+        wav_reader_close(reader);
+        return -1;
+    }
+
+    DspChain* dsp = NULL;
+    if (fft_planner_configure(params->fft_rigor, params->wisdom_path) == 0) {
+        dsp = dsp_chain_create(FRAME_SIZE, params->sample_rate, params->reverb_ir_path,
+                               params->lookahead);
+        fft_planner_save_wisdom();
+    }
+    if (!dsp) {
+        wav_writer_close(writer);
+        wav_reader_close(reader);
+        return -1;
+    }
+    DspPool* pool = dsp_pool_create(0, 1);
+    phase_vocoder_set_pool(dsp->vocoder, pool);
+    PipelineStats stats;
+    pipeline_stats_reset(&stats);
+    dsp->stats = &stats;
+
+    float in[FRAME_SIZE];
+    float out[FRAME_SIZE];
+    const size_t total = reader->total_frames;
+    const int stretch = params->speed_factor != 1.0f &&
+                        params->pitch_engine == PITCH_ENGINE_PHASE_VOCODER;
+    const size_t expected = stretch ? (size_t)(total / params->speed_factor + 0.5f) : total;
+    size_t to_skip = dsp_chain_latency(dsp, params);
+    size_t written = 0;
+    int result = 0;
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    while (written < expected && result == 0) {
+        size_t n = wav_read_frames(reader, in, FRAME_SIZE);
+        if (n < FRAME_SIZE) {
+            memset(in + n, 0, (FRAME_SIZE - n) * sizeof(float));
+        }
+
+        if (!stretch) {
+            if (process_audio_frame(dsp, in, out, FRAME_SIZE, params) < 0) {
+                printf("Error: Processing failed at sample %zu.\n", written);
+                result = -1;
+                break;
+            }
+            result = write_trimmed(writer, output_path, out, FRAME_SIZE, &to_skip, &written, expected);
+            continue;
+        }
+
+        size_t pushed = 0;
+        while (pushed < FRAME_SIZE && result == 0) {
+            size_t accepted = phase_vocoder_push(dsp->vocoder, in + pushed, FRAME_SIZE - pushed,
+                                                 params->pitch_factor, params->speed_factor);
+            pushed += accepted;
+
+            size_t count = phase_vocoder_pull(dsp->vocoder, out, FRAME_SIZE);
+            if (accepted == 0 && count == 0) {
+                printf("Error: Processing failed at sample %zu.\n", written);
+                result = -1;
+                break;
+            }
+            while (count > 0 && result == 0) {
+                apply_effects(dsp, out, count, params);
+                result = write_trimmed(writer, output_path, out, count, &to_skip, &written, expected);
+                count = phase_vocoder_pull(dsp->vocoder, out, FRAME_SIZE);
+            }
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    if (wav_writer_close(writer) < 0) {
+        printf("Error: Failed to finalize %s.\n", output_path);
+        result = -1;
+    }
+    wav_reader_close(reader);
+
+    if (result == 0) {
+        double wall = elapsed_seconds(&start, &end);
+        double audio = (double)total / params->sample_rate;
+        printf("Processed %zu samples (%.2f s of audio at %zu Hz) in %.3f s: realtime factor %.1fx\n",
+               total, audio, params->sample_rate, wall, wall > 0 ? audio / wall : 0.0);
+        if (stretch) {
+            printf("Time stretch: speed %.2f, %zu output samples (%.2f s)\n",
+                   params->speed_factor, written, (double)written / params->sample_rate);
+        } else {
+            PipelineStatsReport report;
+            pipeline_stats_report(&stats, &report);
+            pipeline_stats_print(&report, "Timing");
+        }
+    }
+
+    dsp_chain_destroy(dsp);
+    dsp_pool_destroy(pool);
+    return result;
+}
+
 void cleanup_audio_pipeline() {
+    stop_stats_thread();
+
+    pthread_mutex_lock(&sync.lock);
     audio_running = 0;
+    pthread_cond_broadcast(&sync.input_ready);
+    pthread_cond_broadcast(&sync.output_ready);
+    pthread_mutex_unlock(&sync.lock);
 
-    pthread_join(input_thread, NULL);
-    pthread_join(processing_thread, NULL);
-    pthread_join(output_thread, NULL);
+    if (threads_started > 0) pthread_join(input_thread, NULL);
+    if (threads_started > 1) pthread_join(processing_thread, NULL);
+    if (threads_started > 2) pthread_join(output_thread, NULL);
+    threads_started = 0;
 
     cleanup_audio_io();
-    cleanup_phase_vocoder();
+    rt_log_stop();
+    if (audio_backend) {
+        if (audio_backend->report) audio_backend->report(audio_backend);
+        audio_backend_destroy(audio_backend);
+        audio_backend = NULL;
+    }
+    if (chain && chain->vocoder->backlog_peak > 0) {
+        printf("Time stretch: peak backlog %.1f ms (limit %.1f ms), %lu blocks slower/faster than requested\n",
+               chain->vocoder->backlog_peak * 1000.0 / chain->sample_rate,
+               PV_STRETCH_MAX_BACKLOG * 1000.0 / chain->sample_rate, chain->vocoder->stretch_limited);
+    }
+    // The frames, their queues and the jitter buffer live in the chain's arena
+    JitterBufferStats jitter;
+    int have_jitter = get_jitter_buffer_stats(&jitter) == 0;
+    jitter_buffer_destroy(jitter_buffer);
+    frame_queue_destroy(captured_frames);
+    frame_queue_destroy(free_capture);
+    frame_queue_destroy(free_playback);
+    frame_pool_destroy(capture_pool);
+    frame_pool_destroy(playback_pool);
+    jitter_buffer = NULL;
+    captured_frames = free_capture = free_playback = NULL;
+    capture_pool = playback_pool = NULL;
+    dsp_chain_destroy(chain);
+    chain = NULL;
+    dsp_pool_destroy(dsp_pool);
+    dsp_pool = NULL;
+
+    if (duplex_timing.callbacks > 0) {
+        printf("Duplex callbacks: %lu x %lu frames, adc->dac latency %.2f ms (max %.2f ms), "
+               "callback time max %.3f ms, input overflows %lu, output underflows %lu\n",
+               duplex_timing.callbacks, duplex_timing.frames,
+               duplex_timing.adc_to_dac_latency * 1000.0, duplex_timing.max_adc_to_dac_latency * 1000.0,
+               duplex_timing.max_callback_time * 1000.0,
+               duplex_timing.input_overflows, duplex_timing.output_underflows);
+    }
+
+    PipelineStatsReport report;
+    get_pipeline_stats(&report);
+    if (report.blocks > 0) {
+        pipeline_stats_print(&report, "Pipeline");
+        if (have_jitter) print_jitter_buffer_stats(&jitter, "Pipeline");
+        check_latency_slo(&report);
+    }
+
+    RtLogCounts log_counts;
+    rt_log_counts(&log_counts);
+    if (log_counts.dropped > 0 || log_counts.suppressed > 0) {
+        printf("Log: %lu messages, %lu dropped (ring full), %lu suppressed by rate limits\n",
+               log_counts.logged, log_counts.dropped, log_counts.suppressed);
+    }
 }
 
 void cleanup_audio_io() {
-    if (input_stream) Pa_CloseStream(input_stream);
-    if (output_stream) Pa_CloseStream(output_stream);
-    Pa_Terminate();
+    if (duplex_stream) {
+        Pa_StopStream(duplex_stream);
+        Pa_CloseStream(duplex_stream);
+        duplex_stream = NULL;
+        Pa_Terminate();
+    }
+    // Stopped here; its report is printed and it is freed with the pipeline
+    if (audio_backend) audio_backend->stop(audio_backend);
+}
+
+/**
+ * Hands a complete parameter set to the live pipeline. It takes effect at
+ * the start of the next block; the pitch shifters, echo and reverb glide to
+ * the new values. Must only be called from one thread (the GUI thread).
+ *
+ * @param params The parameters to publish (copied).
+ */
+void publish_modulation_params(const ModulationParams* params) {
+    if (params) {
+        param_store_publish(&live_params, params);
+    }
 }
 
 void update_modulation_params(ModulationParams* params, float new_pitch) {
     if (params) {
         params->pitch_factor = new_pitch;
+        publish_modulation_params(params);
     }
 }
\ No newline at end of file
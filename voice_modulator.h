@@ -1,37 +1,94 @@
+#ifndef VOICE_MODULATOR_H
+#define VOICE_MODULATOR_H
+
 #include "phase_vocoder.h"
+#include "echo.h"
+#include "reverb.h"
+#include "wsola.h"
+#include "pipeline_stats.h"
+#include "thread_sched.h"
+#include "virtual_device.h"
+#include "jitter_buffer.h"
+#include "dynamics.h"
 #include <string.h> 
 #include <stdio.h>
 #include <pthread.h>
 #include "portaudio.h"
 
-#ifndef FRAME_SIZE
-#define FRAME_SIZE 256
-#endif
-#ifndef OVERLAP_RATIO
-#define OVERLAP_RATIO 4  
-#endif
-#ifndef HOP_SIZE
-#define HOP_SIZE (FRAME_SIZE / OVERLAP_RATIO)
-#endif
-#ifdef BUFFER_SIZE
-#define BUFFER_SIZE (FRAME_SIZE * 8) 
-#endif
+// FRAME_SIZE (the FFT length), HOP_SIZE and BUFFER_SIZE come from
+// phase_vocoder.h. The live pipeline's own block sizes are runtime
+// parameters; these are their defaults and limits.
+#define LIVE_FRAME_SIZE FRAME_SIZE                  // Samples per threaded-pipeline frame
+#define LIVE_CALLBACK_SIZE HOP_SIZE                 // Samples per duplex callback
+#define LIVE_BUFFER_FRAMES (BUFFER_SIZE / FRAME_SIZE) // Captured frames processing may fall behind by
+#define LIVE_DEVICE_LATENCY 0.005                   // Latency asked of PortAudio per direction (seconds)
+#define LIVE_MIN_BLOCK_SIZE 16
+#define LIVE_MAX_BLOCK_SIZE (16 * HOP_SIZE)
+#define LIVE_MAX_BUFFER_FRAMES 64
+
+// How audio moves between the device and the DSP chain
+typedef enum {
+    PIPELINE_MODE_THREADED = 0,  // Blocking streams with input/processing/output threads (fallback)
+    PIPELINE_MODE_DUPLEX         // One full-duplex PortAudio callback does capture, DSP and playback
+} PipelineMode;
+
+// Threads of the live pipeline whose scheduling can be configured. In duplex
+// mode the callback thread uses the processing entry.
+typedef enum {
+    PIPELINE_THREAD_INPUT = 0,
+    PIPELINE_THREAD_PROCESSING,  // Also the DSP pool workers (policy and priority only)
+    PIPELINE_THREAD_OUTPUT,
+    PIPELINE_THREAD_COUNT
+} PipelineThread;
 
-#define NOISE_FLOOR 0.001f
-#define TARGET_RMS 0.3f
-#define GAIN_SMOOTH_FACTOR 0.001f  
-#define RMS_SMOOTH_FACTOR 0.01f
+// Which pitch shifter a pipeline runs
+typedef enum {
+    PITCH_ENGINE_PHASE_VOCODER = 0,  // STFT phase vocoder: best quality, also time-stretches
+    PITCH_ENGINE_WSOLA               // Time-domain WSOLA splicing: a few ms of latency, speed ignored
+} PitchEngine;
 
 // Data structure to hold voice modulation parameters
 typedef struct {
     float pitch_factor;      // Pitch shifting
-    float speed_factor;      // Speed adjustment
+    PitchEngine pitch_engine; // Pitch shifter used by the pipeline
+    float speed_factor;      // Time stretch (PV_MIN_SPEED - PV_MAX_SPEED, 1 = off)
     float echo_intensity;    // Intensity of the echo effect (0.0 - 1.0)
     float reverb_intensity;  // Intensity of the reverb effect (0.0 - 1.0)
-    size_t echo_delay;       // Echo delay 
+    size_t echo_delay;       // Echo delay in milliseconds (up to ECHO_MAX_DELAY_MS)
     size_t sample_rate;      // Audio sample rate 
+    PipelineMode pipeline_mode; // Requested I/O mode; falls back to threaded if duplex fails
+    FftRigor fft_rigor;      // FFTW planning rigor
+    const char* wisdom_path; // FFTW wisdom cache file (NULL = none)
+    ReverbMode reverb_mode;  // Convolution (needs reverb_ir_path) or FDN
+    const char* reverb_ir_path; // Impulse response WAV for the convolution reverb (NULL = none)
+    float stats_interval;    // Seconds between live timing dumps (0 = only at exit)
+    float latency_slo_ms;    // End-to-end p99 budget checked by every dump (0 = none)
+    ThreadSched sched[PIPELINE_THREAD_COUNT]; // Requested policy, priority and core per live thread
+    const VirtualDeviceConfig* virtual_device; // Live I/O on a virtual device (NULL = sound card)
+    float jitter_underrun_rate; // Fraction of frames the threaded pipeline's jitter buffer may conceal
+    size_t frame_size;       // Samples per threaded-pipeline frame (0 = LIVE_FRAME_SIZE)
+    size_t callback_size;    // Samples per duplex callback (0 = LIVE_CALLBACK_SIZE)
+    size_t buffer_frames;    // Capture depth of the threaded pipeline in frames (0 = LIVE_BUFFER_FRAMES)
+    double device_latency;   // Suggested PortAudio latency in seconds (0 = LIVE_DEVICE_LATENCY)
+    float calibrate_miss_rate; // > 0: measure this machine at startup and pick the block size (see calibrate.h)
+    size_t lookahead;        // Limiter look-ahead in samples, also added to the latency (0 = none)
 } ModulationParams;
 
+// Per-pipeline DSP state. Every pipeline (the live one, offline mode and each
+// server stream) owns its own chain, so chains never share state. The chain
+// and everything in it come from one arena, released with the chain.
+typedef struct {
+    DspArena* arena;
+    PhaseVocoder* vocoder;
+    WsolaShifter* wsola;
+    PitchEngine engine;      // Pitch shifter the chain last ran
+    EchoEngine* echo;
+    ReverbEngine* reverb;
+    DynamicsProcessor* dynamics;
+    PipelineStats* stats;    // Stage timings are recorded here (NULL = not instrumented)
+    size_t sample_rate;
+} DspChain;
+
 // Struct for thread synchronization
 typedef struct {
     pthread_mutex_t lock;
@@ -43,14 +100,43 @@ typedef struct {
     int output_ready_flag;
 } ThreadSync;
 
+// Timing reported by the duplex callback
+typedef struct {
+    unsigned long callbacks;        // Number of callbacks since the stream started
+    unsigned long frames;           // Frames per callback (last seen)
+    double adc_to_dac_latency;      // outputBufferDacTime - inputBufferAdcTime (seconds, last callback)
+    double max_adc_to_dac_latency;  // Worst adc-to-dac latency seen (seconds)
+    double callback_time;           // Wall time spent in the last callback (seconds)
+    double max_callback_time;       // Worst wall time spent in one callback (seconds)
+    unsigned long input_overflows;  // paInputOverflow status flags seen
+    unsigned long output_underflows; // paOutputUnderflow status flags seen
+} DuplexTiming;
+
 // Function prototypes
-int capture_audio_input();
-int send_audio_output();
+int capture_audio_input(float* buffer);
+int send_audio_output(const float* buffer);
 void cleanup_audio_pipeline();
 void cleanup_audio_io();
 void* audio_input_thread(void* arg);
 void* audio_processing_thread(void* arg);
 void* audio_output_thread(void* arg);
-int init_audio_io(size_t sample_rate);
+int init_audio_io(ModulationParams* params);
+int init_audio_io_duplex(ModulationParams* params);
+DspChain* dsp_chain_create(size_t block_size, size_t sample_rate, const char* reverb_ir_path,
+                           size_t lookahead);
+void dsp_chain_destroy(DspChain* chain);
+size_t dsp_chain_latency(DspChain* chain, const ModulationParams* params);
+int process_audio_frame(DspChain* chain, const float* input, float* output, size_t length,
+                        const ModulationParams* params);
+float compute_frame_rms(const float* input, size_t length);
+void apply_gain_limiter(float* samples, size_t length, float gain);
+void get_duplex_timing(DuplexTiming* timing);
+void get_pipeline_stats(PipelineStatsReport* report);
+int get_jitter_buffer_stats(JitterBufferStats* stats);
+const char* pipeline_thread_name(PipelineThread thread);
 int init_audio_pipeline(ModulationParams* params);
-void update_modulation_params(ModulationParams* params, float new_pitch);
\ No newline at end of file
+int run_offline_pipeline(const char* input_path, const char* output_path, ModulationParams* params);
+void publish_modulation_params(const ModulationParams* params);
+void update_modulation_params(ModulationParams* params, float new_pitch);
+
+#endif
@@ -0,0 +1,304 @@
+#include "wav_io.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define WAV_FORMAT_PCM 1
+#define WAV_FORMAT_FLOAT 3
+#define WAV_FORMAT_EXTENSIBLE 0xFFFE
+#define WAV_HEADER_SIZE 44
+
+static uint16_t read_le16(const unsigned char* p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t read_le32(const unsigned char* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void write_le16(unsigned char* p, uint16_t v) {
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+}
+
+static void write_le32(unsigned char* p, uint32_t v) {
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+    p[2] = (v >> 16) & 0xFF;
+    p[3] = (v >> 24) & 0xFF;
+}
+
+/**
+ * Converts one little-endian sample to a float in [-1, 1].
+ *
+ * @param p Pointer to the sample bytes.
+ * @param format WAV_FORMAT_PCM or WAV_FORMAT_FLOAT.
+ * @param bits The sample width in bits.
+ * @return The sample value.
+ */
+static float decode_sample(const unsigned char* p, uint16_t format, uint16_t bits) {
+    if (format == WAV_FORMAT_FLOAT) {
+        uint32_t raw = read_le32(p);
+        float value;
+        memcpy(&value, &raw, sizeof(value));
+        return value;
+    }
+
+    switch (bits) {
+        case 8:
+            return ((int)p[0] - 128) / 128.0f;
+        case 16:
+            return (int16_t)read_le16(p) / 32768.0f;
+        case 24: {
+            int32_t v = (int32_t)((uint32_t)p[0] << 8 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 24) >> 8;
+            return v / 8388608.0f;
+        }
+        default:
+            return (int32_t)read_le32(p) / 2147483648.0f;
+    }
+}
+
+/**
+ * Opens a WAV file for streaming reads.
+ *
+ * The RIFF chunks are walked until both "fmt " and "data" have been found;
+ * unknown chunks are skipped. The file is left positioned at the first
+ * sample of the data chunk.
+ *
+ * @param path The file to open.
+ * @return A reader, or NULL if the file cannot be opened or is not a
+ *         supported WAV file.
+ */
+WavReader* wav_reader_open(const char* path) {
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        printf("Error: Cannot open %s\n", path);
+        return NULL;
+    }
+
+    unsigned char header[12];
+    if (fread(header, 1, sizeof(header), file) != sizeof(header) ||
+        memcmp(header, "RIFF", 4) != 0 || memcmp(header + 8, "WAVE", 4) != 0) {
+        printf("Error: %s is not a RIFF/WAVE file\n", path);
+        fclose(file);
+        return NULL;
+    }
+
+    WavReader* reader = calloc(1, sizeof(WavReader));
+    if (!reader) {
+        fclose(file);
+        return NULL;
+    }
+    reader->file = file;
+
+    int have_fmt = 0;
+    for (;;) {
+        unsigned char chunk[8];
+        if (fread(chunk, 1, sizeof(chunk), file) != sizeof(chunk)) {
+            printf("Error: %s has no data chunk\n", path);
+            wav_reader_close(reader);
+            return NULL;
+        }
+        uint32_t chunk_size = read_le32(chunk + 4);
+
+        if (memcmp(chunk, "fmt ", 4) == 0) {
+            unsigned char fmt[40] = {0};
+            size_t to_read = chunk_size < sizeof(fmt) ? chunk_size : sizeof(fmt);
+            if (chunk_size < 16 || fread(fmt, 1, to_read, file) != to_read) {
+                printf("Error: %s has a malformed fmt chunk\n", path);
+                wav_reader_close(reader);
+                return NULL;
+            }
+            reader->format = read_le16(fmt);
+            reader->channels = read_le16(fmt + 2);
+            reader->sample_rate = read_le32(fmt + 4);
+            reader->bits_per_sample = read_le16(fmt + 14);
+            if (reader->format == WAV_FORMAT_EXTENSIBLE && chunk_size >= 26) {
+                reader->format = read_le16(fmt + 24);  // First two bytes of the sub-format GUID
+            }
+            fseek(file, (long)(chunk_size - to_read + (chunk_size & 1)), SEEK_CUR);
+            have_fmt = 1;
+        } else if (memcmp(chunk, "data", 4) == 0) {
+            if (!have_fmt) {
+                printf("Error: %s has data before fmt\n", path);
+                wav_reader_close(reader);
+                return NULL;
+            }
+            size_t frame_bytes = (size_t)reader->channels * (reader->bits_per_sample / 8);
+            reader->total_frames = frame_bytes ? chunk_size / frame_bytes : 0;
+            break;
+        } else {
+            fseek(file, (long)(chunk_size + (chunk_size & 1)), SEEK_CUR);
+        }
+    }
+
+    int supported = reader->channels > 0 &&
+        ((reader->format == WAV_FORMAT_PCM &&
+          (reader->bits_per_sample == 8 || reader->bits_per_sample == 16 ||
+           reader->bits_per_sample == 24 || reader->bits_per_sample == 32)) ||
+         (reader->format == WAV_FORMAT_FLOAT && reader->bits_per_sample == 32));
+    if (!supported) {
+        printf("Error: %s uses an unsupported sample format (format %u, %u bits)\n",
+               path, reader->format, reader->bits_per_sample);
+        wav_reader_close(reader);
+        return NULL;
+    }
+
+    return reader;
+}
+
+/**
+ * Reads up to the specified number of frames, downmixed to mono.
+ *
+ * @param reader The reader to read from.
+ * @param output Receives the samples.
+ * @param frames The maximum number of frames to read.
+ * @return The number of frames read (0 at the end of the data chunk).
+ */
+size_t wav_read_frames(WavReader* reader, float* output, size_t frames) {
+    size_t remaining = reader->total_frames - reader->frames_read;
+    if (frames > remaining) frames = remaining;
+    if (frames == 0) return 0;
+
+    size_t sample_bytes = reader->bits_per_sample / 8;
+    size_t frame_bytes = reader->channels * sample_bytes;
+
+    if (frames > reader->scratch_frames) {
+        unsigned char* scratch = realloc(reader->scratch, frames * frame_bytes);
+        if (!scratch) return 0;
+        reader->scratch = scratch;
+        reader->scratch_frames = frames;
+    }
+
+    frames = fread(reader->scratch, frame_bytes, frames, reader->file);
+    const float channel_scale = 1.0f / reader->channels;
+
+    for (size_t i = 0; i < frames; i++) {
+        const unsigned char* p = reader->scratch + i * frame_bytes;
+        float sum = 0.0f;
+        for (uint16_t c = 0; c < reader->channels; c++) {
+            sum += decode_sample(p + c * sample_bytes, reader->format, reader->bits_per_sample);
+        }
+        output[i] = sum * channel_scale;
+    }
+
+    reader->frames_read += frames;
+    return frames;
+}
+
+void wav_reader_close(WavReader* reader) {
+    if (!reader) return;
+    if (reader->file) fclose(reader->file);
+    free(reader->scratch);
+    free(reader);
+}
+
+/**
+ * Fills in a 44-byte canonical header for mono 32-bit float data.
+ *
+ * @param header The 44-byte header to fill.
+ * @param sample_rate The sample rate of the data.
+ * @param frames The number of frames in the data chunk.
+ */
+static void build_float_header(unsigned char* header, uint32_t sample_rate, size_t frames) {
+    const uint16_t channels = 1;
+    const uint16_t bits = 32;
+    uint32_t data_bytes = (uint32_t)(frames * channels * (bits / 8));
+
+    memcpy(header, "RIFF", 4);
+    write_le32(header + 4, 36 + data_bytes);
+    memcpy(header + 8, "WAVE", 4);
+    memcpy(header + 12, "fmt ", 4);
+    write_le32(header + 16, 16);
+    write_le16(header + 20, WAV_FORMAT_FLOAT);
+    write_le16(header + 22, channels);
+    write_le32(header + 24, sample_rate);
+    write_le32(header + 28, sample_rate * channels * (bits / 8));
+    write_le16(header + 32, channels * (bits / 8));
+    write_le16(header + 34, bits);
+    memcpy(header + 36, "data", 4);
+    write_le32(header + 40, data_bytes);
+}
+
+/**
+ * Creates a mono 32-bit float WAV file for streaming writes.
+ *
+ * @param path The file to create (overwritten if it exists).
+ * @param sample_rate The sample rate to record in the header.
+ * @return A writer, or NULL on failure.
+ */
+WavWriter* wav_writer_open(const char* path, uint32_t sample_rate) {
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        printf("Error: Cannot create %s\n", path);
+        return NULL;
+    }
+
+    unsigned char header[WAV_HEADER_SIZE];
+    build_float_header(header, sample_rate, 0);
+    if (fwrite(header, 1, sizeof(header), file) != sizeof(header)) {
+        printf("Error: Failed to write WAV header to %s\n", path);
+        fclose(file);
+        return NULL;
+    }
+
+    WavWriter* writer = calloc(1, sizeof(WavWriter));
+    if (!writer) {
+        fclose(file);
+        return NULL;
+    }
+    writer->file = file;
+    writer->sample_rate = sample_rate;
+    return writer;
+}
+
+/**
+ * Appends mono frames to the file.
+ *
+ * @param writer The writer to append to.
+ * @param input The samples to write.
+ * @param frames The number of samples to write.
+ * @return 0 on success, -1 on a short write.
+ */
+int wav_write_frames(WavWriter* writer, const float* input, size_t frames) {
+    unsigned char bytes[4 * 256];
+
+    for (size_t done = 0; done < frames; ) {
+        size_t chunk = frames - done;
+        if (chunk > 256) chunk = 256;
+        for (size_t i = 0; i < chunk; i++) {
+            uint32_t raw;
+            memcpy(&raw, &input[done + i], sizeof(raw));
+            write_le32(bytes + 4 * i, raw);
+        }
+        if (fwrite(bytes, 4, chunk, writer->file) != chunk) {
+            return -1;
+        }
+        done += chunk;
+    }
+
+    writer->frames_written += frames;
+    return 0;
+}
+
+/**
+ * Patches the header sizes and closes the file.
+ *
+ * @param writer The writer to close (may be NULL).
+ * @return 0 on success, -1 if the header could not be updated.
+ */
+int wav_writer_close(WavWriter* writer) {
+    if (!writer) return 0;
+
+    int result = 0;
+    unsigned char header[WAV_HEADER_SIZE];
+    build_float_header(header, writer->sample_rate, writer->frames_written);
+    if (fseek(writer->file, 0, SEEK_SET) != 0 ||
+        fwrite(header, 1, sizeof(header), writer->file) != sizeof(header)) {
+        result = -1;
+    }
+    if (fclose(writer->file) != 0) {
+        result = -1;
+    }
+    free(writer);
+    return result;
+}
@@ -0,0 +1,38 @@
+#ifndef WAV_IO_H
+#define WAV_IO_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Streaming reader for RIFF/WAVE files (PCM 8/16/24/32-bit or 32-bit float).
+// Multi-channel files are downmixed to mono as they are read.
+typedef struct {
+    FILE* file;
+    uint16_t format;          // 1 = PCM, 3 = IEEE float
+    uint16_t channels;
+    uint32_t sample_rate;
+    uint16_t bits_per_sample;
+    size_t total_frames;      // Frames in the data chunk
+    size_t frames_read;
+    unsigned char* scratch;   // Raw bytes for one block of interleaved frames
+    size_t scratch_frames;
+} WavReader;
+
+// Streaming writer for mono 32-bit float WAV files. Sizes in the header are
+// patched when the writer is closed.
+typedef struct {
+    FILE* file;
+    uint32_t sample_rate;
+    size_t frames_written;
+} WavWriter;
+
+WavReader* wav_reader_open(const char* path);
+size_t wav_read_frames(WavReader* reader, float* output, size_t frames);
+void wav_reader_close(WavReader* reader);
+
+WavWriter* wav_writer_open(const char* path, uint32_t sample_rate);
+int wav_write_frames(WavWriter* writer, const float* input, size_t frames);
+int wav_writer_close(WavWriter* writer);
+
+#endif
@@ -0,0 +1,276 @@
+#include "work_pool.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// Longest a worker sleeps before looking for something to steal again
+#define IDLE_SLEEP_SECONDS 0.0002
+
+typedef struct {
+    WorkPool* pool;
+    int index;
+} WorkerArgs;
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static void sleep_seconds(double seconds) {
+    struct timespec ts;
+    ts.tv_sec = (time_t)seconds;
+    ts.tv_nsec = (long)((seconds - (double)ts.tv_sec) * 1e9);
+    nanosleep(&ts, NULL);
+}
+
+/**
+ * Appends an item to the bottom of a deque. Owner only.
+ */
+static void deque_push(WorkDeque* deque, void* item) {
+    long long bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+    atomic_store_explicit(&deque->slots[bottom & deque->mask], item, memory_order_relaxed);
+    atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_release);
+}
+
+/**
+ * Takes the item at the top of a deque. Safe from any thread.
+ *
+ * @param deque The deque.
+ * @param item Receives the item.
+ * @return 1 if an item was taken, 0 if the deque was empty, -1 if another
+ *         thread won the race for the top item (worth retrying).
+ */
+static int deque_take(WorkDeque* deque, void** item) {
+    long long top = atomic_load_explicit(&deque->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    long long bottom = atomic_load_explicit(&deque->bottom, memory_order_acquire);
+    if (top >= bottom) return 0;
+
+    void* candidate = atomic_load_explicit(&deque->slots[top & deque->mask], memory_order_relaxed);
+    if (!atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1,
+                                                 memory_order_seq_cst, memory_order_relaxed)) {
+        return -1;
+    }
+    *item = candidate;
+    return 1;
+}
+
+/**
+ * Finds the next ready item for worker `self`: its own deque first, then the
+ * other workers' deques starting from its neighbour.
+ */
+static void* find_work(WorkPool* pool, int self) {
+    WorkPoolWorker* worker = &pool->workers[self];
+    void* item;
+    int result;
+
+    while ((result = deque_take(&worker->ready, &item)) != 0) {
+        if (result > 0) return item;
+    }
+
+    for (int i = 1; i < pool->num_workers; i++) {
+        WorkDeque* victim = &pool->workers[(self + i) % pool->num_workers].ready;
+        while ((result = deque_take(victim, &item)) != 0) {
+            if (result > 0) {
+                worker->steals++;
+                return item;
+            }
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Moves the sleeping items whose ready time has passed into the worker's
+ * deque, earliest first, and returns the earliest remaining wake time.
+ */
+static double wake_sleepers(WorkPoolWorker* worker, double now) {
+    double next = 0.0;
+
+    for (;;) {
+        size_t earliest = worker->num_sleepers;
+        for (size_t i = 0; i < worker->num_sleepers; i++) {
+            if (earliest == worker->num_sleepers || worker->sleepers[i].wake < worker->sleepers[earliest].wake) {
+                earliest = i;
+            }
+        }
+        if (earliest == worker->num_sleepers) return next;
+
+        if (worker->sleepers[earliest].wake > now) {
+            return worker->sleepers[earliest].wake;
+        }
+        deque_push(&worker->ready, worker->sleepers[earliest].item);
+        worker->sleepers[earliest] = worker->sleepers[--worker->num_sleepers];
+    }
+}
+
+static void* worker_main(void* arg) {
+    WorkerArgs* args = (WorkerArgs*)arg;
+    WorkPool* pool = args->pool;
+    int self = args->index;
+    WorkPoolWorker* worker = &pool->workers[self];
+    free(args);
+
+    if (pool->pin_threads) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        if (cores > 1) dsp_pin_current_thread(self % (int)cores);
+    }
+
+    while (atomic_load_explicit(&pool->live, memory_order_acquire) > 0) {
+        double now = now_seconds();
+        double next_wake = wake_sleepers(worker, now);
+
+        void* item = find_work(pool, self);
+        if (!item) {
+            // Nothing ready anywhere: sleep until our next item is due, but
+            // not so long that we miss work another worker could hand over
+            double wait = IDLE_SLEEP_SECONDS;
+            if (next_wake > 0.0 && next_wake - now < wait) wait = next_wake - now;
+            if (wait > 0.0) {
+                sleep_seconds(wait);
+                worker->idle_seconds += wait;
+            }
+            continue;
+        }
+
+        long long result = pool->handler(pool->ctx, item, self);
+        worker->steps++;
+
+        if (result == WORK_POOL_DONE) {
+            atomic_fetch_sub_explicit(&pool->live, 1, memory_order_acq_rel);
+        } else if (result == 0) {
+            deque_push(&worker->ready, item);
+        } else {
+            worker->sleepers[worker->num_sleepers].item = item;
+            worker->sleepers[worker->num_sleepers].wake = now_seconds() + (double)result * 1e-9;
+            worker->num_sleepers++;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Creates a work-stealing pool. No threads run until work_pool_run().
+ *
+ * @param num_workers Worker threads; 0 picks one per online core.
+ * @param capacity The maximum number of items.
+ * @param pin_threads Non-zero to pin each worker to its own core.
+ * @return The pool, or NULL on failure.
+ */
+WorkPool* work_pool_create(int num_workers, size_t capacity, int pin_threads) {
+    if (num_workers <= 0) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        num_workers = cores > 0 ? (int)cores : 1;
+    }
+    if (num_workers > WORK_POOL_MAX_WORKERS) num_workers = WORK_POOL_MAX_WORKERS;
+    if (capacity == 0) return NULL;
+
+    // Every item sits in at most one deque, so capacity slots never overflow
+    size_t slots = 1;
+    while (slots < capacity) slots <<= 1;
+
+    WorkPool* pool;
+    if (posix_memalign((void**)&pool, CACHE_LINE_SIZE, sizeof(WorkPool)) != 0) {
+        printf("Error: Failed to allocate work pool\n");
+        return NULL;
+    }
+    memset(pool, 0, sizeof(WorkPool));
+    pool->num_workers = num_workers;
+    pool->pin_threads = pin_threads;
+    pool->capacity = capacity;
+    atomic_init(&pool->live, 0);
+
+    for (int i = 0; i < num_workers; i++) {
+        WorkPoolWorker* worker = &pool->workers[i];
+        atomic_init(&worker->ready.top, 0);
+        atomic_init(&worker->ready.bottom, 0);
+        worker->ready.mask = (long long)slots - 1;
+        worker->ready.slots = calloc(slots, sizeof(*worker->ready.slots));
+        worker->sleepers = calloc(capacity, sizeof(WorkSleeper));
+        if (!worker->ready.slots || !worker->sleepers) {
+            printf("Error: Failed to allocate work pool queues\n");
+            work_pool_destroy(pool);
+            return NULL;
+        }
+    }
+
+    return pool;
+}
+
+/**
+ * Adds an item, spreading items round-robin over the workers. Must be called
+ * before work_pool_run().
+ *
+ * @param pool The pool.
+ * @param item The item passed to the handler.
+ * @return 0 on success, -1 if the pool is full.
+ */
+int work_pool_add(WorkPool* pool, void* item) {
+    if (pool->num_items >= pool->capacity) {
+        printf("Error: Work pool is full (%zu items)\n", pool->capacity);
+        return -1;
+    }
+    deque_push(&pool->workers[pool->num_items % pool->num_workers].ready, item);
+    pool->num_items++;
+    atomic_fetch_add(&pool->live, 1);
+    return 0;
+}
+
+/**
+ * Runs every item to completion on the worker threads and returns when the
+ * handler has reported WORK_POOL_DONE for all of them.
+ *
+ * @param pool The pool.
+ * @param handler Runs one step of an item.
+ * @param ctx Passed to every handler call.
+ * @return 0 on success, -1 if no worker thread could be started.
+ */
+int work_pool_run(WorkPool* pool, WorkHandler handler, void* ctx) {
+    pool->handler = handler;
+    pool->ctx = ctx;
+
+    int started = 0;
+    for (int i = 0; i < pool->num_workers; i++) {
+        WorkerArgs* args = malloc(sizeof(WorkerArgs));
+        if (!args) break;
+        args->pool = pool;
+        args->index = i;
+        if (pthread_create(&pool->threads[i], NULL, worker_main, args) != 0) {
+            free(args);
+            break;
+        }
+        started++;
+    }
+
+    if (started == 0) {
+        printf("Error: Failed to start work pool threads\n");
+        return -1;
+    }
+    if (started < pool->num_workers) {
+        // Items queued for the missing workers are still stolen by the others
+        printf("Warning: Started only %d of %d work pool threads\n", started, pool->num_workers);
+    }
+
+    for (int i = 0; i < started; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+    return 0;
+}
+
+/**
+ * Frees the pool. The items themselves belong to the caller.
+ *
+ * @param pool The pool to destroy (may be NULL).
+ */
+void work_pool_destroy(WorkPool* pool) {
+    if (!pool) return;
+
+    for (int i = 0; i < pool->num_workers; i++) {
+        free(pool->workers[i].ready.slots);
+        free(pool->workers[i].sleepers);
+    }
+    free(pool);
+}
@@ -0,0 +1,69 @@
+#ifndef WORK_POOL_H
+#define WORK_POOL_H
+
+#include <stddef.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "dsp_pool.h"
+
+#ifndef CACHE_LINE_SIZE
+#define CACHE_LINE_SIZE 128
+#endif
+
+#define WORK_POOL_MAX_WORKERS 64
+
+// Returned by a WorkHandler when the item is finished for good
+#define WORK_POOL_DONE (-1)
+
+// Runs one step of an item on worker `worker`. Returns WORK_POOL_DONE when
+// the item is finished, 0 to run it again as soon as possible, or the number
+// of nanoseconds until it is ready to run again.
+typedef long long (*WorkHandler)(void* ctx, void* item, int worker);
+
+// Chase-Lev deque of ready items. Only the owning worker pushes; the owner
+// and thieves all take from the top, so every deque is served FIFO and no
+// ready item starves behind one that keeps being requeued.
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) atomic_llong top;
+    _Alignas(CACHE_LINE_SIZE) atomic_llong bottom;
+    _Alignas(CACHE_LINE_SIZE) _Atomic(void*)* slots;
+    long long mask;
+} WorkDeque;
+
+// Item waiting for its ready time; private to one worker until it is due
+typedef struct {
+    void* item;
+    double wake;
+} WorkSleeper;
+
+typedef struct {
+    WorkDeque ready;
+    WorkSleeper* sleepers;
+    size_t num_sleepers;
+    unsigned long steps;       // Handler calls
+    unsigned long steals;      // Items taken from another worker's deque
+    double idle_seconds;       // Time spent sleeping with nothing ready
+} WorkPoolWorker;
+
+// Fixed set of long-running items (streams) scheduled over worker threads
+// with work stealing. Items are added before work_pool_run() and each one is
+// owned by exactly one worker at a time; an idle worker steals the oldest
+// ready item from a busy one.
+typedef struct {
+    WorkPoolWorker workers[WORK_POOL_MAX_WORKERS];
+    pthread_t threads[WORK_POOL_MAX_WORKERS];
+    int num_workers;
+    int pin_threads;
+    size_t capacity;           // Maximum number of items
+    size_t num_items;
+    WorkHandler handler;
+    void* ctx;
+    atomic_size_t live;        // Items not finished yet
+} WorkPool;
+
+WorkPool* work_pool_create(int num_workers, size_t capacity, int pin_threads);
+int work_pool_add(WorkPool* pool, void* item);
+int work_pool_run(WorkPool* pool, WorkHandler handler, void* ctx);
+void work_pool_destroy(WorkPool* pool);
+
+#endif
@@ -0,0 +1,250 @@
+#include "wsola.h"
+#include "spectral_kernels.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Smallest read delay: the interpolation reads one sample behind the head
+#define WSOLA_MIN_DELAY 1.0f
+
+/**
+ * Creates a pitch shifter for the given sample rate.
+ *
+ * @param sample_rate The sample rate in Hz.
+ * @param arena Arena for the shifter and its buffers, or NULL for the heap.
+ * @return The shifter, or NULL on failure.
+ */
+WsolaShifter* wsola_create(size_t sample_rate, DspArena* arena) {
+    WsolaShifter* ws = dsp_alloc(arena, sizeof(WsolaShifter));
+    if (!ws) {
+        printf("Error: Failed to allocate pitch shifter\n");
+        return NULL;
+    }
+    ws->arena = arena;
+
+    ws->sample_rate = sample_rate;
+    ws->overlap = (size_t)(WSOLA_OVERLAP_MS * 0.001f * sample_rate);
+    ws->search = (size_t)(WSOLA_SEARCH_MS * 0.001f * sample_rate) & ~(size_t)1;
+    if (ws->overlap < 8) ws->overlap = 8;
+    if (ws->search < 8) ws->search = 8;
+    ws->pitch_coef = 1.0f - expf(-1.0f / (WSOLA_PITCH_GLIDE_MS * 0.001f * sample_rate));
+
+    // Deepest read: a splice at WSOLA_MAX_PITCH, plus the reference window
+    size_t drift = (size_t)ceilf(ws->overlap * (WSOLA_MAX_PITCH - 1.0f));
+    size_t deepest = 2 * drift + 2 * ws->search + 2 * ws->overlap + 8;
+    size_t size = 1;
+    while (size < deepest) size <<= 1;
+
+    ws->line = dsp_alloc(arena, size * sizeof(float));
+    ws->ref = dsp_alloc(arena, ws->overlap * sizeof(float));
+    ws->region = dsp_alloc(arena, (ws->overlap + ws->search + 1) * sizeof(float));
+    ws->corr = dsp_alloc(arena, (ws->search + 1) * sizeof(float));
+    if (!ws->line || !ws->ref || !ws->region || !ws->corr) {
+        printf("Error: Failed to allocate pitch shifter buffers\n");
+        wsola_destroy(ws);
+        return NULL;
+    }
+    ws->mask = size - 1;
+
+    wsola_reset(ws);
+    return ws;
+}
+
+/**
+ * Frees the shifter and its buffers.
+ *
+ * @param ws The shifter (NULL is ignored).
+ */
+void wsola_destroy(WsolaShifter* ws) {
+    if (!ws) return;
+    dsp_free(ws->arena, ws->line);
+    dsp_free(ws->arena, ws->ref);
+    dsp_free(ws->arena, ws->region);
+    dsp_free(ws->arena, ws->corr);
+    dsp_free(ws->arena, ws);
+}
+
+/**
+ * Silences the delay line. The next wsola_process() call starts at the mean
+ * delay for its pitch.
+ *
+ * @param ws The shifter.
+ */
+void wsola_reset(WsolaShifter* ws) {
+    memset(ws->line, 0, (ws->mask + 1) * sizeof(float));
+    ws->write_pos = 0;
+    ws->delay = -1.0f;
+    ws->pitch = 0.0f;
+    ws->fade_delay = 0.0f;
+    ws->fade_pos = ws->overlap;
+    ws->splices = 0;
+}
+
+/**
+ * Works out where the read head may go at a given pitch: it drifts by
+ * |pitch - 1| per sample, and a splice moves it back by `jump` give or take
+ * half the search range. The limits leave room for the head being faded
+ * out to keep drifting for one overlap without overtaking the input.
+ */
+static void splice_limits(const WsolaShifter* ws, float pitch_factor, float* lo, float* hi, float* jump) {
+    float drift = ws->overlap * fabsf(pitch_factor - 1.0f);
+    float half = (float)(ws->search / 2);
+
+    *jump = half + ceilf(drift) + 1.0f;
+    if (pitch_factor >= 1.0f) {
+        *lo = WSOLA_MIN_DELAY + ceilf(drift);
+        *hi = *lo + *jump + half;
+    } else {
+        *hi = WSOLA_MIN_DELAY + *jump + half;
+        *lo = WSOLA_MIN_DELAY;
+    }
+}
+
+/**
+ * Reads the input `delay` samples behind the newest sample, with linear
+ * interpolation.
+ */
+static inline float read_line(const WsolaShifter* ws, float delay) {
+    if (delay < 0.0f) delay = 0.0f;
+    size_t whole = (size_t)delay;
+    float frac = delay - (float)whole;
+    size_t i = ws->write_pos - 1 - whole;
+    float newer = ws->line[i & ws->mask];
+    float older = ws->line[(i - 1) & ws->mask];
+    return newer + frac * (older - newer);
+}
+
+/**
+ * Copies `length` samples starting `depth` samples behind the write position.
+ */
+static void copy_line(const WsolaShifter* ws, float* dest, size_t depth, size_t length) {
+    size_t start = (ws->write_pos - depth) & ws->mask;
+    size_t first = ws->mask + 1 - start;
+    if (first > length) first = length;
+    memcpy(dest, ws->line + start, first * sizeof(float));
+    memcpy(dest + first, ws->line, (length - first) * sizeof(float));
+}
+
+/**
+ * Moves the read head by about `jump` (back in time when shifting up,
+ * forward when shifting down) and starts a crossfade from the old head.
+ *
+ * The exact target is the candidate whose preceding overlap best matches
+ * the overlap preceding the old head (normalised cross-correlation over the
+ * search range), so both heads continue in phase through the crossfade.
+ */
+static void splice(WsolaShifter* ws, float pitch_factor, float jump) {
+    const size_t overlap = ws->overlap;
+    const size_t search = ws->search;
+    const float old_delay = ws->delay > 0.0f ? ws->delay : 0.0f;
+    const size_t old_whole = (size_t)old_delay;
+
+    float centre = pitch_factor > 1.0f ? old_delay + jump : old_delay - jump;
+    size_t deepest = (size_t)(centre + 0.5f) + search / 2;
+
+    copy_line(ws, ws->ref, old_whole + overlap, overlap);
+    copy_line(ws, ws->region, deepest + overlap, overlap + search);
+    cross_correlate(ws->ref, ws->region, overlap, ws->corr, search + 1);
+
+    // Candidate k starts deepest - k samples behind the input
+    float energy = 0.0f;
+    for (size_t i = 0; i < overlap; i++) {
+        energy += ws->region[i] * ws->region[i];
+    }
+    size_t best = search / 2;
+    float best_score = -INFINITY;
+    for (size_t k = 0; k <= search; k++) {
+        float score = ws->corr[k] / sqrtf(energy + 1e-9f);
+        if (score > best_score) {
+            best_score = score;
+            best = k;
+        }
+        if (k < search) {
+            float leaving = ws->region[k];
+            float entering = ws->region[k + overlap];
+            energy += entering * entering - leaving * leaving;
+            if (energy < 0.0f) energy = 0.0f;
+        }
+    }
+
+    ws->fade_delay = old_delay;
+    ws->delay = (float)(deepest - best) + (old_delay - (float)old_whole);
+    ws->fade_pos = 0;
+    ws->splices++;
+}
+
+/**
+ * Shifts the pitch of a block of samples.
+ *
+ * Every input sample enters the delay line and one output sample is read
+ * at a head that moves pitch_factor samples per sample. When the head gets
+ * too close to the input (shifting up) or too far behind it (shifting
+ * down) it is spliced, see splice(). At a pitch factor of 1 the head never
+ * moves and the output is the input delayed. A new pitch factor is glided
+ * to sample by sample over WSOLA_PITCH_GLIDE_MS. Input and output may be
+ * the same buffer.
+ *
+ * @param ws The shifter.
+ * @param input The input samples.
+ * @param output Receives the shifted samples.
+ * @param length The number of samples.
+ * @param pitch_factor The pitch factor (WSOLA_MIN_PITCH - WSOLA_MAX_PITCH).
+ */
+void wsola_process(WsolaShifter* ws, const float* input, float* output, size_t length, float pitch_factor) {
+    if (pitch_factor < WSOLA_MIN_PITCH) pitch_factor = WSOLA_MIN_PITCH;
+    if (pitch_factor > WSOLA_MAX_PITCH) pitch_factor = WSOLA_MAX_PITCH;
+    if (ws->pitch <= 0.0f) ws->pitch = pitch_factor;
+    if (ws->delay < 0.0f) ws->delay = (float)wsola_latency(ws, ws->pitch);
+
+    float pitch = ws->pitch;
+    float lo, hi, jump;
+    splice_limits(ws, pitch, &lo, &hi, &jump);
+    const float fade_step = 1.0f / (float)(ws->overlap + 1);
+
+    for (size_t n = 0; n < length; n++) {
+        if (pitch != pitch_factor) {
+            pitch += (pitch_factor - pitch) * ws->pitch_coef;
+            if (fabsf(pitch_factor - pitch) < 1e-4f) pitch = pitch_factor;
+            splice_limits(ws, pitch, &lo, &hi, &jump);
+        }
+        const float step = 1.0f - pitch;
+
+        ws->line[ws->write_pos & ws->mask] = input[n];
+        ws->write_pos++;
+
+        float y = read_line(ws, ws->delay);
+        if (ws->fade_pos < ws->overlap) {
+            float w = (float)(ws->fade_pos + 1) * fade_step;
+            y = w * y + (1.0f - w) * read_line(ws, ws->fade_delay);
+            ws->fade_delay += step;
+            ws->fade_pos++;
+        }
+        output[n] = y;
+
+        ws->delay += step;
+        if (ws->fade_pos == ws->overlap &&
+            ((pitch > 1.0f && ws->delay < lo) || (pitch < 1.0f && ws->delay > hi))) {
+            splice(ws, pitch, jump);
+        }
+    }
+    ws->pitch = pitch;
+}
+
+/**
+ * Returns the mean delay between input and output at a given pitch. The
+ * actual delay moves around it by up to half a splice.
+ *
+ * @param ws The shifter.
+ * @param pitch_factor The pitch factor.
+ * @return The mean latency in samples.
+ */
+size_t wsola_latency(const WsolaShifter* ws, float pitch_factor) {
+    if (pitch_factor < WSOLA_MIN_PITCH) pitch_factor = WSOLA_MIN_PITCH;
+    if (pitch_factor > WSOLA_MAX_PITCH) pitch_factor = WSOLA_MAX_PITCH;
+
+    float lo, hi, jump;
+    splice_limits(ws, pitch_factor, &lo, &hi, &jump);
+    float mean = pitch_factor >= 1.0f ? lo + 0.5f * jump : hi - 0.5f * jump;
+    return (size_t)(mean + 0.5f);
+}
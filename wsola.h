@@ -0,0 +1,48 @@
+#ifndef WSOLA_H
+#define WSOLA_H
+
+#include <stddef.h>
+#include "dsp_arena.h"
+
+#define WSOLA_OVERLAP_MS 4.0f   // Crossfade at a splice, and the length compared by the search
+#define WSOLA_SEARCH_MS 8.0f    // Splice search range (one period of a 125 Hz voice)
+#define WSOLA_MIN_PITCH 0.25f
+#define WSOLA_MAX_PITCH 4.0f
+#define WSOLA_PITCH_GLIDE_MS 20.0f  // Time constant of pitch changes
+
+// Low-latency time-domain pitch shifter. The input goes into a short delay
+// line that is read pitch_factor times as fast as it is written; whenever
+// the read head drifts out of range it is spliced back by about one search
+// window, at the offset where the waveform matches best (WSOLA), with a
+// short crossfade. The delay never exceeds a few overlaps, so the latency
+// is a few milliseconds instead of an FFT frame. All buffers are allocated
+// at creation; wsola_process() never allocates or locks.
+typedef struct {
+    float* line;              // Power-of-two circular input history
+    size_t mask;
+    size_t write_pos;         // Samples written so far (free-running)
+    float delay;              // Read head delay in samples (< 0 = not started)
+    float pitch;              // Current pitch factor, gliding to the requested one (0 = not started)
+    float pitch_coef;         // Per-sample one-pole coefficient for pitch glides
+    float fade_delay;         // Delay of the head being faded out
+    size_t fade_pos;          // Progress of the crossfade (== overlap when idle)
+    size_t overlap;           // Crossfade and correlation length in samples
+    size_t search;            // Splice search range in samples (even)
+    size_t sample_rate;
+    unsigned long splices;
+
+    // Splice search scratch
+    float* ref;               // overlap samples preceding the old head
+    float* region;            // overlap + search samples around the target
+    float* corr;              // search + 1 correlations
+
+    DspArena* arena;          // Owner of the struct and buffers (NULL = heap)
+} WsolaShifter;
+
+WsolaShifter* wsola_create(size_t sample_rate, DspArena* arena);
+void wsola_destroy(WsolaShifter* ws);
+void wsola_reset(WsolaShifter* ws);
+void wsola_process(WsolaShifter* ws, const float* input, float* output, size_t length, float pitch_factor);
+size_t wsola_latency(const WsolaShifter* ws, float pitch_factor);
+
+#endif